@@ -0,0 +1,100 @@
+#include "arena.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+using ext_t = std::dextents<int, 2>;
+
+void test_arena() {
+  arena_resource arena(1024);
+
+  for (int step = 0; step < 4; ++step) {
+    arena_step s(arena);
+    auto a = make_arena_mdarray<double>(arena, ext_t{8, 8});
+    auto b = make_arena_mdarray<float, ext_t, std::layout_left>(arena, ext_t{3, 5});
+    // Larger than a chunk.
+    auto c = make_arena_mdarray<double>(arena, ext_t{40, 40});
+
+    assert(reinterpret_cast<std::uintptr_t>(a.data()) % arena_resource::min_alignment == 0);
+    assert(reinterpret_cast<std::uintptr_t>(b.data()) % arena_resource::min_alignment == 0);
+    assert(reinterpret_cast<std::uintptr_t>(c.data()) % arena_resource::min_alignment == 0);
+    assert((a[7, 7] == 0.));
+    a[7, 7] = 1.;
+    b[2, 4] = 2.f;
+    c[39, 39] = 3.;
+    assert((a[7, 7] == 1.));
+    assert((b[2, 4] == 2.f));
+    assert(arena.bytes_in_use() >= 64 * sizeof(double) + 15 * sizeof(float) + 1600 * sizeof(double));
+  }
+
+  // The chunks of the first step were merged at its end, later steps are
+  // served without going upstream.
+  const arena_stats &s = arena.stats();
+  assert(s.allocations == 12);
+  assert(s.releases == 4);
+  assert(s.upstream_allocations == 3);
+  assert(arena.bytes_in_use() == 0);
+  assert(s.reuse_rate() == 0.75);
+}
+
+// Time step with three scratch arrays: t = a + b, u = t * t, a += u / n.
+template <class Make> double step(Make &&make, int n, double *a) {
+  auto t = make(n);
+  auto u = make(n);
+  auto v = make(n);
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j) {
+      t[i, j] = a[i * n + j] + i - j;
+      v[i, j] = 1. / (1 + i + j);
+    }
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+      u[i, j] = t[i, j] * t[i, j] * v[i, j];
+  double s = 0;
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j) {
+      a[i * n + j] += u[i, j] / n;
+      s += a[i * n + j];
+    }
+  return s;
+}
+
+void bench(int n, int steps) {
+  std::vector<double> a(std::size_t(n) * n, 0.);
+  double s_heap = 0, s_arena = 0;
+
+  Timer t_heap;
+  for (int k = 0; k < steps; ++k) {
+    s_heap += step([](int m) { return std::experimental::mdarray<double, ext_t>(m, m); }, n, a.data());
+  }
+  const double heap = t_heap.elapsed();
+
+  std::fill(a.begin(), a.end(), 0.);
+  arena_resource arena;
+  Timer t_arena;
+  for (int k = 0; k < steps; ++k) {
+    arena_step scope(arena);
+    s_arena += step([&](int m) { return make_arena_mdarray<double>(arena, ext_t{m, m}); }, n, a.data());
+  }
+  const double arena_time = t_arena.elapsed();
+
+  assert(s_heap == s_arena);
+
+  std::cout << n << ", " << steps << ", " << heap / steps << ", " << arena_time / steps
+            << std::endl;
+  std::cout << "  " << arena.stats() << std::endl;
+}
+
+// Usage: arena_example [<steps>]
+int main(int argc, char **argv) {
+  test_arena();
+
+  const int steps = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+  std::cout << "n, steps, heap [s/step], arena [s/step]" << std::endl;
+  for (int n : {4, 16, 64, 256})
+    bench(n, n >= 256 ? steps / 10 : steps);
+}
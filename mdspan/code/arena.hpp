@@ -0,0 +1,169 @@
+#pragma once
+
+#include <experimental/mdarray>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <ostream>
+#include <vector>
+
+// Allocation telemetry of an arena_resource, cumulative over all steps.
+struct arena_stats {
+  // Calls to allocate and bytes requested by them.
+  std::size_t allocations = 0;
+  std::size_t bytes_requested = 0;
+  // Largest number of bytes in use between two calls to release().
+  std::size_t peak_bytes = 0;
+  // Chunks (and their bytes) that had to be requested from upstream.
+  std::size_t upstream_allocations = 0;
+  std::size_t upstream_bytes = 0;
+  // Calls to release(), i.e. steps.
+  std::size_t releases = 0;
+
+  // Fraction of the allocations served from memory already owned by the
+  // arena, i.e. with a pointer bump only.
+  double reuse_rate() const {
+    return allocations == 0
+               ? 0.
+               : 1. - static_cast<double>(upstream_allocations) / allocations;
+  }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const arena_stats &s) {
+  return os << "allocations: " << s.allocations
+            << ", bytes requested: " << s.bytes_requested
+            << ", peak bytes: " << s.peak_bytes
+            << ", upstream allocations: " << s.upstream_allocations
+            << ", upstream bytes: " << s.upstream_bytes
+            << ", steps: " << s.releases
+            << ", reuse rate: " << s.reuse_rate();
+}
+
+// Monotonic arena for scratch arrays that live for one step of a loop.
+//
+// allocate() bumps a pointer into a chunk owned by the arena, deallocate()
+// does nothing, and release() makes all the memory available again at the
+// end of a step. The chunks are kept across steps, and if a step needed more
+// than one chunk they are merged into a single one, so that after the first
+// steps no more memory is requested from upstream.
+//
+// All the objects allocated from the arena must be destroyed before
+// release(). The arena is not thread-safe.
+class arena_resource : public std::pmr::memory_resource {
+public:
+  static constexpr std::size_t min_alignment = 64;
+
+  explicit arena_resource(
+      std::size_t chunk_size = std::size_t{1} << 20,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : chunk_size_(chunk_size), upstream_(upstream) {}
+
+  arena_resource(const arena_resource &) = delete;
+  arena_resource &operator=(const arena_resource &) = delete;
+
+  ~arena_resource() override { free_chunks(); }
+
+  // End of a step: everything allocated so far may be reused.
+  void release() {
+    ++stats_.releases;
+
+    if (current_ > 0) {
+      std::size_t total = 0;
+      for (const auto &c : chunks_)
+        total += c.size;
+      free_chunks();
+      add_chunk(total);
+    }
+
+    current_ = 0;
+    offset_ = 0;
+    in_use_ = 0;
+  }
+
+  std::size_t bytes_in_use() const { return in_use_; }
+  const arena_stats &stats() const { return stats_; }
+
+private:
+  struct chunk {
+    std::byte *data;
+    std::size_t size;
+  };
+
+  std::size_t chunk_size_;
+  std::pmr::memory_resource *upstream_;
+  std::vector<chunk> chunks_;
+  // Position of the bump pointer.
+  std::size_t current_ = 0;
+  std::size_t offset_ = 0;
+  std::size_t in_use_ = 0;
+  arena_stats stats_;
+
+  void add_chunk(std::size_t size) {
+    chunks_.push_back({static_cast<std::byte *>(upstream_->allocate(size, min_alignment)), size});
+    ++stats_.upstream_allocations;
+    stats_.upstream_bytes += size;
+  }
+
+  void free_chunks() {
+    for (const auto &c : chunks_)
+      upstream_->deallocate(c.data, c.size, min_alignment);
+    chunks_.clear();
+  }
+
+  // Bumps the pointer of the current chunk, nullptr if it doesn't fit.
+  void *bump(std::size_t bytes, std::size_t alignment) {
+    const chunk &c = chunks_[current_];
+    const std::size_t start = (offset_ + alignment - 1) / alignment * alignment;
+    if (start + bytes > c.size)
+      return nullptr;
+    in_use_ += start + bytes - offset_;
+    offset_ = start + bytes;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, in_use_);
+    return c.data + start;
+  }
+
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++stats_.allocations;
+    stats_.bytes_requested += bytes;
+    alignment = std::max(alignment, min_alignment);
+
+    for (; current_ < chunks_.size(); ++current_, offset_ = 0) {
+      if (void *p = bump(bytes, alignment))
+        return p;
+    }
+
+    add_chunk(std::max(chunk_size_, bytes + alignment));
+    current_ = chunks_.size() - 1;
+    offset_ = 0;
+    return bump(bytes, alignment);
+  }
+
+  void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// Ends a step of an arena_resource when going out of scope.
+class arena_step {
+  arena_resource &arena_;
+
+public:
+  explicit arena_step(arena_resource &arena) : arena_(arena) {}
+  arena_step(const arena_step &) = delete;
+  arena_step &operator=(const arena_step &) = delete;
+  ~arena_step() { arena_.release(); }
+};
+
+template <class T, class Extents, class Layout = std::layout_right>
+using arena_mdarray =
+    std::experimental::mdarray<T, Extents, Layout, std::pmr::vector<T>>;
+
+// Scratch mdarray whose elements live in the arena.
+template <class T, class Extents, class Layout = std::layout_right>
+arena_mdarray<T, Extents, Layout> make_arena_mdarray(arena_resource &arena,
+                                                     const Extents &exts) {
+  return arena_mdarray<T, Extents, Layout>(exts, std::pmr::polymorphic_allocator<T>(&arena));
+}
@@ -0,0 +1,132 @@
+#include "checkpoint.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+void test_checkpoint() {
+  const temp_file path("checkpoint_test"), path2("checkpoint_test");
+  const int m = 100, n = 300;
+  std::vector<double> a(m * n), b(m * n);
+  auto A = std::mdspan(a.data(), std::dextents<int, 2>{m, n});
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      A[i, j] = std::sin(0.01 * i) * std::cos(0.02 * j);
+
+  for (auto codec : {checkpoint_codec::none, checkpoint_codec::shuffle_rle}) {
+    // Two slots of 4096 bytes: save() waits for the writer most of the time.
+    checkpoint_writer w({.chunk_bytes = 4096, .max_staging_bytes = 0, .codec = codec});
+    assert(w.staging_bytes() == 2 * 4096);
+    auto f = w.save(path, A);
+    const checkpoint_stats s = f.get();
+    assert(s.raw_bytes == a.size() * sizeof(double));
+    assert(s.chunks == (s.raw_bytes + 4095) / 4096);
+    if (codec == checkpoint_codec::none)
+      assert(s.stored_bytes == s.raw_bytes);
+
+    std::fill(b.begin(), b.end(), 0.);
+    read_checkpoint(path, std::mdspan(b.data(), std::dextents<int, 2>{m, n}));
+    assert(a == b);
+
+    // Into a layout_left array.
+    std::fill(b.begin(), b.end(), 0.);
+    auto L = std::mdspan<double, std::dextents<int, 2>, std::layout_left>(b.data(), m, n);
+    read_checkpoint(path, L);
+    for (int i = 0; i < m; ++i)
+      for (int j = 0; j < n; ++j)
+        assert((L[i, j] == A[i, j]));
+  }
+
+  // A submdspan with gaps, several checkpoints in flight.
+  {
+    checkpoint_writer w({.chunk_bytes = 8192, .codec = checkpoint_codec::shuffle_rle});
+    auto S = std::submdspan(A, std::pair{10, 60}, std::pair{5, 205});
+    auto f1 = w.save(path, S);
+    auto f2 = w.save(path2, A);
+    f1.get();
+    f2.get();
+    std::vector<double> s(50 * 200);
+    auto Sc = std::mdspan(s.data(), std::dextents<int, 2>{50, 200});
+    read_checkpoint(path, Sc);
+    for (int i = 0; i < 50; ++i)
+      for (int j = 0; j < 200; ++j)
+        assert((Sc[i, j] == S[i, j]));
+  }
+
+  // Mismatches and corruption are detected.
+  auto C = std::mdspan(b.data(), std::dextents<int, 2>{n, m});
+  bool thrown = false;
+  try {
+    read_checkpoint(path, C);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  checkpoint_writer().save(path, A).get();
+  {
+    std::fstream f(path.path(), std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(checkpoint_header::alignment + 100);
+    f.put('x');
+  }
+  thrown = false;
+  try {
+    read_checkpoint(path, std::mdspan(b.data(), std::dextents<int, 2>{m, n}));
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  thrown = false;
+  try {
+    checkpoint_writer().save("/nonexistent/dir/x.ckpt", A);
+  } catch (const std::system_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// Time the caller is blocked by a synchronous write_mdfile and by
+// checkpoint_writer::save, and the throughput of the background write.
+void bench(std::size_t n, checkpoint_codec codec, std::size_t staging) {
+  std::vector<double> a(n * n);
+  auto A = std::mdspan(a.data(), std::dextents<std::size_t, 2>{n, n});
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      A[i, j] = std::exp(-1e-6 * double(i * i + j * j));
+  const double bytes = a.size() * sizeof(double);
+
+  const temp_file mdfile_path("checkpoint_bench"), checkpoint_path("checkpoint_bench");
+  Timer t;
+  write_mdfile(mdfile_path, A);
+  const double t_sync = t.elapsed();
+
+  checkpoint_writer w({.max_staging_bytes = staging, .codec = codec});
+  auto f = w.save(checkpoint_path, A);
+  // The simulation would go on here.
+  const checkpoint_stats s = f.get();
+
+  std::cout << n << ", " << (codec == checkpoint_codec::none ? "none" : "shuffle_rle") << ", "
+            << (staging >> 20) << ", " << bytes / t_sync * 1e-9 << ", " << s.snapshot_seconds
+            << ", " << s.total_seconds << ", " << s.throughput() * 1e-9 << ", "
+            << s.compression_ratio() << std::endl;
+}
+
+// Usage: checkpoint_example [<n>]
+int main(int argc, char **argv) {
+  test_checkpoint();
+
+  const std::size_t n = argc > 1 ? std::atoi(argv[1]) : 4096;
+
+  std::cout << "n, codec, staging [MiB], write_mdfile [GB/s], blocked [s], total [s], "
+               "checkpoint [GB/s], compression"
+            << std::endl;
+  const std::size_t all = n * n * sizeof(double);
+  for (auto codec : {checkpoint_codec::none, checkpoint_codec::shuffle_rle})
+    for (std::size_t staging : {std::size_t{16} << 20, all})
+      bench(n, codec, staging);
+}
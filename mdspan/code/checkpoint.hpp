@@ -0,0 +1,584 @@
+#pragma once
+
+#include "mdfile.hpp"
+
+#include <experimental/mdarray>
+#include <experimental/mdspan>
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+// Asynchronous checkpoints of mdspans.
+//
+// checkpoint_writer::save(path, m) copies m, chunk by chunk, into staging
+// slots and returns a future; a background thread checksums, optionally
+// compresses and writes the chunks. The staging area is a ring of
+// max_staging_bytes / chunk_bytes slots (at least two, i.e. double
+// buffering): when m fits in it, save returns as soon as it is copied and m
+// can be modified right away, otherwise save blocks until the writer frees
+// slots. The future is ready once the file is complete (and, with sync, on
+// disk) and holds the timings of the checkpoint.
+//
+// File format, the elements in layout_right order of the extents:
+//
+//   [0, 4096)         checkpoint_header
+//   chunks            each at an offset multiple of 4096
+//   index             chunk_count checkpoint_chunk entries at index_offset
+//
+// The header is written last, so an interrupted checkpoint is not mistaken
+// for a complete one. Every chunk records the CRC-32C of its uncompressed
+// bytes. The shuffle_rle codec transposes the bytes of the elements into
+// planes, which gathers the sign and exponent bytes of smooth floating point
+// data, and run-length encodes the result; chunks it doesn't shrink are
+// stored as they are.
+//
+// read_checkpoint(path, m) reads a checkpoint back into m, throwing
+// std::runtime_error on a mismatch or a checksum error.
+
+enum class checkpoint_codec : std::uint32_t { none = 0, shuffle_rle = 1 };
+
+struct checkpoint_header {
+  static constexpr std::size_t max_rank = mdfile_header::max_rank;
+  static constexpr std::uint64_t alignment = 4096;
+
+  char magic[8] = {'M', 'D', 'C', 'K', 'P', 'T', '\0', '\1'};
+  // Written as 0x01020304, a different value means another byte order.
+  std::uint32_t byte_order = 0x01020304;
+  mdfile_type type{};
+  std::uint32_t element_size = 0;
+  std::uint32_t rank = 0;
+  std::uint64_t chunk_bytes = 0;
+  std::uint64_t chunk_count = 0;
+  std::uint64_t index_offset = 0;
+  std::uint64_t extents[max_rank] = {};
+};
+
+struct checkpoint_chunk {
+  std::uint64_t offset = 0;
+  std::uint64_t raw_bytes = 0;
+  std::uint64_t stored_bytes = 0;
+  std::uint32_t checksum = 0;
+  checkpoint_codec codec = checkpoint_codec::none;
+};
+
+static_assert(std::is_trivially_copyable_v<checkpoint_header>);
+static_assert(sizeof(checkpoint_header) <= checkpoint_header::alignment);
+
+struct checkpoint_options {
+  // Multiple of checkpoint_header::alignment.
+  std::size_t chunk_bytes = std::size_t{4} << 20;
+  std::size_t max_staging_bytes = std::size_t{64} << 20;
+  checkpoint_codec codec = checkpoint_codec::none;
+  // fdatasync before completing the future.
+  bool sync = false;
+};
+
+struct checkpoint_stats {
+  std::size_t chunks = 0;
+  std::uint64_t raw_bytes = 0;
+  std::uint64_t stored_bytes = 0;
+  // Time save() blocked the caller.
+  double snapshot_seconds = 0;
+  // From the call to save() to the file being complete.
+  double total_seconds = 0;
+
+  double throughput() const { return total_seconds > 0 ? raw_bytes / total_seconds : 0; }
+  double compression_ratio() const {
+    return stored_bytes > 0 ? static_cast<double>(raw_bytes) / stored_bytes : 1;
+  }
+};
+
+namespace impl {
+
+inline std::uint32_t crc32c(const std::byte *p, std::size_t n, std::uint32_t crc = 0) {
+  crc = ~crc;
+#if defined(__SSE4_2__)
+  std::uint64_t c = crc;
+  for (; n >= 8; n -= 8, p += 8) {
+    std::uint64_t w;
+    std::memcpy(&w, p, 8);
+    c = _mm_crc32_u64(c, w);
+  }
+  crc = static_cast<std::uint32_t>(c);
+  for (; n > 0; --n, ++p)
+    crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*p));
+#else
+  // Slicing by 8: t[k][b] is the CRC of byte b followed by k zero bytes.
+  static const auto t = [] {
+    std::array<std::array<std::uint32_t, 256>, 8> t{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+        c = c & 1 ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+      t[0][i] = c;
+    }
+    for (std::size_t k = 1; k < 8; ++k)
+      for (std::size_t i = 0; i < 256; ++i)
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+    return t;
+  }();
+  for (; n >= 8; n -= 8, p += 8) {
+    std::uint32_t lo, hi;
+    std::memcpy(&lo, p, 4);
+    std::memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+  }
+  for (; n > 0; --n, ++p)
+    crc = t[0][(crc ^ static_cast<unsigned char>(*p)) & 0xff] ^ (crc >> 8);
+#endif
+  return ~crc;
+}
+
+// Byte planes of n bytes of elements of size s, then runs: a control byte
+// c < 128 followed by c + 1 literal bytes, or c >= 128 followed by a byte
+// repeated c - 125 times. Returns the compressed size, 0 if not smaller
+// than n.
+inline std::size_t shuffle_rle_compress(const std::byte *src, std::size_t n, std::size_t s,
+                                        std::vector<std::byte> &planes,
+                                        std::vector<std::byte> &dst) {
+  const std::size_t count = n / s;
+  planes.resize(n);
+  for (std::size_t b = 0; b < s; ++b)
+    for (std::size_t i = 0; i < count; ++i)
+      planes[b * count + i] = src[i * s + b];
+
+  dst.resize(n);
+  std::size_t o = 0, i = 0, lit = 0;
+  auto flush = [&](std::size_t end) {
+    // Literals [lit, end) in packets of at most 128.
+    while (lit < end) {
+      const std::size_t len = std::min<std::size_t>(128, end - lit);
+      if (o + 1 + len >= n)
+        return false;
+      dst[o++] = static_cast<std::byte>(len - 1);
+      std::memcpy(dst.data() + o, planes.data() + lit, len);
+      o += len;
+      lit += len;
+    }
+    return true;
+  };
+  while (i < n) {
+    std::size_t run = 1;
+    while (i + run < n && run < 130 && planes[i + run] == planes[i])
+      ++run;
+    if (run < 3) {
+      i += run;
+      continue;
+    }
+    if (!flush(i) || o + 2 >= n)
+      return 0;
+    dst[o++] = static_cast<std::byte>(run + 125);
+    dst[o++] = planes[i];
+    i += run;
+    lit = i;
+  }
+  if (!flush(n))
+    return 0;
+  return o;
+}
+
+inline void shuffle_rle_decompress(const std::byte *src, std::size_t n, std::size_t s,
+                                   std::byte *dst, std::size_t raw) {
+  std::vector<std::byte> planes(raw);
+  std::size_t i = 0, o = 0;
+  while (i < n) {
+    const auto c = static_cast<unsigned char>(src[i++]);
+    if (c < 128) {
+      if (i + c + 1 > n || o + c + 1 > raw)
+        throw std::runtime_error("checkpoint: corrupt chunk");
+      std::memcpy(planes.data() + o, src + i, c + 1);
+      i += c + 1;
+      o += c + 1;
+    } else {
+      const std::size_t run = c - 125u;
+      if (i >= n || o + run > raw)
+        throw std::runtime_error("checkpoint: corrupt chunk");
+      std::memset(planes.data() + o, static_cast<int>(src[i++]), run);
+      o += run;
+    }
+  }
+  if (o != raw)
+    throw std::runtime_error("checkpoint: corrupt chunk");
+  const std::size_t count = raw / s;
+  for (std::size_t b = 0; b < s; ++b)
+    for (std::size_t k = 0; k < count; ++k)
+      dst[k * s + b] = planes[b * count + k];
+}
+
+inline void pwrite_all(int fd, const void *p, std::size_t n, std::uint64_t offset) {
+  const char *c = static_cast<const char *>(p);
+  while (n > 0) {
+    const ssize_t w = ::pwrite(fd, c, n, static_cast<off_t>(offset));
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      throw_errno("checkpoint: pwrite");
+    }
+    c += w;
+    n -= w;
+    offset += w;
+  }
+}
+
+inline void pread_all(int fd, void *p, std::size_t n, std::uint64_t offset) {
+  char *c = static_cast<char *>(p);
+  while (n > 0) {
+    const ssize_t r = ::pread(fd, c, n, static_cast<off_t>(offset));
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r < 0)
+      throw_errno("checkpoint: pread");
+    if (r == 0)
+      throw std::runtime_error("checkpoint: truncated file");
+    c += r;
+    n -= r;
+    offset += r;
+  }
+}
+
+// Copies the elements [first, first + count) of m, in layout_right order of
+// its extents, to (pack) or from buf.
+template <bool pack, class T, class E, class L, class A, class U>
+void checkpoint_copy(std::mdspan<T, E, L, A> m, std::size_t first, std::size_t count, U *buf) {
+  if constexpr (std::is_same_v<L, std::layout_right> &&
+                std::is_same_v<A, std::default_accessor<T>>) {
+    if constexpr (pack)
+      std::memcpy(buf, m.data_handle() + first, count * sizeof(U));
+    else
+      std::memcpy(m.data_handle() + first, buf, count * sizeof(U));
+  } else {
+    constexpr std::size_t R = E::rank();
+    std::array<typename E::index_type, R> idx;
+    for (std::size_t d = R, f = first; d-- > 0;) {
+      idx[d] = static_cast<typename E::index_type>(f % m.extent(d));
+      f /= m.extent(d);
+    }
+    for (std::size_t k = 0; k < count; ++k) {
+      if constexpr (pack)
+        buf[k] = m[idx];
+      else
+        m[idx] = buf[k];
+      for (std::size_t d = R; d-- > 0;) {
+        if (++idx[d] < m.extent(d))
+          break;
+        idx[d] = 0;
+      }
+    }
+  }
+}
+
+struct file_descriptor {
+  int fd;
+  explicit file_descriptor(int f) : fd(f) {}
+  file_descriptor(const file_descriptor &) = delete;
+  file_descriptor &operator=(const file_descriptor &) = delete;
+  ~file_descriptor() {
+    if (fd >= 0)
+      ::close(fd);
+  }
+};
+
+struct aligned_delete {
+  void operator()(std::byte *p) const {
+    ::operator delete[](p, std::align_val_t{checkpoint_header::alignment});
+  }
+};
+
+} // namespace impl
+
+class checkpoint_writer {
+public:
+  explicit checkpoint_writer(checkpoint_options opt = {}) : opt_(opt) {
+    if (opt_.chunk_bytes == 0 || opt_.chunk_bytes % checkpoint_header::alignment != 0)
+      throw std::invalid_argument("checkpoint: chunk_bytes must be a multiple of 4096");
+    slots_ = std::max<std::size_t>(2, opt_.max_staging_bytes / opt_.chunk_bytes);
+    staging_.reset(new (std::align_val_t{checkpoint_header::alignment})
+                       std::byte[slots_ * opt_.chunk_bytes]);
+    for (std::size_t s = 0; s < slots_; ++s)
+      free_.push_back(s);
+    thread_ = std::thread([this] { run(); });
+  }
+
+  checkpoint_writer(const checkpoint_writer &) = delete;
+  checkpoint_writer &operator=(const checkpoint_writer &) = delete;
+
+  // Completes the pending checkpoints.
+  ~checkpoint_writer() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    task_ready_.notify_one();
+    thread_.join();
+  }
+
+  std::size_t staging_bytes() const { return slots_ * opt_.chunk_bytes; }
+
+  // Throws std::system_error if path cannot be created; write errors are
+  // reported through the future.
+  template <class T, class E, class L, class A>
+  std::future<checkpoint_stats> save(const std::string &path, std::mdspan<T, E, L, A> m) {
+    using value_type = std::remove_cv_t<T>;
+    constexpr std::size_t R = E::rank();
+    static_assert(R >= 1 && R <= checkpoint_header::max_rank);
+    static_assert(checkpoint_header::alignment % sizeof(value_type) == 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    auto j = std::make_shared<job>();
+    j->start = start;
+    j->element_size = sizeof(value_type);
+    j->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (j->fd < 0)
+      impl::throw_errno("open " + path);
+
+    j->header.type = mdfile_type_of<value_type>();
+    j->header.element_size = sizeof(value_type);
+    j->header.rank = R;
+    j->header.chunk_bytes = opt_.chunk_bytes;
+    for (std::size_t d = 0; d < R; ++d)
+      j->header.extents[d] = m.extent(d);
+    auto result = j->promise.get_future();
+
+    const std::size_t per_chunk = opt_.chunk_bytes / sizeof(value_type);
+    const std::size_t size = m.size();
+    // At least one task, the last one completing the file.
+    for (std::size_t first = 0;; first += per_chunk) {
+      const std::size_t count = std::min(per_chunk, size - first);
+      const std::size_t s = count > 0 ? acquire() : no_slot;
+      if (count > 0)
+        impl::checkpoint_copy<true>(m, first, count, reinterpret_cast<value_type *>(slot(s)));
+      const bool last = first + per_chunk >= size;
+      if (last)
+        j->stats.snapshot_seconds = seconds_since(start);
+      push({j, s, count * sizeof(value_type), last});
+      if (last)
+        break;
+    }
+    return result;
+  }
+
+  template <class T, class E, class L, class C>
+  std::future<checkpoint_stats> save(const std::string &path,
+                                     const std::experimental::mdarray<T, E, L, C> &a) {
+    return save(path, a.to_mdspan());
+  }
+
+private:
+  static constexpr std::size_t no_slot = static_cast<std::size_t>(-1);
+
+  struct job {
+    int fd = -1;
+    std::size_t element_size = 0;
+    std::uint64_t offset = checkpoint_header::alignment;
+    checkpoint_header header;
+    std::vector<checkpoint_chunk> index;
+    checkpoint_stats stats;
+    std::chrono::steady_clock::time_point start;
+    std::exception_ptr error;
+    std::promise<checkpoint_stats> promise;
+  };
+
+  struct task {
+    std::shared_ptr<job> j;
+    std::size_t slot;
+    std::size_t bytes;
+    bool last;
+  };
+
+  checkpoint_options opt_;
+  std::size_t slots_ = 0;
+  std::unique_ptr<std::byte[], impl::aligned_delete> staging_;
+  std::mutex mutex_;
+  std::condition_variable task_ready_, slot_free_;
+  std::deque<task> tasks_;
+  std::vector<std::size_t> free_;
+  bool stop_ = false;
+  std::thread thread_;
+
+  static double seconds_since(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+  }
+
+  std::byte *slot(std::size_t s) const { return staging_.get() + s * opt_.chunk_bytes; }
+
+  std::size_t acquire() {
+    std::unique_lock lock(mutex_);
+    slot_free_.wait(lock, [&] { return !free_.empty(); });
+    const std::size_t s = free_.back();
+    free_.pop_back();
+    return s;
+  }
+
+  void release(std::size_t s) {
+    {
+      std::lock_guard lock(mutex_);
+      free_.push_back(s);
+    }
+    slot_free_.notify_one();
+  }
+
+  void push(task t) {
+    {
+      std::lock_guard lock(mutex_);
+      tasks_.push_back(std::move(t));
+    }
+    task_ready_.notify_one();
+  }
+
+  void run() {
+    std::vector<std::byte> planes, compressed;
+    while (true) {
+      task t;
+      {
+        std::unique_lock lock(mutex_);
+        task_ready_.wait(lock, [&] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty())
+          return;
+        t = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      job &j = *t.j;
+      if (t.slot != no_slot) {
+        if (!j.error) {
+          try {
+            write_chunk(j, slot(t.slot), t.bytes, planes, compressed);
+          } catch (...) {
+            j.error = std::current_exception();
+          }
+        }
+        release(t.slot);
+      }
+      if (t.last)
+        finish(j);
+    }
+  }
+
+  void write_chunk(job &j, const std::byte *raw, std::size_t n, std::vector<std::byte> &planes,
+                   std::vector<std::byte> &compressed) {
+    checkpoint_chunk c{j.offset, n, n, impl::crc32c(raw, n), checkpoint_codec::none};
+    const std::byte *data = raw;
+    if (opt_.codec == checkpoint_codec::shuffle_rle) {
+      if (const std::size_t s =
+              impl::shuffle_rle_compress(raw, n, j.element_size, planes, compressed)) {
+        data = compressed.data();
+        c.stored_bytes = s;
+        c.codec = checkpoint_codec::shuffle_rle;
+      }
+    }
+    impl::pwrite_all(j.fd, data, c.stored_bytes, c.offset);
+    constexpr std::uint64_t a = checkpoint_header::alignment;
+    j.offset += (c.stored_bytes + a - 1) / a * a;
+    j.index.push_back(c);
+    j.stats.raw_bytes += c.raw_bytes;
+    j.stats.stored_bytes += c.stored_bytes;
+  }
+
+  void finish(job &j) {
+    if (!j.error) {
+      try {
+        j.header.chunk_count = j.index.size();
+        j.header.index_offset = j.offset;
+        impl::pwrite_all(j.fd, j.index.data(), j.index.size() * sizeof(checkpoint_chunk),
+                         j.offset);
+        std::vector<char> page(checkpoint_header::alignment, 0);
+        std::memcpy(page.data(), &j.header, sizeof(j.header));
+        impl::pwrite_all(j.fd, page.data(), page.size(), 0);
+        if (opt_.sync && ::fdatasync(j.fd) != 0)
+          impl::throw_errno("checkpoint: fdatasync");
+      } catch (...) {
+        j.error = std::current_exception();
+      }
+    }
+    ::close(j.fd);
+    if (j.error) {
+      j.promise.set_exception(j.error);
+    } else {
+      j.stats.chunks = j.index.size();
+      j.stats.total_seconds = seconds_since(j.start);
+      j.promise.set_value(j.stats);
+    }
+  }
+};
+
+template <class T, class E, class L, class A>
+void read_checkpoint(const std::string &path, std::mdspan<T, E, L, A> m) {
+  using value_type = std::remove_cv_t<T>;
+  constexpr std::size_t R = E::rank();
+
+  const impl::file_descriptor file(::open(path.c_str(), O_RDONLY));
+  if (file.fd < 0)
+    impl::throw_errno("open " + path);
+  const int fd = file.fd;
+
+  checkpoint_header h;
+  impl::pread_all(fd, &h, sizeof(h), 0);
+  if (std::memcmp(h.magic, checkpoint_header{}.magic, sizeof(h.magic)) != 0 ||
+      h.byte_order != checkpoint_header{}.byte_order)
+    throw std::runtime_error(path + ": not a checkpoint or incompatible byte order");
+  if (h.type != mdfile_type_of<value_type>() || h.element_size != sizeof(value_type))
+    throw std::runtime_error("checkpoint: element type mismatch");
+  if (h.rank != R)
+    throw std::runtime_error("checkpoint: rank mismatch");
+  for (std::size_t d = 0; d < R; ++d)
+    if (h.extents[d] != static_cast<std::uint64_t>(m.extent(d)))
+      throw std::runtime_error("checkpoint: extents mismatch");
+
+  std::vector<checkpoint_chunk> index(h.chunk_count);
+  impl::pread_all(fd, index.data(), index.size() * sizeof(checkpoint_chunk), h.index_offset);
+
+  std::vector<std::byte> stored, raw;
+  std::size_t first = 0;
+  for (const checkpoint_chunk &c : index) {
+    if (c.raw_bytes > h.chunk_bytes || c.stored_bytes > c.raw_bytes ||
+        c.raw_bytes % sizeof(value_type) != 0 ||
+        first + c.raw_bytes / sizeof(value_type) > m.size())
+      throw std::runtime_error("checkpoint: corrupt index");
+    stored.resize(c.stored_bytes);
+    impl::pread_all(fd, stored.data(), stored.size(), c.offset);
+    const std::byte *data = stored.data();
+    if (c.codec == checkpoint_codec::shuffle_rle) {
+      raw.resize(c.raw_bytes);
+      impl::shuffle_rle_decompress(stored.data(), stored.size(), sizeof(value_type), raw.data(),
+                                   raw.size());
+      data = raw.data();
+    } else if (c.codec != checkpoint_codec::none || c.stored_bytes != c.raw_bytes) {
+      throw std::runtime_error("checkpoint: corrupt index");
+    }
+    if (impl::crc32c(data, c.raw_bytes) != c.checksum)
+      throw std::runtime_error("checkpoint: checksum mismatch");
+
+    // The chunk buffers are only byte aligned.
+    std::vector<value_type> elements(c.raw_bytes / sizeof(value_type));
+    std::memcpy(elements.data(), data, c.raw_bytes);
+    impl::checkpoint_copy<false>(m, first, elements.size(), elements.data());
+    first += elements.size();
+  }
+  if (first != m.size())
+    throw std::runtime_error("checkpoint: truncated file");
+}
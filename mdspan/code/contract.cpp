@@ -0,0 +1,289 @@
+#include "contract.hpp"
+#include "tiled_layouts.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <vector>
+
+// Small integers, so that every sum is exact.
+void fill(std::vector<double> &v, int seed) {
+  for (std::size_t i = 0; i < v.size(); ++i)
+    v[i] = double((i * 7 + seed) % 11) - 5;
+}
+
+template <class... I> auto dext(I... i) { return std::dextents<int, sizeof...(I)>{i...}; }
+
+void test_contract() {
+  const int I = 37, J = 6, K = 5, L = 41;
+  std::vector<double> a(I * J * K), b(K * J * L), c(I * L), r(I * L);
+  fill(a, 1);
+  fill(b, 2);
+
+  // C[i, l] = sum A[i, j, k] B[k, j, l]: the k, j order of B differs from
+  // the j, k order of A, the smaller operand is permuted.
+  auto A = std::mdspan(a.data(), dext(I, J, K));
+  auto B = std::mdspan(b.data(), dext(K, J, L));
+  auto R = std::mdspan(r.data(), dext(I, L));
+  for (int i = 0; i < I; ++i)
+    for (int l = 0; l < L; ++l) {
+      double s = 0;
+      for (int j = 0; j < J; ++j)
+        for (int k = 0; k < K; ++k)
+          s += A[i, j, k] * B[k, j, l];
+      R[i, l] = s;
+    }
+  auto C = std::mdspan(c.data(), dext(I, L));
+  contract_info info = contract(A, "ijk", B, "kjl", C, "il");
+  assert(info.gemm && info.m == I && info.n == L && info.k == J * K);
+  assert(info.copies == 1 && info.copied_elements == a.size());
+  assert(c == r);
+
+  // The direct loop and the parallel GEMM give the same result.
+  std::fill(c.begin(), c.end(), 0.);
+  info = contract(A, "ijk", B, "kjl", C, "il", {.lowering = contract_lowering::loops});
+  assert(!info.gemm && c == r);
+  std::fill(c.begin(), c.end(), 0.);
+  contract(std::execution::par, A, "ijk", B, "kjl", C, "il");
+  assert(c == r);
+
+  // With B stored as [j, k, l] the k, j axes line up: no copy.
+  std::vector<double> bt(b.size());
+  auto Bt = std::mdspan(bt.data(), dext(J, K, L));
+  permute_copy(B, Bt, {1, 0, 2});
+  info = contract(A, "ijk", Bt, "jkl", C, "il");
+  assert(info.gemm && info.copies == 0 && c == r);
+
+  // C^T = B^T A^T into a layout_left C, accumulating: still no copy.
+  std::vector<double> ct(c.size(), 1.);
+  auto Ct = std::mdspan<double, std::dextents<int, 2>, std::layout_left>(ct.data(), I, L);
+  info = contract(Bt, "jkl", A, "ijk", Ct, "il", {.accumulate = true});
+  assert(info.copies == 0);
+  for (int i = 0; i < I; ++i)
+    for (int l = 0; l < L; ++l)
+      assert((Ct[i, l] == R[i, l] + 1));
+
+  // C[i, l, j] = sum A[i, j, k] B[k, l]: the i, j axes of C are not evenly
+  // strided, C is computed in a temporary and permuted back.
+  std::vector<double> c3(I * L * J);
+  auto B2 = std::mdspan(b.data(), dext(K, L));
+  auto C3 = std::mdspan(c3.data(), dext(I, L, J));
+  info = contract(A, "ijk", B2, "kl", C3, "ilj", {.lowering = contract_lowering::gemm});
+  assert(info.copies == 1 && info.copied_elements == c3.size() && info.m == I * J);
+  for (int i = 0; i < I; ++i)
+    for (int l = 0; l < L; ++l)
+      for (int j = 0; j < J; ++j) {
+        double s = 0;
+        for (int k = 0; k < K; ++k)
+          s += A[i, j, k] * B2[k, l];
+        assert((C3[i, l, j] == s));
+      }
+
+  // Batched: D[b, i, l] = sum_k E[b, i, k] F[b, k, l].
+  const int NB = 3, N = 40;
+  std::vector<double> e(NB * N * N), f(NB * N * N), d(NB * N * N);
+  fill(e, 3);
+  fill(f, 4);
+  auto E = std::mdspan(e.data(), dext(NB, N, N)), F = std::mdspan(f.data(), dext(NB, N, N));
+  auto D = std::mdspan(d.data(), dext(NB, N, N));
+  info = contract(E, "bik", F, "bkl", D, "bil");
+  assert(info.gemm && info.batch == NB && info.copies == 0);
+  for (int bb = 0; bb < NB; ++bb)
+    for (int i = 0; i < N; ++i)
+      for (int l = 0; l < N; ++l) {
+        double s = 0;
+        for (int k = 0; k < N; ++k)
+          s += E[bb, i, k] * F[bb, k, l];
+        assert((D[bb, i, l] == s));
+      }
+
+  // Trace, outer product and an index summed over one input only.
+  double t = 0;
+  std::mdspan T(&t, std::extents<int>{});
+  std::vector<double> one(1, 1.);
+  contract(std::mdspan(e.data(), dext(N, N)), "ii", std::mdspan(one.data(), dext(1)), "x", T, "");
+  double trace = 0;
+  for (int i = 0; i < N; ++i)
+    trace += e[i * N + i];
+  assert(t == trace);
+
+  std::vector<double> outer(I * L);
+  contract(std::mdspan(a.data(), dext(I)), "i", std::mdspan(b.data(), dext(L)), "l",
+           std::mdspan(outer.data(), dext(I, L)), "il", {.lowering = contract_lowering::gemm});
+  for (int i = 0; i < I; ++i)
+    for (int l = 0; l < L; ++l)
+      assert(outer[i * L + l] == a[i] * b[l]);
+
+  std::vector<double> y(I);
+  contract(A, "ijk", std::mdspan(b.data(), dext(K)), "k", std::mdspan(y.data(), dext(I)), "i");
+  for (int i = 0; i < I; ++i) {
+    double s = 0;
+    for (int j = 0; j < J; ++j)
+      for (int k = 0; k < K; ++k)
+        s += A[i, j, k] * b[k];
+    assert(y[i] == s);
+  }
+
+  // A tiled operand is copied to a contiguous temporary.
+  using tiled = layout_tiled<8, 8>;
+  using ext2 = std::dextents<int, 2>;
+  std::vector<double> g(tiled::mapping<ext2>(ext2{N, N}).required_span_size());
+  std::mdspan G(g.data(), tiled::mapping<ext2>(ext2{N, N}));
+  for (int i = 0; i < N; ++i)
+    for (int k = 0; k < N; ++k)
+      G[i, k] = E[0, i, k];
+  std::vector<double> h(N * N);
+  contract(G, "ik", std::submdspan(F, 0, std::full_extent, std::full_extent), "kl",
+           std::mdspan(h.data(), dext(N, N)), "il");
+  assert(std::equal(h.begin(), h.end(), d.begin()));
+
+  bool thrown = false;
+  try {
+    contract(A, "ijk", B, "kjl", C, "iq");
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  assert(thrown);
+  thrown = false;
+  try {
+    contract(A, "ijk", B, "jkl", C, "il");
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // Chains: (M M) x is n^3, M (M x) is 2 n^2.
+  const std::map<char, std::size_t> sizes{{'i', 1000}, {'j', 1000}, {'k', 1000}};
+  const contract_path best = contraction_path({"ij", "jk", "k"}, "i", sizes);
+  assert((best.steps == std::vector<std::pair<std::size_t, std::size_t>>{{1, 2}, {0, 1}}));
+  assert(best.flops == 2e6);
+  const contract_path greedy =
+      contraction_path({"ij", "jk", "k"}, "i", sizes, contract_path_strategy::greedy);
+  assert(greedy.flops == best.flops);
+  assert(contraction_path({"ij", "jk", "k"}, "i", sizes, contract_path_strategy::left_to_right)
+             .flops == 1e9 + 1e6);
+
+  std::vector<double> m1(N * N), m2(N * N), x(N), z(N), z1(N, 0.), z2(N, 0.);
+  fill(m1, 5);
+  fill(m2, 6);
+  fill(x, 7);
+  auto M1 = std::mdspan(m1.data(), dext(N, N)), M2 = std::mdspan(m2.data(), dext(N, N));
+  auto X = std::mdspan(x.data(), dext(N));
+  const contract_path p = contract_chain({{M1, "ij"}, {M2, "jk"}, {X, "k"}},
+                                         std::mdspan(z.data(), dext(N)), "i");
+  assert((p.steps.front() == std::pair<std::size_t, std::size_t>(1, 2)));
+  for (int j = 0; j < N; ++j)
+    for (int k = 0; k < N; ++k)
+      z1[j] += M2[j, k] * x[k];
+  for (int i = 0; i < N; ++i)
+    for (int j = 0; j < N; ++j)
+      z2[i] += M1[i, j] * z1[j];
+  assert(z == z2);
+}
+
+// The custom loop nests contract() replaces.
+template <class MA, class MB, class MC> void loops_ijk_kjl(MA A, MB B, MC C) {
+  for (int i = 0; i < C.extent(0); ++i)
+    for (int l = 0; l < C.extent(1); ++l) {
+      double s = 0;
+      for (int j = 0; j < A.extent(1); ++j)
+        for (int k = 0; k < A.extent(2); ++k)
+          s += A[i, j, k] * B[k, j, l];
+      C[i, l] = s;
+    }
+}
+
+template <class MA, class MB, class MC> void loops_abcd_cdef(MA A, MB B, MC C) {
+  for (int a = 0; a < A.extent(0); ++a)
+    for (int b = 0; b < A.extent(1); ++b)
+      for (int e = 0; e < B.extent(2); ++e)
+        for (int f = 0; f < B.extent(3); ++f) {
+          double s = 0;
+          for (int c = 0; c < A.extent(2); ++c)
+            for (int d = 0; d < A.extent(3); ++d)
+              s += A[a, b, c, d] * B[c, d, e, f];
+          C[a, b, e, f] = s;
+        }
+}
+
+void bench(int n) {
+  // ijk,kjl->il with i = l = n, j = k = n / 8.
+  {
+    const int m = n / 8;
+    std::vector<double> a(n * m * m), b(m * m * n), c1(n * n), c2(n * n);
+    fill(a, 1);
+    fill(b, 2);
+    auto A = std::mdspan(a.data(), dext(n, m, m)), B = std::mdspan(b.data(), dext(m, m, n));
+    auto C1 = std::mdspan(c1.data(), dext(n, n)), C2 = std::mdspan(c2.data(), dext(n, n));
+    Timer t1;
+    loops_ijk_kjl(A, B, C1);
+    const double t_loops = t1.elapsed();
+    Timer t2;
+    contract(A, "ijk", B, "kjl", C2, "il");
+    const double t_seq = t2.elapsed();
+    Timer t3;
+    contract(std::execution::par, A, "ijk", B, "kjl", C2, "il");
+    const double t_par = t3.elapsed();
+    assert(c1 == c2);
+    std::cout << "ijk,kjl->il, " << n << ", " << t_loops << ", " << t_seq << ", " << t_par
+              << std::endl;
+  }
+  // abcd,cdef->abef with all extents n / 16.
+  {
+    const int m = n / 16, m4 = m * m * m * m;
+    std::vector<double> a(m4), b(m4), c1(m4), c2(m4);
+    fill(a, 3);
+    fill(b, 4);
+    auto A = std::mdspan(a.data(), dext(m, m, m, m)), B = std::mdspan(b.data(), dext(m, m, m, m));
+    auto C1 = std::mdspan(c1.data(), dext(m, m, m, m)), C2 = std::mdspan(c2.data(), dext(m, m, m, m));
+    Timer t1;
+    loops_abcd_cdef(A, B, C1);
+    const double t_loops = t1.elapsed();
+    Timer t2;
+    contract(A, "abcd", B, "cdef", C2, "abef");
+    const double t_seq = t2.elapsed();
+    Timer t3;
+    contract(std::execution::par, A, "abcd", B, "cdef", C2, "abef");
+    const double t_par = t3.elapsed();
+    assert(c1 == c2);
+    std::cout << "abcd,cdef->abef, " << n << ", " << t_loops << ", " << t_seq << ", " << t_par
+              << std::endl;
+  }
+}
+
+// A chain y = M1 M2 M3 x, left to right and in the order of contraction_path.
+void bench_chain(int n) {
+  std::vector<double> m1(n * n), m2(n * n), m3(n * n), x(n), y1(n), y2(n);
+  fill(m1, 1);
+  fill(m2, 2);
+  fill(m3, 3);
+  fill(x, 4);
+  auto M1 = std::mdspan(m1.data(), dext(n, n)), M2 = std::mdspan(m2.data(), dext(n, n)),
+       M3 = std::mdspan(m3.data(), dext(n, n));
+  auto X = std::mdspan(x.data(), dext(n));
+  const std::vector<contract_operand<double>> ops{{M1, "ij"}, {M2, "jk"}, {M3, "kl"}, {X, "l"}};
+
+  Timer t1;
+  const contract_path p1 = contract_chain(ops, std::mdspan(y1.data(), dext(n)), "i",
+                                          {.path = contract_path_strategy::left_to_right});
+  const double t_ltr = t1.elapsed();
+  Timer t2;
+  const contract_path p2 = contract_chain(ops, std::mdspan(y2.data(), dext(n)), "i");
+  const double t_auto = t2.elapsed();
+  assert(y1 == y2);
+  std::cout << "chain, " << n << ", left to right " << p1.flops << " flops " << t_ltr
+            << " s, chosen " << p2.flops << " flops " << t_auto << " s" << std::endl;
+}
+
+// Usage: contract_example [<n>]
+int main(int argc, char **argv) {
+  test_contract();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 256;
+
+  std::cout << "contraction, n, loops [s], contract [s], contract par [s]" << std::endl;
+  bench(n);
+  bench_chain(2 * n);
+}
@@ -0,0 +1,829 @@
+#pragma once
+
+#include "permute_copy.hpp"
+
+#include <experimental/mdspan>
+#include <experimental/simd>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Tensor contractions over mdspans with einsum-style subscripts:
+//
+//   contract(A, "ijk", B, "kjl", C, "il");   // C[i, l] = sum A[i, j, k] B[k, j, l]
+//
+// Each letter names an axis. Letters of C that are in both A and B are batch
+// axes, the others are free axes of A (m) or of B (n); letters of A and B
+// that are not in C are summed (k). A letter repeated in an input takes its
+// diagonal, a letter in only one input is summed over that input.
+//
+// The contraction is lowered to a batched GEMM C_b[m, n] = A_b[m, k] B_b[k, n]
+// by flattening the m, n and k axes of each operand into one:
+//  - the axes of a group are taken in the order of decreasing stride of one
+//    of the operands; when they are evenly strided in every operand (e.g.
+//    "ijk,jkl->il" on layout_right or layout_left data) the operand is used
+//    in place as a strided matrix,
+//  - otherwise the operand is permuted into a contiguous temporary with
+//    permute_copy (the transpose-transpose-GEMM-transpose scheme), C being
+//    copied back at the end. Among the possible group orders the one copying
+//    the fewest elements is chosen.
+// The GEMM packs blocks of A and B, so any strides of the flattened matrices
+// are fine, and runs a simd micro-kernel; the blocks of C are distributed with
+// the execution policy. When the copies would cost more than half the
+// multiply-adds, or for tiny contractions, a direct loop over the operands is
+// used instead. contract returns what was done in a contract_info.
+//
+// Chains of contractions are done pairwise:
+//
+//   contract_chain({{A, "ij"}, {B, "jk"}, {x, "k"}}, y, "i");
+//
+// in an order chosen by contraction_path: an exhaustive search of the pairwise
+// orders for up to 6 operands, the greedy heuristic of opt_einsum (the pair
+// with the smallest result first) beyond. The intermediates are contiguous
+// temporaries.
+//
+// Operands with other layouts or accessors are copied into contiguous
+// temporaries. Bad subscripts or mismatched extents throw
+// std::invalid_argument. Operands have at most 8 axes.
+
+enum class contract_lowering { automatic, gemm, loops };
+
+enum class contract_path_strategy { automatic, greedy, optimal, left_to_right };
+
+struct contract_options {
+  // C += A B instead of C = A B.
+  bool accumulate = false;
+  contract_lowering lowering = contract_lowering::automatic;
+  contract_path_strategy path = contract_path_strategy::automatic;
+};
+
+struct contract_info {
+  bool gemm = false;
+  std::size_t batch = 1;
+  std::size_t m = 1;
+  std::size_t n = 1;
+  std::size_t k = 1;
+  // Operands permuted into temporaries for the GEMM, and their elements.
+  int copies = 0;
+  std::size_t copied_elements = 0;
+};
+
+// Each step contracts operands first < second of the current list: their
+// product replaces first and second is removed. flops counts multiply-adds.
+struct contract_path {
+  std::vector<std::pair<std::size_t, std::size_t>> steps;
+  double flops = 0;
+};
+
+namespace impl {
+
+namespace stdx = std::experimental;
+
+inline constexpr std::size_t contract_max_rank = 8;
+// Below this many multiply-adds the direct loop is used.
+inline constexpr double contract_min_gemm_flops = 32768;
+
+inline constexpr std::size_t gemm_mr = 4;
+inline constexpr std::size_t gemm_mc = 128;
+inline constexpr std::size_t gemm_kc = 256;
+inline constexpr std::size_t gemm_nc = 1024;
+
+template <class T> constexpr std::size_t gemm_nr() {
+  if constexpr (std::is_arithmetic_v<T>)
+    return 2 * stdx::native_simd<T>::size();
+  else
+    return 4;
+}
+
+// A strided tensor with one letter per axis.
+template <class T> struct tensor_ref {
+  T *p = nullptr;
+  std::string sub;
+  std::vector<std::size_t> ext;
+  std::vector<std::ptrdiff_t> str;
+
+  std::size_t rank() const { return sub.size(); }
+  std::size_t axis(char c) const { return sub.find(c); }
+  bool has(char c) const { return axis(c) != std::string::npos; }
+  std::ptrdiff_t stride(char c) const {
+    const std::size_t k = axis(c);
+    return k == std::string::npos ? 0 : str[k];
+  }
+  std::size_t size() const {
+    return std::accumulate(ext.begin(), ext.end(), std::size_t{1}, std::multiplies<>());
+  }
+  void push(char c, std::size_t e, std::ptrdiff_t s) {
+    sub += c;
+    ext.push_back(e);
+    str.push_back(s);
+  }
+};
+
+template <class T, class M> tensor_ref<T> make_tensor_ref(T *p, const M &map, std::string_view sub) {
+  if (sub.size() != M::extents_type::rank())
+    throw std::invalid_argument("contract: subscripts \"" + std::string(sub) +
+                                "\" do not match the rank");
+  tensor_ref<T> r;
+  r.p = p;
+  for (std::size_t k = 0; k < sub.size(); ++k)
+    r.push(sub[k], map.extents().extent(k), map.stride(k));
+  return r;
+}
+
+// Row-major over buf, with the letters of sub.
+template <class T>
+tensor_ref<T> contiguous_ref(T *buf, const std::string &sub, const std::array<std::size_t, 256> &ext) {
+  tensor_ref<T> r;
+  r.p = buf;
+  std::ptrdiff_t s = 1;
+  for (char c : sub)
+    r.push(c, ext[static_cast<unsigned char>(c)], 0);
+  for (std::size_t k = sub.size(); k-- > 0;) {
+    r.str[k] = s;
+    s *= static_cast<std::ptrdiff_t>(r.ext[k]);
+  }
+  return r;
+}
+
+// dst[i...] = src[i...], matching the axes by letter.
+template <class ExecutionPolicy, class S, class T>
+void copy_tensor(ExecutionPolicy &&policy, const tensor_ref<S> &src, const tensor_ref<T> &dst) {
+  if (dst.rank() > contract_max_rank)
+    throw std::invalid_argument("contract: more than 8 axes");
+  std::array<std::size_t, contract_max_rank> ext;
+  std::array<std::ptrdiff_t, contract_max_rank> ss{}, ds{};
+  ext.fill(1);
+  for (std::size_t k = 0; k < dst.rank(); ++k) {
+    ext[k] = dst.ext[k];
+    ss[k] = src.stride(dst.sub[k]);
+    ds[k] = dst.str[k];
+  }
+  permute_copy_strided(policy, src.p, dst.p, ext, ss, ds);
+}
+
+// A repeated letter is the diagonal: one axis with the sum of the strides.
+template <class T> void merge_repeated(tensor_ref<T> &r) {
+  for (std::size_t k = 0; k < r.rank(); ++k) {
+    const std::size_t first = r.axis(r.sub[k]);
+    if (first == k)
+      continue;
+    if (r.ext[first] != r.ext[k])
+      throw std::invalid_argument(std::string("contract: extents mismatch for index '") +
+                                  r.sub[k] + "'");
+    r.str[first] += r.str[k];
+    r.sub.erase(k, 1);
+    r.ext.erase(r.ext.begin() + k);
+    r.str.erase(r.str.begin() + k);
+    --k;
+  }
+}
+
+// Extent and stride of the axes g of r, in that order, as a single axis;
+// false if they are not evenly strided. An empty group has extent 1.
+template <class T>
+bool flatten(const tensor_ref<T> &r, const std::string &g, std::size_t &n, std::ptrdiff_t &s) {
+  n = 1;
+  s = 0;
+  bool first = true;
+  for (std::size_t t = g.size(); t-- > 0;) {
+    const std::size_t k = r.axis(g[t]);
+    if (r.ext[k] == 1)
+      continue;
+    if (first) {
+      s = r.str[k];
+      first = false;
+    } else if (r.str[k] != s * static_cast<std::ptrdiff_t>(n)) {
+      return false;
+    }
+    n *= r.ext[k];
+  }
+  return true;
+}
+
+template <class T> bool flattens(const tensor_ref<T> &r, const std::string &g) {
+  std::size_t n;
+  std::ptrdiff_t s;
+  return flatten(r, g, n, s);
+}
+
+template <class T> struct gemm_view {
+  T *p;
+  std::ptrdiff_t rs;
+  std::ptrdiff_t cs;
+};
+
+// Panels of gemm_mr rows of the mc x kc block at a: ap[(panel kc + l) mr + r].
+template <class T>
+void gemm_pack_a(const T *a, std::ptrdiff_t rs, std::ptrdiff_t cs, std::size_t mc, std::size_t kc,
+                 T *ap) {
+  for (std::size_t ip = 0; ip < mc; ip += gemm_mr, ap += kc * gemm_mr) {
+    for (std::size_t r = 0; r < gemm_mr; ++r) {
+      if (ip + r < mc) {
+        const T *row = a + static_cast<std::ptrdiff_t>(ip + r) * rs;
+        for (std::size_t l = 0; l < kc; ++l)
+          ap[l * gemm_mr + r] = row[static_cast<std::ptrdiff_t>(l) * cs];
+      } else {
+        for (std::size_t l = 0; l < kc; ++l)
+          ap[l * gemm_mr + r] = T{};
+      }
+    }
+  }
+}
+
+// Panels of nr columns of the kc x nc block at b: bp[(panel kc + l) nr + c].
+template <class T>
+void gemm_pack_b(const T *b, std::ptrdiff_t rs, std::ptrdiff_t cs, std::size_t kc, std::size_t nc,
+                 T *bp) {
+  constexpr std::size_t nr = gemm_nr<T>();
+  for (std::size_t jp = 0; jp < nc; jp += nr) {
+    const std::size_t w = std::min(nr, nc - jp);
+    for (std::size_t l = 0; l < kc; ++l, bp += nr) {
+      const T *row = b + static_cast<std::ptrdiff_t>(l) * rs + static_cast<std::ptrdiff_t>(jp) * cs;
+      if (cs == 1) {
+        std::copy(row, row + w, bp);
+      } else {
+        for (std::size_t c = 0; c < w; ++c)
+          bp[c] = row[static_cast<std::ptrdiff_t>(c) * cs];
+      }
+      std::fill(bp + w, bp + nr, T{});
+    }
+  }
+}
+
+// c[0:mr, 0:nr] (+)= ap bp over kc.
+template <class T>
+void gemm_micro(std::size_t kc, const T *ap, const T *bp, T *c, std::ptrdiff_t rs, std::ptrdiff_t cs,
+                std::size_t mr, std::size_t nr, bool add) {
+  constexpr std::size_t NR = gemm_nr<T>();
+  if constexpr (std::is_arithmetic_v<T>) {
+    using V = stdx::native_simd<T>;
+    constexpr std::size_t W = V::size();
+    V acc[gemm_mr][2];
+    for (auto &row : acc)
+      row[0] = row[1] = V(T{});
+    for (std::size_t l = 0; l < kc; ++l, ap += gemm_mr, bp += NR) {
+      const V b0(bp, stdx::element_aligned), b1(bp + W, stdx::element_aligned);
+      for (std::size_t r = 0; r < gemm_mr; ++r) {
+        const V a(ap[r]);
+        acc[r][0] += a * b0;
+        acc[r][1] += a * b1;
+      }
+    }
+    for (std::size_t r = 0; r < mr; ++r) {
+      T *row = c + static_cast<std::ptrdiff_t>(r) * rs;
+      if (cs == 1 && nr == NR) {
+        for (std::size_t q = 0; q < 2; ++q) {
+          V v = acc[r][q];
+          if (add)
+            v += V(row + q * W, stdx::element_aligned);
+          v.copy_to(row + q * W, stdx::element_aligned);
+        }
+      } else {
+        for (std::size_t j = 0; j < nr; ++j) {
+          T &x = row[static_cast<std::ptrdiff_t>(j) * cs];
+          x = (add ? x : T{}) + acc[r][j / W][j % W];
+        }
+      }
+    }
+  } else {
+    T acc[gemm_mr][NR] = {};
+    for (std::size_t l = 0; l < kc; ++l, ap += gemm_mr, bp += NR)
+      for (std::size_t r = 0; r < gemm_mr; ++r)
+        for (std::size_t j = 0; j < NR; ++j)
+          acc[r][j] += ap[r] * bp[j];
+    for (std::size_t r = 0; r < mr; ++r)
+      for (std::size_t j = 0; j < nr; ++j) {
+        T &x = c[static_cast<std::ptrdiff_t>(r) * rs + static_cast<std::ptrdiff_t>(j) * cs];
+        x = (add ? x : T{}) + acc[r][j];
+      }
+  }
+}
+
+// For every batch offset {oa, ob, oc}: C[m, n] (+)= A[m, k] B[k, n] with the
+// matrices at a.p + oa, b.p + ob, c.p + oc. The gemm_mc x gemm_nc blocks of
+// C are distributed with the policy; each packs its blocks of A and B.
+template <class ExecutionPolicy, class T>
+void gemm_batched(ExecutionPolicy &&policy, std::size_t m, std::size_t n, std::size_t k,
+                  gemm_view<const T> a, gemm_view<const T> b, gemm_view<T> c,
+                  const std::vector<std::array<std::ptrdiff_t, 3>> &batch, bool accumulate) {
+  if (m == 0 || n == 0)
+    return;
+  const std::size_t ntm = (m + gemm_mc - 1) / gemm_mc;
+  const std::size_t ntn = (n + gemm_nc - 1) / gemm_nc;
+  std::vector<std::size_t> ids(batch.size() * ntm * ntn);
+  std::iota(ids.begin(), ids.end(), std::size_t{0});
+
+  std::for_each(std::forward<ExecutionPolicy>(policy), ids.begin(), ids.end(), [&](std::size_t id) {
+    constexpr std::size_t nr = gemm_nr<T>();
+    const std::size_t tn = id % ntn;
+    id /= ntn;
+    const std::size_t tm = id % ntm;
+    const auto [oa, ob, oc] = batch[id / ntm];
+    const std::size_t i0 = tm * gemm_mc, mc = std::min(gemm_mc, m - i0);
+    const std::size_t j0 = tn * gemm_nc, nc = std::min(gemm_nc, n - j0);
+    T *cb = c.p + oc + static_cast<std::ptrdiff_t>(i0) * c.rs + static_cast<std::ptrdiff_t>(j0) * c.cs;
+
+    if (k == 0) {
+      if (!accumulate)
+        for (std::size_t i = 0; i < mc; ++i)
+          for (std::size_t j = 0; j < nc; ++j)
+            cb[static_cast<std::ptrdiff_t>(i) * c.rs + static_cast<std::ptrdiff_t>(j) * c.cs] = T{};
+      return;
+    }
+
+    thread_local std::vector<T> ap, bp;
+    ap.resize(gemm_mc * gemm_kc);
+    bp.resize(gemm_kc * (gemm_nc + nr));
+    for (std::size_t l0 = 0; l0 < k; l0 += gemm_kc) {
+      const std::size_t kc = std::min(gemm_kc, k - l0);
+      gemm_pack_a(a.p + oa + static_cast<std::ptrdiff_t>(i0) * a.rs + static_cast<std::ptrdiff_t>(l0) * a.cs,
+                  a.rs, a.cs, mc, kc, ap.data());
+      gemm_pack_b(b.p + ob + static_cast<std::ptrdiff_t>(l0) * b.rs + static_cast<std::ptrdiff_t>(j0) * b.cs,
+                  b.rs, b.cs, kc, nc, bp.data());
+      const bool add = accumulate || l0 > 0;
+      // A panel of B stays in L1 while it meets every panel of the A block.
+      for (std::size_t jr = 0; jr < nc; jr += nr)
+        for (std::size_t ir = 0; ir < mc; ir += gemm_mr)
+          gemm_micro(kc, ap.data() + ir * kc, bp.data() + jr * kc,
+                     cb + static_cast<std::ptrdiff_t>(ir) * c.rs + static_cast<std::ptrdiff_t>(jr) * c.cs,
+                     c.rs, c.cs, std::min(gemm_mr, mc - ir), std::min(nr, nc - jr), add);
+    }
+  });
+}
+
+// c[o...] (+)= sum over the letters ks of a[...] b[...], one output element
+// at a time. For contractions the GEMM lowering doesn't pay for.
+template <class ExecutionPolicy, class T>
+void contract_loops(ExecutionPolicy &&policy, const tensor_ref<const T> &a, const tensor_ref<const T> &b,
+                    const tensor_ref<T> &c, const std::string &ks, bool accumulate) {
+  struct axis {
+    std::size_t ext;
+    std::ptrdiff_t sa, sb, sc;
+  };
+  std::vector<axis> out, sum;
+  for (std::size_t k = 0; k < c.rank(); ++k)
+    out.push_back({c.ext[k], a.stride(c.sub[k]), b.stride(c.sub[k]), c.str[k]});
+  for (char l : ks)
+    sum.push_back({a.has(l) ? a.ext[a.axis(l)] : b.ext[b.axis(l)], a.stride(l), b.stride(l), 0});
+
+  const std::size_t size = c.size();
+  const std::size_t nsum = std::accumulate(sum.begin(), sum.end(), std::size_t{1},
+                                           [](std::size_t s, const axis &x) { return s * x.ext; });
+  constexpr std::size_t grain = 256;
+  std::vector<std::size_t> ids((size + grain - 1) / grain);
+  std::iota(ids.begin(), ids.end(), std::size_t{0});
+
+  std::for_each(std::forward<ExecutionPolicy>(policy), ids.begin(), ids.end(), [&](std::size_t id) {
+    for (std::size_t e = id * grain; e < std::min(size, (id + 1) * grain); ++e) {
+      std::ptrdiff_t oa = 0, ob = 0, oc = 0;
+      for (std::size_t f = e, k = out.size(); k-- > 0;) {
+        const auto i = static_cast<std::ptrdiff_t>(f % out[k].ext);
+        f /= out[k].ext;
+        oa += i * out[k].sa;
+        ob += i * out[k].sb;
+        oc += i * out[k].sc;
+      }
+      T s{};
+      for (std::size_t t = 0; t < nsum; ++t) {
+        std::ptrdiff_t ia = oa, ib = ob;
+        for (std::size_t f = t, k = sum.size(); k-- > 0;) {
+          const auto i = static_cast<std::ptrdiff_t>(f % sum[k].ext);
+          f /= sum[k].ext;
+          ia += i * sum[k].sa;
+          ib += i * sum[k].sb;
+        }
+        s += a.p[ia] * b.p[ib];
+      }
+      c.p[oc] = accumulate ? c.p[oc] + s : s;
+    }
+  });
+}
+
+template <class ExecutionPolicy, class T>
+contract_info contract_refs(ExecutionPolicy &&policy, tensor_ref<const T> a, tensor_ref<const T> b,
+                            const tensor_ref<T> &c, const contract_options &opt) {
+  merge_repeated(a);
+  merge_repeated(b);
+  if (a.rank() > contract_max_rank || b.rank() > contract_max_rank || c.rank() > contract_max_rank)
+    throw std::invalid_argument("contract: more than 8 axes");
+
+  std::array<std::size_t, 256> ext{};
+  std::array<bool, 256> known{};
+  auto note = [&](const auto &r) {
+    for (std::size_t k = 0; k < r.rank(); ++k) {
+      const auto l = static_cast<unsigned char>(r.sub[k]);
+      if (known[l] && ext[l] != r.ext[k])
+        throw std::invalid_argument(std::string("contract: extents mismatch for index '") +
+                                    r.sub[k] + "'");
+      known[l] = true;
+      ext[l] = r.ext[k];
+    }
+  };
+  note(a);
+  note(b);
+  note(c);
+
+  std::string bs, ms, ns, ks;
+  for (std::size_t k = 0; k < c.rank(); ++k) {
+    const char l = c.sub[k];
+    if (c.axis(l) != k)
+      throw std::invalid_argument(std::string("contract: repeated output index '") + l + "'");
+    if (a.has(l) && b.has(l))
+      bs += l;
+    else if (a.has(l))
+      ms += l;
+    else if (b.has(l))
+      ns += l;
+    else
+      throw std::invalid_argument(std::string("contract: output index '") + l + "' not in the inputs");
+  }
+  // A letter of a single input is summed against a broadcast of the other.
+  for (std::size_t k = 0; k < a.rank(); ++k)
+    if (!c.has(a.sub[k])) {
+      ks += a.sub[k];
+      if (!b.has(a.sub[k]))
+        b.push(a.sub[k], a.ext[k], 0);
+    }
+  for (std::size_t k = 0; k < b.rank(); ++k)
+    if (!c.has(b.sub[k]) && !a.has(b.sub[k])) {
+      ks += b.sub[k];
+      a.push(b.sub[k], b.ext[k], 0);
+    }
+
+  contract_info info;
+  auto product = [&](const std::string &g) {
+    std::size_t s = 1;
+    for (char l : g)
+      s *= ext[static_cast<unsigned char>(l)];
+    return s;
+  };
+  info.batch = product(bs);
+  info.m = product(ms);
+  info.n = product(ns);
+  info.k = product(ks);
+
+  // The orders of the groups, each following the strides of one of its
+  // operands, that copy the fewest elements.
+  auto by_stride = [](const auto &r, std::string g) {
+    std::stable_sort(g.begin(), g.end(), [&](char x, char y) { return r.stride(x) > r.stride(y); });
+    return g;
+  };
+  const std::size_t c_copy = c.size() * (opt.accumulate ? 2 : 1);
+  std::string mo, no, ko;
+  bool ca = false, cb = false, cc = false;
+  std::size_t copied = std::numeric_limits<std::size_t>::max();
+  for (const std::string &m1 : {by_stride(c, ms), by_stride(a, ms)})
+    for (const std::string &n1 : {by_stride(c, ns), by_stride(b, ns)})
+      for (const std::string &k1 : {by_stride(a, ks), by_stride(b, ks)}) {
+        const bool xa = !(flattens(a, m1) && flattens(a, k1));
+        const bool xb = !(flattens(b, k1) && flattens(b, n1));
+        const bool xc = !(flattens(c, m1) && flattens(c, n1));
+        const std::size_t x = (xa ? a.size() : 0) + (xb ? b.size() : 0) + (xc ? c_copy : 0);
+        if (x < copied) {
+          copied = x;
+          mo = m1, no = n1, ko = k1;
+          ca = xa, cb = xb, cc = xc;
+        }
+      }
+
+  const double flops = double(info.batch) * double(info.m) * double(info.n) * double(info.k);
+  const bool gemm = opt.lowering == contract_lowering::gemm ||
+                    (opt.lowering == contract_lowering::automatic &&
+                     flops >= contract_min_gemm_flops && double(copied) <= flops / 2);
+  if (!gemm) {
+    contract_loops(policy, a, b, c, ks, opt.accumulate);
+    return info;
+  }
+
+  info.gemm = true;
+  info.copies = int(ca) + int(cb) + int(cc);
+  info.copied_elements = copied;
+
+  std::vector<T> ta, tb, tc;
+  tensor_ref<const T> ra = a, rb = b;
+  tensor_ref<T> rc = c;
+  if (ca) {
+    ta.resize(a.size());
+    const auto r = contiguous_ref(ta.data(), bs + mo + ko, ext);
+    copy_tensor(policy, a, r);
+    ra = {r.p, r.sub, r.ext, r.str};
+  }
+  if (cb) {
+    tb.resize(b.size());
+    const auto r = contiguous_ref(tb.data(), bs + ko + no, ext);
+    copy_tensor(policy, b, r);
+    rb = {r.p, r.sub, r.ext, r.str};
+  }
+  if (cc) {
+    tc.resize(c.size());
+    rc = contiguous_ref(tc.data(), bs + mo + no, ext);
+    if (opt.accumulate)
+      copy_tensor(policy, tensor_ref<const T>{c.p, c.sub, c.ext, c.str}, rc);
+  }
+
+  std::size_t n_;
+  gemm_view<const T> ga{ra.p, 0, 0}, gb{rb.p, 0, 0};
+  gemm_view<T> gc{rc.p, 0, 0};
+  flatten(ra, mo, n_, ga.rs);
+  flatten(ra, ko, n_, ga.cs);
+  flatten(rb, ko, n_, gb.rs);
+  flatten(rb, no, n_, gb.cs);
+  flatten(rc, mo, n_, gc.rs);
+  flatten(rc, no, n_, gc.cs);
+
+  std::vector<std::array<std::ptrdiff_t, 3>> offsets(info.batch);
+  for (std::size_t t = 0; t < info.batch; ++t) {
+    std::array<std::ptrdiff_t, 3> o{};
+    for (std::size_t f = t, k = bs.size(); k-- > 0;) {
+      const std::size_t e = ext[static_cast<unsigned char>(bs[k])];
+      const auto i = static_cast<std::ptrdiff_t>(f % e);
+      f /= e;
+      o[0] += i * ra.stride(bs[k]);
+      o[1] += i * rb.stride(bs[k]);
+      o[2] += i * rc.stride(bs[k]);
+    }
+    offsets[t] = o;
+  }
+  gemm_batched(policy, info.m, info.n, info.k, ga, gb, gc, offsets, opt.accumulate);
+
+  if (cc)
+    copy_tensor(policy, tensor_ref<const T>{rc.p, rc.sub, rc.ext, rc.str}, c);
+  return info;
+}
+
+// Calls f with a tensor_ref over C, or over a contiguous copy of it for
+// other layouts and accessors.
+template <class ExecutionPolicy, class CT, class CE, class CL, class CA, class F>
+void with_output(ExecutionPolicy &&policy, std::mdspan<CT, CE, CL, CA> C, std::string_view sub,
+                 bool accumulate, F &&f) {
+  constexpr std::size_t R = CE::rank();
+  if constexpr (CL::template mapping<CE>::is_always_strided() && is_default_accessor_v<CA>) {
+    f(make_tensor_ref(C.data_handle(), C.mapping(), sub));
+  } else {
+    using T = typename std::mdspan<CT, CE, CL, CA>::value_type;
+    std::array<std::size_t, R> ext, axes;
+    for (std::size_t k = 0; k < R; ++k)
+      ext[k] = C.extent(k);
+    std::iota(axes.begin(), axes.end(), std::size_t{0});
+    std::vector<T> tmp(C.size());
+    std::mdspan<T, std::dextents<std::size_t, R>> M(tmp.data(), ext);
+    if (accumulate)
+      permute_copy(policy, C, M, axes);
+    f(make_tensor_ref(M.data_handle(), M.mapping(), sub));
+    permute_copy(policy, M, C, axes);
+  }
+}
+
+inline constexpr std::uint64_t bit(std::size_t k) { return std::uint64_t{1} << k; }
+
+// Letters of a pairwise product that are still needed.
+inline std::uint64_t path_keep(const std::vector<std::uint64_t> &ops, std::size_t i, std::size_t j,
+                               std::uint64_t out) {
+  std::uint64_t rest = out;
+  for (std::size_t t = 0; t < ops.size(); ++t)
+    if (t != i && t != j)
+      rest |= ops[t];
+  return (ops[i] | ops[j]) & rest;
+}
+
+inline double path_size(std::uint64_t mask, const std::vector<double> &ext) {
+  double s = 1;
+  for (std::size_t k = 0; mask; ++k, mask >>= 1)
+    if (mask & 1)
+      s *= ext[k];
+  return s;
+}
+
+inline void path_search(std::vector<std::uint64_t> &ops, std::uint64_t out, const std::vector<double> &ext,
+                        contract_path &current, contract_path &best) {
+  if (current.flops >= best.flops)
+    return;
+  if (ops.size() == 1) {
+    best = current;
+    return;
+  }
+  for (std::size_t i = 0; i < ops.size(); ++i)
+    for (std::size_t j = i + 1; j < ops.size(); ++j) {
+      const double cost = path_size(ops[i] | ops[j], ext);
+      std::vector<std::uint64_t> next = ops;
+      next[i] = path_keep(ops, i, j, out);
+      next.erase(next.begin() + j);
+      current.steps.push_back({i, j});
+      current.flops += cost;
+      path_search(next, out, ext, current, best);
+      current.flops -= cost;
+      current.steps.pop_back();
+    }
+}
+
+} // namespace impl
+
+inline contract_path contraction_path(const std::vector<std::string> &inputs, std::string_view output,
+                                      const std::map<char, std::size_t> &extents,
+                                      contract_path_strategy strategy = contract_path_strategy::automatic) {
+  std::array<int, 256> bit;
+  bit.fill(-1);
+  std::vector<double> ext;
+  auto mask = [&](std::string_view s) {
+    std::uint64_t m = 0;
+    for (char c : s) {
+      int &b = bit[static_cast<unsigned char>(c)];
+      if (b < 0) {
+        const auto e = extents.find(c);
+        if (e == extents.end())
+          throw std::invalid_argument(std::string("contract: no extent for index '") + c + "'");
+        if (ext.size() == 64)
+          throw std::invalid_argument("contract: more than 64 indices");
+        b = static_cast<int>(ext.size());
+        ext.push_back(double(e->second));
+      }
+      m |= impl::bit(b);
+    }
+    return m;
+  };
+  std::vector<std::uint64_t> ops;
+  for (const std::string &s : inputs)
+    ops.push_back(mask(s));
+  const std::uint64_t out = mask(output);
+
+  contract_path path;
+  if (ops.size() <= 1) {
+    path.flops = ops.empty() ? 0 : impl::path_size(ops[0], ext);
+    return path;
+  }
+  if (strategy == contract_path_strategy::automatic)
+    strategy = ops.size() <= 6 ? contract_path_strategy::optimal : contract_path_strategy::greedy;
+
+  if (strategy == contract_path_strategy::optimal) {
+    contract_path current;
+    path.flops = std::numeric_limits<double>::infinity();
+    impl::path_search(ops, out, ext, current, path);
+    return path;
+  }
+
+  while (ops.size() > 1) {
+    std::size_t bi = 0, bj = 1;
+    if (strategy == contract_path_strategy::greedy) {
+      // Pairs sharing an index first, then the smallest growth of the
+      // intermediates, then the cheapest.
+      std::tuple<bool, double, double> best{true, 0, std::numeric_limits<double>::infinity()};
+      for (std::size_t i = 0; i < ops.size(); ++i)
+        for (std::size_t j = i + 1; j < ops.size(); ++j) {
+          const double growth = impl::path_size(impl::path_keep(ops, i, j, out), ext) -
+                                impl::path_size(ops[i], ext) - impl::path_size(ops[j], ext);
+          const std::tuple<bool, double, double> key{(ops[i] & ops[j]) == 0, growth,
+                                                     impl::path_size(ops[i] | ops[j], ext)};
+          if (key < best) {
+            best = key;
+            bi = i, bj = j;
+          }
+        }
+    }
+    path.flops += impl::path_size(ops[bi] | ops[bj], ext);
+    path.steps.push_back({bi, bj});
+    ops[bi] = impl::path_keep(ops, bi, bj, out);
+    ops.erase(ops.begin() + bj);
+  }
+  return path;
+}
+
+// An input of contract_chain: a strided view of an mdspan, or a contiguous
+// copy of it for other layouts and accessors.
+template <class T> class contract_operand {
+public:
+  template <class E, class X, class L, class A>
+  contract_operand(std::mdspan<E, X, L, A> m, std::string_view sub) {
+    if constexpr (L::template mapping<X>::is_always_strided() && impl::is_default_accessor_v<A> &&
+                  std::is_same_v<std::remove_const_t<E>, T>) {
+      ref_ = impl::make_tensor_ref<const T>(m.data_handle(), m.mapping(), sub);
+    } else {
+      constexpr std::size_t R = X::rank();
+      std::array<std::size_t, R> ext, axes;
+      for (std::size_t k = 0; k < R; ++k)
+        ext[k] = m.extent(k);
+      std::iota(axes.begin(), axes.end(), std::size_t{0});
+      storage_ = std::make_shared<std::vector<T>>(m.size());
+      std::mdspan<T, std::dextents<std::size_t, R>> M(storage_->data(), ext);
+      permute_copy(m, M, axes);
+      ref_ = impl::make_tensor_ref<const T>(M.data_handle(), M.mapping(), sub);
+    }
+  }
+
+  const impl::tensor_ref<const T> &ref() const { return ref_; }
+  const std::string &subscripts() const { return ref_.sub; }
+
+private:
+  std::shared_ptr<std::vector<T>> storage_;
+  impl::tensor_ref<const T> ref_;
+};
+
+template <class E, class X, class L, class A>
+contract_operand(std::mdspan<E, X, L, A>, std::string_view)
+    -> contract_operand<typename std::mdspan<E, X, L, A>::value_type>;
+
+template <class ExecutionPolicy, class AT, class AE, class AL, class AA, class BT, class BE, class BL,
+          class BA, class CT, class CE, class CL, class CA>
+  requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+contract_info contract(ExecutionPolicy &&policy, std::mdspan<AT, AE, AL, AA> A, std::string_view sa,
+                       std::mdspan<BT, BE, BL, BA> B, std::string_view sb,
+                       std::mdspan<CT, CE, CL, CA> C, std::string_view sc,
+                       const contract_options &opt = {}) {
+  using T = typename std::mdspan<CT, CE, CL, CA>::value_type;
+  const contract_operand<T> a(A, sa), b(B, sb);
+  contract_info info;
+  impl::with_output(policy, C, sc, opt.accumulate, [&](const impl::tensor_ref<T> &c) {
+    info = impl::contract_refs(policy, a.ref(), b.ref(), c, opt);
+  });
+  return info;
+}
+
+template <class AT, class AE, class AL, class AA, class BT, class BE, class BL, class BA, class CT,
+          class CE, class CL, class CA>
+contract_info contract(std::mdspan<AT, AE, AL, AA> A, std::string_view sa,
+                       std::mdspan<BT, BE, BL, BA> B, std::string_view sb,
+                       std::mdspan<CT, CE, CL, CA> C, std::string_view sc,
+                       const contract_options &opt = {}) {
+  return contract(std::execution::seq, A, sa, B, sb, C, sc, opt);
+}
+
+// C = the product of the operands, contracted pairwise in the order of
+// contraction_path with opt.path. Returns the path.
+template <class ExecutionPolicy, class CT, class CE, class CL, class CA>
+  requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+contract_path contract_chain(
+    ExecutionPolicy &&policy,
+    const std::type_identity_t<std::vector<contract_operand<std::remove_const_t<CT>>>> &operands,
+    std::mdspan<CT, CE, CL, CA> C, std::string_view sc, const contract_options &opt = {}) {
+  using T = std::remove_const_t<CT>;
+  std::map<char, std::size_t> extents;
+  std::vector<std::string> subs;
+  std::vector<impl::tensor_ref<const T>> ops;
+  for (const auto &op : operands) {
+    const auto &r = op.ref();
+    for (std::size_t k = 0; k < r.rank(); ++k)
+      extents.emplace(r.sub[k], r.ext[k]);
+    subs.push_back(r.sub);
+    ops.push_back(r);
+  }
+  for (std::size_t k = 0; k < sc.size() && k < CE::rank(); ++k)
+    extents.emplace(sc[k], C.extent(k));
+  const contract_path path = contraction_path(subs, sc, extents, opt.path);
+
+  static const T one(1);
+  std::vector<std::vector<T>> intermediates;
+  impl::with_output(policy, C, sc, opt.accumulate, [&](const impl::tensor_ref<T> &c) {
+    if (ops.size() == 1) {
+      impl::contract_refs(policy, ops[0], impl::tensor_ref<const T>{&one, {}, {}, {}}, c, opt);
+      return;
+    }
+    for (std::size_t s = 0; s < path.steps.size(); ++s) {
+      const auto [i, j] = path.steps[s];
+      if (s + 1 == path.steps.size()) {
+        impl::contract_refs(policy, ops[i], ops[j], c, opt);
+        break;
+      }
+      // The letters still needed, in the order of the operands.
+      std::string keep;
+      std::array<std::size_t, 256> ext{};
+      for (const auto *r : {&ops[i], &ops[j]})
+        for (std::size_t k = 0; k < r->rank(); ++k) {
+          const char l = r->sub[k];
+          ext[static_cast<unsigned char>(l)] = r->ext[k];
+          bool needed = sc.find(l) != std::string_view::npos;
+          for (std::size_t t = 0; t < ops.size(); ++t)
+            needed = needed || (t != i && t != j && ops[t].has(l));
+          if (needed && keep.find(l) == std::string::npos)
+            keep += l;
+        }
+      std::size_t size = 1;
+      for (char l : keep)
+        size *= ext[static_cast<unsigned char>(l)];
+      const auto t = impl::contiguous_ref(intermediates.emplace_back(size).data(), keep, ext);
+      impl::contract_refs(policy, ops[i], ops[j], t,
+                          {.accumulate = false, .lowering = opt.lowering});
+      ops[i] = {t.p, t.sub, t.ext, t.str};
+      ops.erase(ops.begin() + j);
+    }
+  });
+  return path;
+}
+
+template <class CT, class CE, class CL, class CA>
+contract_path contract_chain(
+    const std::type_identity_t<std::vector<contract_operand<std::remove_const_t<CT>>>> &operands,
+    std::mdspan<CT, CE, CL, CA> C, std::string_view sc, const contract_options &opt = {}) {
+  return contract_chain(std::execution::seq, operands, C, sc, opt);
+}
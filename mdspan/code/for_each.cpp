@@ -0,0 +1,125 @@
+#include "for_each.hpp"
+#include "tiled_layouts.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <ranges>
+#include <vector>
+
+void test_for_each() {
+  std::vector<int> v(6 * 7 * 5);
+  auto R = std::mdspan(v.data(), std::dextents<int, 3>{6, 7, 5});
+  mdspan_for_each(R, [](int &x) { x = 1; });
+  for (int x : v)
+    assert(x == 1);
+
+  // A strided submdspan: only its elements are visited.
+  auto S = std::submdspan(R, std::strided_slice{.offset = 1, .extent = 5, .stride = 2},
+                          std::full_extent, std::pair{1, 4});
+  mdspan_for_each(std::execution::par, S, [](int &x) { x += 10; });
+  int visited = 0;
+  for (int x : v)
+    visited += x == 11;
+  assert(visited == 3 * 7 * 3);
+
+  // Non-strided layout.
+  auto T = std::mdspan<int, std::dextents<int, 2>, layout_tiled<4, 4>>(v.data(), 5, 6);
+  mdspan_for_each(std::execution::par, T, [](int &x) { x = 2; });
+  int twos = 0;
+  for (int x : v)
+    twos += x == 2;
+  assert(twos == 5 * 6);
+}
+
+void test_transform() {
+  const int m = 67, n = 130;
+  std::vector<double> a(m * n), b(m * n), c(m * n);
+  for (int i = 0; i < m * n; ++i) {
+    a[i] = i;
+    b[i] = 2 * i;
+  }
+
+  // Same layout: collapsed to a single contiguous run, with simd.
+  auto A = std::mdspan(a.data(), std::dextents<int, 2>{m, n});
+  auto B = std::mdspan(b.data(), std::dextents<int, 2>{m, n});
+  auto C = std::mdspan(c.data(), std::dextents<int, 2>{m, n});
+  mdspan_transform(std::execution::par, A, B, C, simd_op([](auto x, auto y) { return x + y; }));
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      assert((C[i, j] == 3 * (i * n + j)));
+
+  // layout_left input, layout_right output: tiled.
+  auto AL = std::mdspan<double, std::dextents<int, 2>, std::layout_left>(a.data(), m, n);
+  mdspan_transform(AL, C, [](double x) { return -x; });
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      assert((C[i, j] == -AL[i, j]));
+
+  // Three inputs, one of them strided, and a different output type.
+  std::vector<float> d(m * n / 2);
+  auto D = std::mdspan(d.data(), std::dextents<int, 2>{m / 2, n});
+  auto A2 = std::submdspan(A, std::strided_slice{.offset = 0, .extent = m - 1, .stride = 2}, std::full_extent);
+  auto B2 = std::submdspan(B, std::pair{0, m / 2}, std::full_extent);
+  auto AL2 = std::submdspan(AL, std::pair{0, m / 2}, std::full_extent);
+  mdspan_transform(std::execution::par, A2, B2, AL2, D,
+                   [](double x, double y, double z) { return float(x - y + z); });
+  for (int i = 0; i < m / 2; ++i)
+    for (int j = 0; j < n; ++j)
+      assert((D[i, j] == float(A2[i, j] - B2[i, j] + AL2[i, j])));
+}
+
+// The traversal of mdspan.cpp: nested iota_view loops in index order.
+template <class M> void naive_scale(M m, float s) {
+  for (int i : std::ranges::iota_view(0, int(m.extent(0))))
+    for (int j : std::ranges::iota_view(0, int(m.extent(1))))
+      m[i, j] *= s;
+}
+
+template <class X, class Y, class Z> void naive_add(X x, Y y, Z z) {
+  for (int i : std::ranges::iota_view(0, int(z.extent(0))))
+    for (int j : std::ranges::iota_view(0, int(z.extent(1))))
+      z[i, j] = x[i, j] + y[i, j];
+}
+
+void bench(int n, int reps) {
+  std::vector<float> a(std::size_t(n) * n, 1.f), b(a.size(), 2.f), c(a.size());
+  auto AL = std::mdspan<float, std::dextents<int, 2>, std::layout_left>(a.data(), n, n);
+  auto BL = std::mdspan<float, std::dextents<int, 2>, std::layout_left>(b.data(), n, n);
+  auto CL = std::mdspan<float, std::dextents<int, 2>, std::layout_left>(c.data(), n, n);
+  auto CR = std::mdspan(c.data(), std::dextents<int, 2>{n, n});
+  const double bytes1 = 2. * a.size() * sizeof(float);
+  const double bytes3 = 3. * a.size() * sizeof(float);
+  auto add = [](auto x, auto y) { return x + y; };
+
+  std::cout << "scale layout_left, " << n << ", "
+            << bytes1 / best_of(reps, [&] { naive_scale(AL, 1.0001f); }) / 1e9 << ", "
+            << bytes1 / best_of(reps, [&] { mdspan_for_each(AL, [](float &x) { x *= 1.0001f; }); }) / 1e9 << ", "
+            << bytes1 / best_of(reps, [&] { mdspan_for_each(std::execution::par, AL, [](float &x) { x *= 1.0001f; }); }) / 1e9
+            << std::endl;
+
+  std::cout << "add layout_left, " << n << ", "
+            << bytes3 / best_of(reps, [&] { naive_add(AL, BL, CL); }) / 1e9 << ", "
+            << bytes3 / best_of(reps, [&] { mdspan_transform(AL, BL, CL, simd_op(add)); }) / 1e9 << ", "
+            << bytes3 / best_of(reps, [&] { mdspan_transform(std::execution::par, AL, BL, CL, simd_op(add)); }) / 1e9
+            << std::endl;
+
+  std::cout << "add layout_left to layout_right, " << n << ", "
+            << bytes3 / best_of(reps, [&] { naive_add(AL, BL, CR); }) / 1e9 << ", "
+            << bytes3 / best_of(reps, [&] { mdspan_transform(AL, BL, CR, add); }) / 1e9 << ", "
+            << bytes3 / best_of(reps, [&] { mdspan_transform(std::execution::par, AL, BL, CR, add); }) / 1e9
+            << std::endl;
+}
+
+// Usage: for_each_example [<n> [<reps>]]
+int main(int argc, char **argv) {
+  test_for_each();
+  test_transform();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  std::cout << "kernel, n, naive [GB/s], seq [GB/s], par [GB/s]" << std::endl;
+  bench(n, reps);
+}
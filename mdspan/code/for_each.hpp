@@ -0,0 +1,387 @@
+#pragma once
+
+#include <experimental/mdspan>
+#include <experimental/simd>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <execution>
+#include <functional>
+#include <numeric>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// mdspan_for_each(policy, m, f) calls f(m[i...]) for every index of m.
+// mdspan_transform(policy, in..., out, f) sets out[i...] = f(in[i...]...),
+// all the operands must have the same extents. The order of the calls is
+// unspecified.
+//
+// For strided layouts with default accessors the loops don't follow the index
+// order but the memory order of the output:
+//  - the axes are ordered by decreasing stride of the output,
+//  - adjacent axes that are contiguous in every operand are collapsed, so that
+//    e.g. a whole layout_left matrix is a single run,
+//  - if an input has its fastest axis elsewhere (e.g. layout_left in,
+//    layout_right out), the two fastest axes are tiled,
+//  - the iteration space is split into items of a few thousand elements,
+//    distributed with the execution policy.
+// Runs with unit stride in every operand are plain pointer loops, which the
+// compiler vectorizes, or explicit simd loops for functions wrapped with
+// simd_op.
+//
+// Other layouts or accessors fall back to loops in index order, with the
+// first extent distributed with the execution policy.
+
+namespace impl {
+
+namespace stdx = std::experimental;
+
+inline constexpr std::size_t for_each_grain = 16384;
+inline constexpr std::size_t for_each_tile = 64;
+
+template <std::size_t N, std::size_t R> struct loop_nest {
+  std::size_t rank = 0;
+  std::array<std::size_t, R> ext{};
+  std::array<std::array<std::ptrdiff_t, R>, N> stride{};
+};
+
+// Orders the axes by decreasing stride of the last operand, drops axes of
+// extent 1 and merges adjacent axes that are contiguous in all the operands.
+template <std::size_t N, std::size_t R>
+loop_nest<N, R> make_loop_nest(const std::array<std::size_t, R> &ext,
+                               const std::array<std::array<std::ptrdiff_t, R>, N> &stride) {
+  std::array<std::size_t, R> order;
+  std::iota(order.begin(), order.end(), std::size_t{0});
+  std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    return std::abs(stride[N - 1][a]) > std::abs(stride[N - 1][b]);
+  });
+
+  loop_nest<N, R> nest;
+  for (std::size_t axis : order) {
+    if (ext[axis] == 1)
+      continue;
+    if (nest.rank > 0) {
+      const std::size_t last = nest.rank - 1;
+      bool contiguous = true;
+      for (std::size_t op = 0; op < N; ++op)
+        contiguous = contiguous &&
+                     nest.stride[op][last] == stride[op][axis] * std::ptrdiff_t(ext[axis]);
+      if (contiguous) {
+        nest.ext[last] *= ext[axis];
+        for (std::size_t op = 0; op < N; ++op)
+          nest.stride[op][last] = stride[op][axis];
+        continue;
+      }
+    }
+    nest.ext[nest.rank] = ext[axis];
+    for (std::size_t op = 0; op < N; ++op)
+      nest.stride[op][nest.rank] = stride[op][axis];
+    ++nest.rank;
+  }
+  return nest;
+}
+
+// Calls run(offset, stride, len) for runs of len elements covering the
+// iteration space, offset and stride being in elements of each operand.
+template <class ExecutionPolicy, std::size_t N, std::size_t R, class Run>
+void strided_loop(ExecutionPolicy &&policy, const std::array<std::size_t, R> &ext,
+                  const std::array<std::array<std::ptrdiff_t, R>, N> &stride, Run run) {
+  using offsets = std::array<std::ptrdiff_t, N>;
+
+  for (std::size_t k = 0; k < R; ++k)
+    if (ext[k] == 0)
+      return;
+
+  const loop_nest<N, R> nest = make_loop_nest(ext, stride);
+  if (nest.rank == 0) {
+    run(offsets{}, offsets{}, 1);
+    return;
+  }
+
+  // Innermost axis a, and b != a if an input is faster along b.
+  const std::size_t a = nest.rank - 1;
+  std::size_t b = a;
+  for (std::size_t op = 0; op + 1 < N && b == a; ++op) {
+    for (std::size_t k = 0; k < nest.rank; ++k) {
+      if (std::abs(nest.stride[op][k]) < std::abs(nest.stride[op][b]))
+        b = k;
+    }
+  }
+
+  std::array<std::size_t, R> outer{};
+  std::size_t n_outer_axes = 0;
+  std::size_t n_outer = 1;
+  for (std::size_t k = 0; k < nest.rank; ++k) {
+    if (k != a && k != b) {
+      outer[n_outer_axes++] = k;
+      n_outer *= nest.ext[k];
+    }
+  }
+
+  offsets sa, sb;
+  for (std::size_t op = 0; op < N; ++op) {
+    sa[op] = nest.stride[op][a];
+    sb[op] = nest.stride[op][b];
+  }
+
+  auto outer_offsets = [&](std::size_t o) {
+    offsets off{};
+    for (std::size_t k = n_outer_axes; k-- > 0;) {
+      const std::size_t axis = outer[k];
+      const std::ptrdiff_t i = o % nest.ext[axis];
+      o /= nest.ext[axis];
+      for (std::size_t op = 0; op < N; ++op)
+        off[op] += i * nest.stride[op][axis];
+    }
+    return off;
+  };
+
+  std::size_t items = 0;
+  std::size_t tile_a = 0, nta = 0, ntb = 0, rows_per_item = 1;
+  if (a == b) {
+    // Runs of at most for_each_grain elements, short rows are grouped.
+    tile_a = std::min(nest.ext[a], for_each_grain);
+    nta = (nest.ext[a] + tile_a - 1) / tile_a;
+    rows_per_item = std::max<std::size_t>(1, for_each_grain / nest.ext[a]);
+    items = (n_outer + rows_per_item - 1) / rows_per_item * nta;
+  } else {
+    tile_a = for_each_tile;
+    nta = (nest.ext[a] + tile_a - 1) / tile_a;
+    ntb = (nest.ext[b] + for_each_tile - 1) / for_each_tile;
+    items = n_outer * nta * ntb;
+  }
+
+  std::vector<std::size_t> ids(items);
+  std::iota(ids.begin(), ids.end(), std::size_t{0});
+
+  std::for_each(std::forward<ExecutionPolicy>(policy), ids.begin(), ids.end(), [&](std::size_t id) {
+    if (a == b) {
+      const std::size_t ta = id % nta;
+      const std::size_t g = id / nta;
+      const std::size_t ia0 = ta * tile_a;
+      const std::size_t na = std::min(tile_a, nest.ext[a] - ia0);
+      for (std::size_t o = g * rows_per_item; o < std::min(n_outer, (g + 1) * rows_per_item); ++o) {
+        offsets off = outer_offsets(o);
+        for (std::size_t op = 0; op < N; ++op)
+          off[op] += std::ptrdiff_t(ia0) * sa[op];
+        run(off, sa, na);
+      }
+      return;
+    }
+
+    const std::size_t tb = id % ntb;
+    id /= ntb;
+    const std::size_t ta = id % nta;
+    offsets off = outer_offsets(id / nta);
+
+    const std::size_t ia0 = ta * tile_a;
+    const std::size_t na = std::min(tile_a, nest.ext[a] - ia0);
+    const std::size_t ib0 = tb * for_each_tile;
+    const std::size_t nb = std::min(for_each_tile, nest.ext[b] - ib0);
+    for (std::size_t op = 0; op < N; ++op)
+      off[op] += std::ptrdiff_t(ia0) * sa[op] + std::ptrdiff_t(ib0) * sb[op];
+
+    for (std::size_t ib = 0; ib < nb; ++ib) {
+      offsets row = off;
+      for (std::size_t op = 0; op < N; ++op)
+        row[op] += std::ptrdiff_t(ib) * sb[op];
+      run(row, sa, na);
+    }
+  });
+}
+
+// Calls g(i...) for the indices of exts with first index in [first, last).
+template <class Extents, class G>
+void for_each_index_from(const Extents &exts, typename Extents::index_type first,
+                         typename Extents::index_type last, G &&g) {
+  constexpr std::size_t R = Extents::rank();
+  using index_type = typename Extents::index_type;
+  if constexpr (R == 0) {
+    std::apply(g, std::array<index_type, 0>{});
+  } else {
+    for (std::size_t k = 1; k < R; ++k)
+      if (exts.extent(k) == 0)
+        return;
+    std::array<index_type, R> idx{};
+    for (idx[0] = first; idx[0] < last;) {
+      std::apply(g, idx);
+      std::size_t k = R;
+      while (k-- > 1) {
+        if (++idx[k] < exts.extent(k))
+          break;
+        idx[k] = 0;
+      }
+      if (k == 0)
+        ++idx[0];
+    }
+  }
+}
+
+template <class Layout, class Extents, class Accessor>
+inline constexpr bool is_strided_default_v =
+    Layout::template mapping<Extents>::is_always_strided() &&
+    std::is_same_v<Accessor, std::default_accessor<typename Accessor::element_type>>;
+
+template <class M> std::array<std::ptrdiff_t, M::rank()> strides_of(const M &m) {
+  std::array<std::ptrdiff_t, M::rank()> s{};
+  for (std::size_t k = 0; k < M::rank(); ++k)
+    s[k] = m.stride(k);
+  return s;
+}
+
+template <class M> std::array<std::size_t, M::rank()> extents_of(const M &m) {
+  std::array<std::size_t, M::rank()> e{};
+  for (std::size_t k = 0; k < M::rank(); ++k)
+    e[k] = m.extent(k);
+  return e;
+}
+
+template <class F> struct simd_op_t {
+  F f;
+  template <class... Args> decltype(auto) operator()(Args &&...args) const {
+    return std::invoke(f, std::forward<Args>(args)...);
+  }
+};
+
+template <class F> inline constexpr bool is_simd_op_v = false;
+template <class F> inline constexpr bool is_simd_op_v<simd_op_t<F>> = true;
+
+} // namespace impl
+
+// Marks f as callable with std::experimental::native_simd arguments, e.g. a
+// generic lambda using only arithmetic. mdspan_transform then processes
+// contiguous runs of arithmetic elements of a single type a simd at a time.
+template <class F> impl::simd_op_t<std::decay_t<F>> simd_op(F &&f) {
+  return {std::forward<F>(f)};
+}
+
+template <class ExecutionPolicy, class T, class E, class L, class A, class F>
+  requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void mdspan_for_each(ExecutionPolicy &&policy, std::mdspan<T, E, L, A> m, F f) {
+  if constexpr (impl::is_strided_default_v<L, E, A>) {
+    T *p = m.data_handle();
+    impl::strided_loop(std::forward<ExecutionPolicy>(policy), impl::extents_of(m),
+                       std::array<std::array<std::ptrdiff_t, E::rank()>, 1>{impl::strides_of(m)},
+                       [&](const auto &off, const auto &st, std::size_t len) {
+                         T *q = p + off[0];
+                         if (st[0] == 1) {
+                           for (std::size_t i = 0; i < len; ++i)
+                             f(q[i]);
+                         } else {
+                           for (std::size_t i = 0; i < len; ++i)
+                             f(q[std::ptrdiff_t(i) * st[0]]);
+                         }
+                       });
+  } else if constexpr (E::rank() == 0) {
+    f(m[]);
+  } else {
+    using index_type = typename E::index_type;
+    std::vector<index_type> rows(m.extent(0));
+    std::iota(rows.begin(), rows.end(), index_type{0});
+    std::for_each(std::forward<ExecutionPolicy>(policy), rows.begin(), rows.end(), [&](index_type i) {
+      impl::for_each_index_from(m.extents(), i, i + 1, [&](auto... idx) { f(m[idx...]); });
+    });
+  }
+}
+
+template <class T, class E, class L, class A, class F>
+void mdspan_for_each(std::mdspan<T, E, L, A> m, F f) {
+  mdspan_for_each(std::execution::seq, m, f);
+}
+
+namespace impl {
+
+template <class F, class Out, class... In>
+void transform_run(F &f, Out *out, std::ptrdiff_t out_stride,
+                   const std::tuple<In *...> &in, const std::array<std::ptrdiff_t, sizeof...(In)> &in_stride,
+                   std::size_t len) {
+  [&]<std::size_t... I>(std::index_sequence<I...>) {
+    if (out_stride == 1 && ((in_stride[I] == 1) && ...)) {
+      std::size_t i = 0;
+      if constexpr (is_simd_op_v<F> && std::is_arithmetic_v<Out> &&
+                    (std::is_same_v<std::remove_const_t<In>, Out> && ...)) {
+        using simd_t = stdx::native_simd<Out>;
+        constexpr std::size_t W = simd_t::size();
+        for (; i + W <= len; i += W) {
+          const simd_t r = f(simd_t(std::get<I>(in) + i, stdx::element_aligned)...);
+          r.copy_to(out + i, stdx::element_aligned);
+        }
+      }
+      for (; i < len; ++i)
+        out[i] = f(std::get<I>(in)[i]...);
+    } else {
+      for (std::size_t i = 0; i < len; ++i) {
+        const std::ptrdiff_t k = i;
+        out[k * out_stride] = f(std::get<I>(in)[k * in_stride[I]]...);
+      }
+    }
+  }(std::index_sequence_for<In...>{});
+}
+
+template <class ExecutionPolicy, class Out, class F, class... In>
+void transform_impl(ExecutionPolicy &&policy, Out out, F &f, In... in) {
+  using E = typename Out::extents_type;
+  constexpr std::size_t R = E::rank();
+  static_assert(((In::rank() == R) && ...));
+  for (std::size_t k = 0; k < R; ++k) {
+    if (((static_cast<std::size_t>(in.extent(k)) != static_cast<std::size_t>(out.extent(k))) || ...))
+      std::terminate();
+  }
+
+  if constexpr (is_strided_default_v<typename Out::layout_type, E, typename Out::accessor_type> &&
+                (is_strided_default_v<typename In::layout_type, typename In::extents_type,
+                                      typename In::accessor_type> && ...)) {
+    constexpr std::size_t N = sizeof...(In) + 1;
+    const std::array<std::array<std::ptrdiff_t, R>, N> strides{strides_of(in)..., strides_of(out)};
+    const auto ptrs = std::tuple{in.data_handle()...};
+    auto *q = out.data_handle();
+
+    strided_loop(std::forward<ExecutionPolicy>(policy), extents_of(out), strides,
+                 [&](const std::array<std::ptrdiff_t, N> &off,
+                     const std::array<std::ptrdiff_t, N> &st, std::size_t len) {
+                   [&]<std::size_t... I>(std::index_sequence<I...>) {
+                     transform_run(f, q + off[N - 1], st[N - 1],
+                                   std::tuple{std::get<I>(ptrs) + off[I]...},
+                                   std::array<std::ptrdiff_t, N - 1>{st[I]...}, len);
+                   }(std::index_sequence_for<In...>{});
+                 });
+  } else if constexpr (R == 0) {
+    out[] = f(in[]...);
+  } else {
+    using index_type = typename E::index_type;
+    std::vector<index_type> rows(out.extent(0));
+    std::iota(rows.begin(), rows.end(), index_type{0});
+    std::for_each(std::forward<ExecutionPolicy>(policy), rows.begin(), rows.end(), [&](index_type i) {
+      for_each_index_from(out.extents(), i, i + 1, [&](auto... idx) { out[idx...] = f(in[idx...]...); });
+    });
+  }
+}
+
+} // namespace impl
+
+// mdspan_transform([policy,] in..., out, f): the output and the function
+// are the last two arguments.
+template <class ExecutionPolicy, class... Args>
+  requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void mdspan_transform(ExecutionPolicy &&policy, Args &&...args) {
+  static_assert(sizeof...(Args) >= 3, "mdspan_transform(policy, in..., out, f)");
+  auto refs = std::forward_as_tuple(std::forward<Args>(args)...);
+  constexpr std::size_t n = sizeof...(Args);
+  auto f = std::get<n - 1>(refs);
+
+  [&]<std::size_t... I>(std::index_sequence<I...>) {
+    impl::transform_impl(std::forward<ExecutionPolicy>(policy), std::get<n - 2>(refs), f,
+                           std::get<I>(refs)...);
+  }(std::make_index_sequence<n - 2>{});
+}
+
+template <class... Args>
+  requires(!std::is_execution_policy_v<std::remove_cvref_t<std::tuple_element_t<0, std::tuple<Args...>>>>)
+void mdspan_transform(Args &&...args) {
+  mdspan_transform(std::execution::seq, std::forward<Args>(args)...);
+}
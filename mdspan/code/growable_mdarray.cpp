@@ -0,0 +1,155 @@
+#include "growable_mdarray.hpp"
+#include "timer.hpp"
+
+#include <experimental/mdarray>
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using ext2 = std::dextents<int, 2>;
+
+template <class M> void check_rows(const M &a, int first, int last, int width) {
+  for (int i = first; i < last; ++i)
+    for (int j = 0; j < width; ++j)
+      assert((a[i, j] == i * width + j));
+}
+
+void test_growable(growable_options opt) {
+  const int w = 5;
+  growable_mdarray<int, ext2> a(ext2{2, w}, opt);
+  assert(a.rows() == 2 && a.capacity() >= 2 && a.size() == 10);
+  assert((a[1, 4] == 0));
+  a.clear();
+
+  // One row at a time: geometric growth.
+  std::vector<int> v(1000 * w);
+  std::iota(v.begin(), v.end(), 0);
+  int reallocations = 0;
+  for (int i = 0; i < 1000; ++i) {
+    const int cap = a.capacity();
+    a.append(std::mdspan(v.data() + i * w, std::dextents<int, 1>{w}));
+    reallocations += a.capacity() != cap;
+  }
+  assert(a.rows() == 1000 && reallocations <= std::ceil(std::log(1000. / 2) / std::log(opt.growth)));
+  check_rows(a, 0, 1000, w);
+
+  // Several rows, from another layout, and in place.
+  std::vector<int> t(3 * w);
+  std::mdspan<int, ext2, std::layout_left> T(t.data(), 3, w);
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < w; ++j)
+      T[i, j] = (1000 + i) * w + j;
+  a.append(T);
+  auto r = a.emplace_rows(2);
+  assert((r.extent(0) == 2 && r[1, 0] == 0));
+  for (int i = 0; i < 2; ++i)
+    for (int j = 0; j < w; ++j)
+      r[i, j] = (1003 + i) * w + j;
+  check_rows(a, 0, 1005, w);
+
+  // No reallocation within the capacity: views and pointers stay valid.
+  a.reserve(2000);
+  const int *p = a.data();
+  const auto view = a.to_mdspan();
+  for (int i = 1005; i < 2000; ++i)
+    a.append(std::mdspan(v.data() + (i % 1000) * w, std::dextents<int, 1>{w}));
+  assert(a.data() == p && view.extent(0) == 1005 && a.rows() == 2000);
+  check_rows(view, 0, 1005, w);
+
+  a.resize(1005);
+  a.shrink_to_fit();
+  assert(a.rows() == 1005 && a.capacity() >= 1005 && a.capacity() < 2000);
+  if (!a.uses_mremap())
+    assert(a.capacity() == 1005);
+  check_rows(a, 0, 1005, w);
+
+  // Copies and moves.
+  auto b = a;
+  auto c = std::move(a);
+  assert(a.rows() == 0 && a.capacity() == 0 && b.rows() == 1005 && c.rows() == 1005);
+  check_rows(b, 0, 1005, w);
+  check_rows(c, 0, 1005, w);
+  a = b;
+  check_rows(a, 0, 1005, w);
+}
+
+void test_growable_objects() {
+  // Static trailing extent, elements that are not trivially copyable.
+  using ext = std::extents<int, std::dynamic_extent, 3>;
+  growable_mdarray<std::string, ext> a(ext{0}, {.growth = 1.5, .mremap = true});
+  assert(!a.uses_mremap());
+  const std::string row[3] = {"a long string, not a small one", "b", "c"};
+  for (int i = 0; i < 100; ++i) {
+    a.append(std::mdspan(row, std::extents<int, 3>{}));
+    a[i, 1] += std::to_string(i);
+  }
+  a.shrink_to_fit();
+  assert((a.capacity() == 100 && a[99, 0] == row[0] && a[99, 1] == "b99"));
+}
+
+// Appends n rows of width w one by one, returns the time.
+template <class Append> double time_appends(int n, int w, Append &&append) {
+  std::vector<float> row(w);
+  Timer t;
+  for (int i = 0; i < n; ++i) {
+    row[0] = float(i);
+    append(std::mdspan(row.data(), std::dextents<int, 1>{w}));
+  }
+  return t.elapsed();
+}
+
+void bench(int n, int w) {
+  const double gb = double(n) * w * sizeof(float) * 1e-9;
+
+  // Rebuilding an mdarray for each row, on fewer rows.
+  const int n_rebuild = std::min(n, 1 << 13);
+  std::experimental::mdarray<float, ext2> m(0, w);
+  const double t_rebuild = time_appends(n_rebuild, w, [&](auto row) {
+    const int k = m.to_mdspan().extent(0);
+    std::experimental::mdarray<float, ext2> next(k + 1, w);
+    std::copy_n(m.data(), std::size_t(k) * w, next.data());
+    std::copy_n(row.data_handle(), w, next.data() + std::size_t(k) * w);
+    m = std::move(next);
+  });
+
+  std::vector<float> v;
+  const double t_vector = time_appends(n, w, [&](auto row) {
+    v.insert(v.end(), row.data_handle(), row.data_handle() + w);
+  });
+  assert(v.size() == std::size_t(n) * w);
+  v = {};
+
+  double t[3];
+  for (int k = 0; k < 3; ++k) {
+    growable_mdarray<float, ext2> a(ext2{0, w}, {.mremap = k == 1});
+    if (k == 2)
+      a.reserve(n);
+    t[k] = time_appends(n, w, [&](auto row) { a.append(row); });
+    assert((a.rows() == n && a[n - 1, 0] == float(n - 1)));
+  }
+
+  std::cout << n << ", " << w << ", " << n_rebuild / t_rebuild * 1e-6 << ", "
+            << n / t_vector * 1e-6 << ", " << n / t[0] * 1e-6 << ", " << n / t[1] * 1e-6 << ", "
+            << n / t[2] * 1e-6 << ", " << gb / t[0] << ", " << gb / t[1] << std::endl;
+}
+
+// Usage: growable_mdarray_example [<rows> [<width>]]
+int main(int argc, char **argv) {
+  test_growable({});
+  test_growable({.growth = 1.5});
+  test_growable({.mremap = true});
+  test_growable_objects();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 1 << 21;
+  const int w = argc > 2 ? std::atoi(argv[2]) : 32;
+
+  std::cout << "rows, width, rebuilt mdarray [M rows/s], vector, growable, mremap, reserved, "
+               "growable [GB/s], mremap"
+            << std::endl;
+  bench(n, w);
+}
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <experimental/mdspan>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// growable_mdarray<T, Extents>: an owning layout_right array whose leading
+// extent grows, for streams of rows (time series, event records) appended
+// one or a few at a time. std::experimental::mdarray has fixed extents, so
+// appending a row to it means building a new one and copying every row.
+//
+// Like std::vector along extent 0, the array has a capacity in rows, and
+// grows geometrically (by growable_options::growth, 2 by default) when an
+// append does not fit, so that appends are amortized O(row size). Rows are
+// contiguous in layout_right, growing appends storage after the last row and
+// the existing rows are relocated as a block:
+//  - heap storage: memcpy for trivially copyable T, else move construction,
+//  - growable_options::mremap (Linux, trivially copyable T): the storage is
+//    an anonymous mapping resized by mremap(2), which moves page table
+//    entries rather than bytes, so that large arrays grow without copying.
+//    Elsewhere, or for other T, the option is ignored.
+//
+//   growable_mdarray<float, std::dextents<int, 2>> a(std::dextents<int, 2>{0, 64});
+//   a.reserve(1 << 20);
+//   a.append(row);                // a 64 mdspan, or a k x 64 one for k rows
+//   auto r = a.emplace_rows(16);  // 16 x 64 value initialized rows to fill
+//
+// Appended rows are copied from the view given to append, which must not
+// view the array itself, or written in place through the view returned by
+// emplace_rows.
+//
+// Invalidation, as for std::vector:
+//  - Views (to_mdspan, emplace_rows), pointers and references to elements
+//    are invalidated by any reallocation: an append or emplace_rows beyond
+//    capacity(), reserve beyond capacity(), shrink_to_fit, and by the
+//    destruction of the array. capacity() tells whether an append will
+//    reallocate, reserve ahead of the appends keeps views valid.
+//  - Without reallocation, views stay valid, but have the extents of the
+//    array when they were taken: they do not see rows appended later.
+//  - resize and clear to fewer rows invalidate the views of the removed rows.
+
+struct growable_options {
+  // Capacity after an append which does not fit, in multiples of the
+  // current capacity (at least the rows needed).
+  double growth = 2.;
+  // Grow with mremap, see above.
+  bool mremap = false;
+};
+
+namespace impl {
+
+[[noreturn]] inline void growable_throw_errno(const std::string &what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace impl
+
+template <class T, class Extents> class growable_mdarray {
+  static_assert(Extents::rank() >= 1 && Extents::static_extent(0) == std::dynamic_extent,
+                "the leading extent of a growable_mdarray must be dynamic");
+
+public:
+  using extents_type = Extents;
+  using layout_type = std::layout_right;
+  using mapping_type = std::layout_right::mapping<Extents>;
+  using element_type = T;
+  using value_type = T;
+  using index_type = typename Extents::index_type;
+  using size_type = typename Extents::size_type;
+  using rank_type = typename Extents::rank_type;
+  using mdspan_type = std::mdspan<T, Extents>;
+  using const_mdspan_type = std::mdspan<const T, Extents>;
+
+  // Alignment of heap storage, for vector loads of rows.
+  static constexpr std::size_t alignment = std::max<std::size_t>(alignof(T), 64);
+
+  static constexpr rank_type rank() noexcept { return Extents::rank(); }
+
+  // exts.extent(0) value initialized rows.
+  explicit growable_mdarray(const Extents &exts, growable_options opt = {})
+      : map_(exts), opt_(opt) {
+#if defined(__linux__)
+    opt_.mremap = opt_.mremap && std::is_trivially_copyable_v<T>;
+#else
+    opt_.mremap = false;
+#endif
+    if (opt_.growth < 1.)
+      throw std::invalid_argument("growable_mdarray: growth must be at least 1");
+    const index_type n = exts.extent(0);
+    map_ = mapping_type(with_rows(0));
+    reserve(n);
+    resize(n);
+  }
+
+  growable_mdarray(const growable_mdarray &other)
+      : growable_mdarray(other.with_rows(0), other.opt_) {
+    append(other.to_mdspan());
+  }
+
+  growable_mdarray(growable_mdarray &&other) noexcept
+      : map_(other.map_), opt_(other.opt_), data_(std::exchange(other.data_, nullptr)),
+        capacity_(std::exchange(other.capacity_, 0)), bytes_(std::exchange(other.bytes_, 0)) {
+    other.map_ = mapping_type(other.with_rows(0));
+  }
+
+  growable_mdarray &operator=(growable_mdarray other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~growable_mdarray() {
+    std::destroy_n(data_, size());
+    deallocate(data_, bytes_);
+  }
+
+  void swap(growable_mdarray &other) noexcept {
+    std::swap(map_, other.map_);
+    std::swap(opt_, other.opt_);
+    std::swap(data_, other.data_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(bytes_, other.bytes_);
+  }
+
+  const extents_type &extents() const noexcept { return map_.extents(); }
+  index_type extent(rank_type r) const noexcept { return map_.extents().extent(r); }
+  const mapping_type &mapping() const noexcept { return map_; }
+  index_type rows() const noexcept { return extent(0); }
+  // Capacity in rows. With mremap, the mapping is rounded up to whole pages
+  // and the capacity to the rows that fit in them.
+  index_type capacity() const noexcept { return capacity_; }
+  // Elements per row.
+  std::size_t row_size() const noexcept {
+    std::size_t n = 1;
+    for (rank_type r = 1; r < rank(); ++r)
+      n *= static_cast<std::size_t>(extent(r));
+    return n;
+  }
+  std::size_t size() const noexcept { return static_cast<std::size_t>(rows()) * row_size(); }
+  bool uses_mremap() const noexcept { return opt_.mremap; }
+
+  T *data() noexcept { return data_; }
+  const T *data() const noexcept { return data_; }
+
+  mdspan_type to_mdspan() noexcept { return mdspan_type(data_, map_); }
+  const_mdspan_type to_mdspan() const noexcept { return const_mdspan_type(data_, map_); }
+
+  template <class... I>
+    requires(sizeof...(I) == Extents::rank() && (std::is_convertible_v<I, index_type> && ...))
+  T &operator[](I... i) {
+    return data_[map_(static_cast<index_type>(i)...)];
+  }
+
+  template <class... I>
+    requires(sizeof...(I) == Extents::rank() && (std::is_convertible_v<I, index_type> && ...))
+  const T &operator[](I... i) const {
+    return data_[map_(static_cast<index_type>(i)...)];
+  }
+
+  // Capacity for at least n rows, reallocates if n > capacity().
+  void reserve(index_type n) {
+    if (n > capacity_)
+      reallocate(n);
+  }
+
+  // Capacity for the rows only, reallocates if capacity() > rows().
+  void shrink_to_fit() {
+    if (capacity_ > rows())
+      reallocate(rows());
+  }
+
+  // n rows, new rows value initialized.
+  void resize(index_type n) {
+    if (n > rows())
+      emplace_rows(n - rows());
+    else
+      truncate(n);
+  }
+
+  void clear() noexcept { truncate(0); }
+
+  // Appends k value initialized rows, returns the view of them.
+  mdspan_type emplace_rows(index_type k) {
+    const index_type n = rows();
+    grow(n + k);
+    T *p = data_ + static_cast<std::size_t>(n) * row_size();
+    std::uninitialized_value_construct_n(p, static_cast<std::size_t>(k) * row_size());
+    map_ = mapping_type(with_rows(n + k));
+    return mdspan_type(p, with_rows(k));
+  }
+
+  // Appends a copy of rows, with the extents of a row of the array (one
+  // row), or of the array with any leading extent (rows.extent(0) rows).
+  template <class U, class E, class L, class A>
+    requires(E::rank() + 1 == Extents::rank() || E::rank() == Extents::rank())
+  void append(const std::mdspan<U, E, L, A> &rows) {
+    constexpr rank_type skip = E::rank() == Extents::rank() ? 1 : 0;
+    for (rank_type r = skip; r < E::rank(); ++r)
+      if (rows.extent(r) != extent(r + 1 - skip))
+        std::terminate();
+    const index_type k = skip ? static_cast<index_type>(rows.extent(0)) : 1;
+    const index_type n = this->rows();
+    grow(n + k);
+    T *p = data_ + static_cast<std::size_t>(n) * row_size();
+    if constexpr (std::is_same_v<std::remove_cv_t<U>, T> && std::is_trivially_copyable_v<T> &&
+                  std::is_same_v<L, std::layout_right> &&
+                  std::is_same_v<A, std::default_accessor<U>>) {
+      if (static_cast<std::size_t>(k) * row_size() > 0)
+        std::memcpy(p, rows.data_handle(), static_cast<std::size_t>(k) * row_size() * sizeof(T));
+    } else {
+      // In storage order of the new rows, constructed one by one so that
+      // an exception leaves the array as it was.
+      std::size_t done = 0;
+      try {
+        construct_rows(rows, p, done);
+      } catch (...) {
+        std::destroy_n(p, done);
+        throw;
+      }
+    }
+    map_ = mapping_type(with_rows(n + k));
+  }
+
+private:
+  mapping_type map_;
+  growable_options opt_;
+  T *data_ = nullptr;
+  index_type capacity_ = 0;
+  // Size of the allocation (of the mapping with mremap).
+  std::size_t bytes_ = 0;
+
+  Extents with_rows(index_type n) const {
+    std::array<index_type, Extents::rank()> e;
+    e[0] = n;
+    for (rank_type r = 1; r < rank(); ++r)
+      e[r] = extent(r);
+    return Extents(e);
+  }
+
+  template <class M, class... I>
+  void construct_rows(const M &rows, T *p, std::size_t &done, I... i) const {
+    if constexpr (sizeof...(I) == M::rank()) {
+      ::new (static_cast<void *>(p + done)) T(rows[i...]);
+      ++done;
+    } else {
+      for (typename M::index_type j = 0; j < rows.extent(sizeof...(I)); ++j)
+        construct_rows(rows, p, done, i..., j);
+    }
+  }
+
+  void truncate(index_type n) noexcept {
+    if (n < rows()) {
+      std::destroy(data_ + static_cast<std::size_t>(n) * row_size(), data_ + size());
+      map_ = mapping_type(with_rows(n));
+    }
+  }
+
+  // Capacity for n rows, geometric growth.
+  void grow(index_type n) {
+    if (n <= capacity_)
+      return;
+    const double geometric = std::ceil(opt_.growth * static_cast<double>(capacity_));
+    reallocate(std::max<index_type>(n, static_cast<index_type>(geometric)));
+  }
+
+  void reallocate(index_type n) {
+    const std::size_t bytes = static_cast<std::size_t>(n) * row_size() * sizeof(T);
+#if defined(__linux__)
+    if (opt_.mremap) {
+      const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+      const std::size_t mapped = (bytes + page - 1) / page * page;
+      void *p = nullptr;
+      if (mapped == 0) {
+        deallocate(data_, bytes_);
+      } else if (!data_) {
+        p = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+          impl::growable_throw_errno("growable_mdarray: mmap");
+      } else {
+        p = ::mremap(data_, bytes_, mapped, MREMAP_MAYMOVE);
+        if (p == MAP_FAILED)
+          impl::growable_throw_errno("growable_mdarray: mremap");
+      }
+      data_ = static_cast<T *>(p);
+      bytes_ = mapped;
+      capacity_ = row_size() * sizeof(T) == 0
+                      ? n
+                      : static_cast<index_type>(mapped / (row_size() * sizeof(T)));
+      return;
+    }
+#endif
+    T *p = bytes == 0 ? nullptr
+                      : static_cast<T *>(::operator new(bytes, std::align_val_t(alignment)));
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if (size() > 0)
+        std::memcpy(p, data_, size() * sizeof(T));
+    } else {
+      try {
+        std::uninitialized_move_n(data_, size(), p);
+      } catch (...) {
+        deallocate(p, bytes);
+        throw;
+      }
+      std::destroy_n(data_, size());
+    }
+    deallocate(data_, bytes_);
+    data_ = p;
+    bytes_ = bytes;
+    capacity_ = n;
+  }
+
+  void deallocate(T *p, std::size_t bytes) const noexcept {
+    if (!p)
+      return;
+#if defined(__linux__)
+    if (opt_.mremap) {
+      ::munmap(p, bytes);
+      return;
+    }
+#endif
+    ::operator delete(p, bytes, std::align_val_t(alignment));
+  }
+};
@@ -0,0 +1,122 @@
+#include "halo_grid.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+int wrap(int i, int n) { return (i % n + n) % n; }
+
+void test_2d(bool periodic) {
+  const int m = 10, n = 13;
+  std::vector<int> g(m * n), back(m * n);
+  auto G = std::mdspan(g.data(), std::dextents<int, 2>{m, n});
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      G[i, j] = i * 100 + j;
+
+  halo_grid<int, 2> grid(std::execution::par, {m, n}, {3, 2}, {1, 2}, periodic, true);
+  assert(grid.num_blocks() == 6);
+  grid.scatter(std::execution::par, G);
+  grid.refresh_halos(std::execution::par);
+
+  for (std::size_t b = 0; b < grid.num_blocks(); ++b) {
+    const auto B = grid.block(b);
+    const auto o = grid.origin(b);
+    const auto h = grid.halo_width();
+    for (int i = 0; i < B.extent(0); ++i) {
+      for (int j = 0; j < B.extent(1); ++j) {
+        const int gi = o[0] + i - h[0], gj = o[1] + j - h[1];
+        if (periodic)
+          assert((B[i, j] == G[wrap(gi, m), wrap(gj, n)]));
+        else if (gi >= 0 && gi < m && gj >= 0 && gj < n)
+          assert((B[i, j] == G[gi, gj]));
+        else
+          assert((B[i, j] == 0));
+      }
+    }
+    auto I = grid.interior(b);
+    assert((I[0, 0] == G[o[0], o[1]]));
+    auto L = grid.halo(b, 1, 0);
+    assert(L.extent(0) == B.extent(0) && L.extent(1) == 2);
+  }
+
+  grid.gather(std::execution::par, std::mdspan(back.data(), std::dextents<int, 2>{m, n}));
+  assert(back == g);
+}
+
+void test_3d() {
+  const int n0 = 6, n1 = 7, n2 = 9;
+  std::vector<double> g(n0 * n1 * n2);
+  auto G = std::mdspan(g.data(), std::dextents<int, 3>{n0, n1, n2});
+  for (int i = 0; i < n0; ++i)
+    for (int j = 0; j < n1; ++j)
+      for (int k = 0; k < n2; ++k)
+        G[i, j, k] = i * 10000 + j * 100 + k;
+
+  halo_grid<double, 3> grid({n0, n1, n2}, {2, 2, 3}, {1, 1, 1}, true);
+  grid.scatter(std::execution::seq, G);
+  grid.refresh_halos();
+
+  for (std::size_t b = 0; b < grid.num_blocks(); ++b) {
+    const auto B = grid.block(b);
+    const auto o = grid.origin(b);
+    for (int i = 0; i < B.extent(0); ++i)
+      for (int j = 0; j < B.extent(1); ++j)
+        for (int k = 0; k < B.extent(2); ++k)
+          assert((B[i, j, k] ==
+                  G[wrap(o[0] + i - 1, n0), wrap(o[1] + j - 1, n1), wrap(o[2] + k - 1, n2)]));
+  }
+}
+
+// Time of a halo refresh against one Jacobi sweep over all the interiors.
+void bench(int n, int t, int halo, int reps) {
+  // Roughly square grid of t blocks.
+  int p0 = 1;
+  while (p0 * p0 < t)
+    ++p0;
+  while (t % p0 != 0)
+    --p0;
+
+  halo_grid<double, 2> grid(std::execution::par, {n, n}, {p0, t / p0}, {halo, halo}, false, true);
+  std::vector<std::size_t> ids(grid.num_blocks());
+  std::iota(ids.begin(), ids.end(), std::size_t{0});
+
+  double t_refresh = 1e30, t_sweep = 1e30;
+  for (int r = 0; r < reps; ++r) {
+    Timer tr;
+    grid.refresh_halos(std::execution::par);
+    t_refresh = std::min(t_refresh, tr.elapsed());
+
+    Timer ts;
+    std::for_each(std::execution::par, ids.begin(), ids.end(), [&](std::size_t b) {
+      auto B = grid.block(b);
+      for (int i = halo; i < B.extent(0) - halo; ++i)
+        for (int j = halo; j < B.extent(1) - halo; ++j)
+          B[i, j] = 0.25 * (B[i - 1, j] + B[i + 1, j] + B[i, j - 1] + B[i, j + 1]);
+    });
+    t_sweep = std::min(t_sweep, ts.elapsed());
+  }
+
+  std::cout << n << ", " << p0 << "x" << t / p0 << ", " << halo << ", " << t_refresh << ", "
+            << t_sweep << std::endl;
+}
+
+// Usage: halo_grid_example [<n> [<reps> [<blocks>]]]
+// By default one block per hardware thread, at least 4.
+int main(int argc, char **argv) {
+  test_2d(false);
+  test_2d(true);
+  test_3d();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+  const int blocks = argc > 3 ? std::atoi(argv[3])
+                              : std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+
+  std::cout << "n, blocks, halo, refresh [s], sweep [s]" << std::endl;
+  for (int halo : {1, 2, 4})
+    bench(n, blocks, halo, reps);
+}
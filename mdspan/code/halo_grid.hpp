@@ -0,0 +1,258 @@
+#pragma once
+
+#include "permute_copy.hpp"
+
+#include <experimental/mdspan>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Decomposition of a rank-2 or rank-3 domain into a grid of blocks, each
+// with its own storage surrounded by a halo, as used by stencil codes where
+// every thread owns a block.
+//
+// The domain of extents n is split into p[d] blocks along dimension d, block
+// sizes differing by at most one. A block with interior extents e is stored
+// as a layout_right array of extents e[d] + 2 * halo[d]:
+//
+//   block(b)       the whole local array, interior at [halo, halo + e),
+//   interior(b)    the interior, a submdspan of block(b),
+//   halo(b, d, s)  the halo slab on side s (0 low, 1 high) of dimension d,
+//                  over the whole local extent of the other dimensions.
+//
+// refresh_halos(policy) copies into every halo the boundary of the interior
+// of the neighbouring block. The dimensions are exchanged one after another,
+// the slabs of dimension d spanning the halos of the dimensions already
+// exchanged, which fills the edges and corners too. Halos on the boundary of
+// the domain are left alone unless the grid is periodic.
+//
+// With first_touch, the storage of each block is allocated uninitialized and
+// zeroed by a task of the execution policy given to the constructor, so that
+// its pages are placed on the NUMA node of the thread that runs that task.
+// The placement only pays off if later work on block b runs on a thread of
+// the same node, e.g. with a pinned thread pool.
+
+namespace impl {
+
+// submdspan of m over [lo[d], hi[d]) along every dimension d.
+template <class M, std::size_t R, std::size_t... I>
+auto box(M m, const std::array<int, R> &lo, const std::array<int, R> &hi,
+         std::index_sequence<I...>) {
+  return std::submdspan(m, std::pair{lo[I], hi[I]}...);
+}
+
+template <class M, std::size_t R>
+auto box(M m, const std::array<int, R> &lo, const std::array<int, R> &hi) {
+  return box(m, lo, hi, std::make_index_sequence<R>{});
+}
+
+template <class Src, class Dst> void copy_box(Src src, Dst dst) {
+  std::array<std::size_t, Src::rank()> axes;
+  std::iota(axes.begin(), axes.end(), std::size_t{0});
+  permute_copy(src, dst, axes);
+}
+
+} // namespace impl
+
+template <class T, std::size_t R> class halo_grid {
+  static_assert(R == 2 || R == 3, "halo_grid supports rank 2 and 3");
+
+public:
+  using index_array = std::array<int, R>;
+  using extents_type = std::dextents<int, R>;
+  using block_type = std::mdspan<T, extents_type>;
+
+  template <class ExecutionPolicy>
+    requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+  halo_grid(ExecutionPolicy &&policy, const index_array &extents, const index_array &blocks,
+            const index_array &halo, bool periodic = false, bool first_touch = false)
+      : n_(extents), p_(blocks), halo_(halo), periodic_(periodic) {
+    std::size_t nb = 1;
+    for (std::size_t d = 0; d < R; ++d) {
+      if (p_[d] < 1 || p_[d] > n_[d] || halo_[d] < 0 || halo_[d] > n_[d] / p_[d])
+        std::terminate();
+      nb *= p_[d];
+    }
+
+    storage_.resize(nb);
+    views_.resize(nb);
+    std::vector<std::size_t> ids(nb);
+    std::iota(ids.begin(), ids.end(), std::size_t{0});
+
+    for (std::size_t b : ids) {
+      const index_array c = coords(b);
+      index_array ext;
+      std::size_t size = 1;
+      for (std::size_t d = 0; d < R; ++d) {
+        ext[d] = start(d, c[d] + 1) - start(d, c[d]) + 2 * halo_[d];
+        size *= ext[d];
+      }
+      storage_[b] = std::make_unique_for_overwrite<T[]>(size);
+      views_[b] = block_type(storage_[b].get(), extents_type(ext));
+    }
+
+    auto zero = [&](std::size_t b) {
+      T *p = storage_[b].get();
+      std::fill(p, p + views_[b].size(), T{});
+    };
+    if (first_touch)
+      std::for_each(std::forward<ExecutionPolicy>(policy), ids.begin(), ids.end(), zero);
+    else
+      std::for_each(ids.begin(), ids.end(), zero);
+  }
+
+  halo_grid(const index_array &extents, const index_array &blocks, const index_array &halo,
+            bool periodic = false)
+      : halo_grid(std::execution::seq, extents, blocks, halo, periodic) {}
+
+  std::size_t num_blocks() const { return views_.size(); }
+  const index_array &extents() const { return n_; }
+  const index_array &grid() const { return p_; }
+  const index_array &halo_width() const { return halo_; }
+
+  // Grid coordinates of block b, the last one fastest.
+  index_array coords(std::size_t b) const {
+    index_array c;
+    for (std::size_t d = R; d-- > 0;) {
+      c[d] = static_cast<int>(b % p_[d]);
+      b /= p_[d];
+    }
+    return c;
+  }
+
+  // Global index of the first interior element of block b.
+  index_array origin(std::size_t b) const {
+    const index_array c = coords(b);
+    index_array o;
+    for (std::size_t d = 0; d < R; ++d)
+      o[d] = start(d, c[d]);
+    return o;
+  }
+
+  block_type block(std::size_t b) const { return views_[b]; }
+
+  auto interior(std::size_t b) const {
+    index_array lo = halo_, hi;
+    for (std::size_t d = 0; d < R; ++d)
+      hi[d] = views_[b].extent(d) - halo_[d];
+    return impl::box(views_[b], lo, hi);
+  }
+
+  auto halo(std::size_t b, std::size_t d, int side) const {
+    index_array lo{}, hi;
+    for (std::size_t k = 0; k < R; ++k)
+      hi[k] = views_[b].extent(k);
+    if (side == 0) {
+      hi[d] = halo_[d];
+    } else {
+      lo[d] = views_[b].extent(d) - halo_[d];
+    }
+    return impl::box(views_[b], lo, hi);
+  }
+
+  template <class ExecutionPolicy>
+    requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+  void refresh_halos(ExecutionPolicy &&policy) {
+    std::vector<std::size_t> ids(num_blocks());
+    std::iota(ids.begin(), ids.end(), std::size_t{0});
+
+    for (std::size_t d = 0; d < R; ++d) {
+      if (halo_[d] == 0)
+        continue;
+      std::for_each(policy, ids.begin(), ids.end(), [&](std::size_t b) {
+        for (int side = 0; side < 2; ++side)
+          refresh_halo(b, d, side);
+      });
+    }
+  }
+
+  void refresh_halos() { refresh_halos(std::execution::seq); }
+
+  // Copies the interiors from (scatter) or to (gather) a global mdspan of
+  // extents extents().
+  template <class ExecutionPolicy, class M>
+  void scatter(ExecutionPolicy &&policy, M global) {
+    for_each_block(policy, [&](std::size_t b) {
+      impl::copy_box(impl::box(global, origin(b), end(b)), interior(b));
+    });
+  }
+
+  template <class ExecutionPolicy, class M>
+  void gather(ExecutionPolicy &&policy, M global) const {
+    for_each_block(policy, [&](std::size_t b) {
+      impl::copy_box(interior(b), impl::box(global, origin(b), end(b)));
+    });
+  }
+
+private:
+  index_array n_;
+  index_array p_;
+  index_array halo_;
+  bool periodic_;
+  std::vector<std::unique_ptr<T[]>> storage_;
+  std::vector<block_type> views_;
+
+  // First global index of the blocks at grid coordinate c along d.
+  int start(std::size_t d, int c) const {
+    return static_cast<int>(static_cast<long long>(n_[d]) * c / p_[d]);
+  }
+
+  index_array end(std::size_t b) const {
+    const index_array c = coords(b);
+    index_array e;
+    for (std::size_t d = 0; d < R; ++d)
+      e[d] = start(d, c[d] + 1);
+    return e;
+  }
+
+  template <class ExecutionPolicy, class F>
+  void for_each_block(ExecutionPolicy &&policy, F f) const {
+    std::vector<std::size_t> ids(num_blocks());
+    std::iota(ids.begin(), ids.end(), std::size_t{0});
+    std::for_each(std::forward<ExecutionPolicy>(policy), ids.begin(), ids.end(), f);
+  }
+
+  void refresh_halo(std::size_t b, std::size_t d, int side) {
+    index_array c = coords(b);
+    const int nc = c[d] + (side == 0 ? -1 : 1);
+    if (!periodic_ && (nc < 0 || nc >= p_[d]))
+      return;
+    c[d] = (nc + p_[d]) % p_[d];
+    std::size_t nb = 0;
+    for (std::size_t k = 0; k < R; ++k)
+      nb = nb * p_[k] + c[k];
+
+    // Dimensions exchanged before d include their halos, later ones don't.
+    const block_type &mine = views_[b];
+    const block_type &theirs = views_[nb];
+    index_array lo, hi, nlo, nhi;
+    for (std::size_t k = 0; k < R; ++k) {
+      lo[k] = k < d ? 0 : halo_[k];
+      hi[k] = mine.extent(k) - lo[k];
+      nlo[k] = lo[k];
+      nhi[k] = theirs.extent(k) - nlo[k];
+    }
+    const int w = halo_[d];
+    if (side == 0) {
+      // My low halo <- the high end of the interior of the lower neighbour.
+      lo[d] = 0;
+      hi[d] = w;
+      nlo[d] = theirs.extent(d) - 2 * w;
+      nhi[d] = theirs.extent(d) - w;
+    } else {
+      lo[d] = mine.extent(d) - w;
+      hi[d] = mine.extent(d);
+      nlo[d] = w;
+      nhi[d] = 2 * w;
+    }
+    impl::copy_box(impl::box(theirs, nlo, nhi), impl::box(mine, lo, hi));
+  }
+};
@@ -0,0 +1,162 @@
+#include "inline_mdarray.hpp"
+#include "timer.hpp"
+
+#include <experimental/mdarray>
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using ext33 = std::extents<int, 3, 3>;
+using mat3 = inline_mdarray<double, ext33>;
+
+// c = a * b, for any mdspans.
+template <class A, class B, class C> constexpr void matmul(A a, B b, C c) {
+  for (int i = 0; i < c.extent(0); ++i)
+    for (int j = 0; j < c.extent(1); ++j) {
+      typename C::value_type s = 0;
+      for (int l = 0; l < a.extent(1); ++l)
+        s += a[i, l] * b[l, j];
+      c[i, j] = s;
+    }
+}
+
+constexpr mat3 identity3() {
+  mat3 r;
+  for (int i = 0; i < 3; ++i)
+    r[i, i] = 1;
+  return r;
+}
+
+// A kernel taking a fixed mdspan type, like apply_int_matrix in mdspan.cpp.
+int apply_int_matrix(std::mdspan<int, std::dextents<int, 2>> s) { return s[1, 2]; }
+
+int sum_const(std::mdspan<const int, std::extents<int, 3, 4>> s) {
+  int r = 0;
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 4; ++j)
+      r += s[i, j];
+  return r;
+}
+
+void test_inline_mdarray() {
+  static_assert(std::is_trivially_copyable_v<mat3>);
+  static_assert(sizeof(mat3) == 9 * sizeof(double));
+  static_assert(sizeof(inline_mdarray<float, std::extents<int, 4, 4>, std::layout_left>) ==
+                16 * sizeof(float));
+
+  // In constant expressions.
+  constexpr mat3 I = identity3();
+  constexpr mat3 R = {0, -1, 0, 1, 0, 0, 0, 0, 1};
+  static_assert((I[1, 1] == 1 && I[0, 1] == 0 && R[0, 1] == -1 && R[1, 0] == 1));
+  constexpr mat3 R2 = [&] {
+    mat3 r;
+    matmul(R.to_mdspan(), R.to_mdspan(), r.to_mdspan());
+    return r;
+  }();
+  static_assert((R2[0, 0] == -1 && R2[1, 1] == -1 && R2[2, 2] == 1));
+  static_assert(R2 != I);
+
+  // Conversions to mdspans, as from my_mdarray.
+  inline_mdarray<int, std::extents<int, 3, 4>> a;
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 4; ++j)
+      a[i, j] = 4 * i + j;
+  assert(apply_int_matrix(a) == 6);
+  assert(sum_const(a) == 66);
+  const auto &ca = a;
+  assert(sum_const(ca) == 66);
+  static_assert(!std::is_convertible_v<const decltype(a) &, std::mdspan<int, std::dextents<int, 2>>>);
+
+  // Copies are by value.
+  auto b = a;
+  b[0, 0] = 100;
+  assert((a[0, 0] == 0 && b != a));
+
+  // Layouts, and copies from mdspans.
+  inline_mdarray<int, std::extents<int, 3, 4>, std::layout_left> l(a.to_mdspan());
+  assert((l[1, 2] == 6 && l.data()[1 + 3 * 2] == 6));
+  std::vector<int> v(12);
+  std::memcpy(v.data(), a.data(), sizeof(int) * 12);
+  inline_mdarray c(std::mdspan(v.data(), std::extents<int, 3, 4>{}));
+  assert(c == a);
+  using padded = std::experimental::layout_right_padded<4>;
+  inline_mdarray<double, ext33, padded> p;
+  static_assert(sizeof(p) == (2 * 4 + 3) * sizeof(double));
+  matmul(I.to_mdspan(), R.to_mdspan(), p.to_mdspan());
+  assert(mat3(p.to_mdspan()) == R);
+}
+
+// Per particle: a rotation about z of angle theta (given by its cosine and
+// sine), M = R S R^t and v = M x. Returns sum |v|^2.
+template <class Make>
+double particles(const std::vector<double> &cos_theta, const std::vector<double> &sin_theta,
+                 const std::vector<double> &x, Make &&make) {
+  double s = 0;
+  for (std::size_t p = 0; p < cos_theta.size(); ++p) {
+    auto R = make();
+    auto Rt = make();
+    auto S = make();
+    auto T = make();
+    auto M = make();
+    const double c = cos_theta[p], sn = sin_theta[p];
+    R[0, 0] = c, R[0, 1] = -sn, R[1, 0] = sn, R[1, 1] = c, R[2, 2] = 1;
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 3; ++j)
+        Rt[i, j] = R[j, i];
+    S[0, 0] = 1, S[1, 1] = 2, S[2, 2] = 3, S[0, 1] = S[1, 0] = 0.5;
+    matmul(R.to_mdspan(), S.to_mdspan(), T.to_mdspan());
+    matmul(T.to_mdspan(), Rt.to_mdspan(), M.to_mdspan());
+    for (int i = 0; i < 3; ++i) {
+      double vi = 0;
+      for (int j = 0; j < 3; ++j)
+        vi += M[i, j] * x[3 * p + j];
+      s += vi * vi;
+    }
+  }
+  return s;
+}
+
+void bench(int n, int reps) {
+  std::vector<double> cos_theta(n), sin_theta(n), x(3 * std::size_t(n));
+  for (int p = 0; p < n; ++p) {
+    cos_theta[p] = std::cos(0.001 * p);
+    sin_theta[p] = std::sin(0.001 * p);
+    x[3 * p] = 1, x[3 * p + 1] = p % 7, x[3 * p + 2] = -1;
+  }
+
+  double s_inline = 0, s_heap = 0, s_dyn = 0;
+  double t_inline = 1e30, t_heap = 1e30, t_dyn = 1e30;
+  for (int r = 0; r < reps; ++r) {
+    Timer t1;
+    s_inline = particles(cos_theta, sin_theta, x, [] { return mat3(); });
+    t_inline = std::min(t_inline, t1.elapsed());
+    Timer t2;
+    s_heap = particles(cos_theta, sin_theta, x, [] { return std::experimental::mdarray<double, ext33>(3, 3); });
+    t_heap = std::min(t_heap, t2.elapsed());
+    Timer t3;
+    s_dyn = particles(cos_theta, sin_theta, x, [] {
+      return std::experimental::mdarray<double, std::dextents<int, 2>>(3, 3);
+    });
+    t_dyn = std::min(t_dyn, t3.elapsed());
+  }
+  assert(std::abs(s_inline - s_heap) <= 1e-9 * s_heap && std::abs(s_inline - s_dyn) <= 1e-9 * s_dyn);
+
+  std::cout << n << ", " << t_inline / n * 1e9 << ", " << t_heap / n * 1e9 << ", "
+            << t_dyn / n * 1e9 << ", " << t_heap / t_inline << std::endl;
+}
+
+// Usage: inline_mdarray_example [<particles> [<reps>]]
+int main(int argc, char **argv) {
+  test_inline_mdarray();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 1 << 20;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  std::cout << "particles, inline [ns/particle], mdarray static extents, mdarray dextents, speedup"
+            << std::endl;
+  bench(n, reps);
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <experimental/mdspan>
+
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+
+// inline_mdarray<T, Extents, Layout>: an owning multidimensional array with
+// static extents whose elements live in a std::array inside the object, for
+// the small arrays created in inner loops (3x3 rotations, 4x4 transforms,
+// per particle tensors). std::experimental::mdarray and my_mdarray in
+// mdspan.cpp keep their elements in a std::vector, i.e. one heap allocation
+// per array.
+//
+// The mapping is not stored, it is rebuilt from the static extents on each
+// access, so that sizeof(inline_mdarray) is the size of the elements and the
+// array is
+//  - trivially copyable (if T is): copies and returns by value are memcpy,
+//  - usable in constant expressions,
+//  - on the stack, or in registers once the compiler has unrolled the loops
+//    over its static extents.
+//
+// It converts implicitly to the mdspans its view converts to, like
+// my_mdarray does, so that kernels taking mdspans accept it as is:
+//
+//   int apply_int_matrix(std::mdspan<int, std::dextents<int, 2>> s);
+//   inline_mdarray<int, std::extents<int, 3, 4>> a;
+//   apply_int_matrix(a);
+//
+// and to_mdspan() returns the view for kernels templated on the mdspan type.
+// A view of an inline_mdarray is invalidated when the array goes out of
+// scope, or is moved from (which copies): a view does not follow the array.
+//
+// The elements are zero by default, or are given in storage order, or are
+// copied from an mdspan with the same extents:
+//
+//   constexpr inline_mdarray<double, std::extents<int, 2, 2>> r = {0, -1, 1, 0};
+
+namespace impl {
+
+// Calls f(i...) for every multi-index of the static extents E, in
+// lexicographic order.
+template <class E, class F, class... I>
+constexpr void inline_for_each_index(F &f, I... i) {
+  if constexpr (sizeof...(I) == E::rank()) {
+    f(i...);
+  } else {
+    constexpr auto n = static_cast<typename E::index_type>(E::static_extent(sizeof...(I)));
+    for (typename E::index_type k = 0; k < n; ++k)
+      inline_for_each_index<E>(f, i..., k);
+  }
+}
+
+} // namespace impl
+
+template <class T, class Extents, class Layout = std::layout_right>
+  requires(Extents::rank_dynamic() == 0)
+class inline_mdarray {
+public:
+  using extents_type = Extents;
+  using layout_type = Layout;
+  using mapping_type = typename Layout::template mapping<Extents>;
+  using element_type = T;
+  using value_type = T;
+  using index_type = typename Extents::index_type;
+  using size_type = typename Extents::size_type;
+  using rank_type = typename Extents::rank_type;
+  using container_type = std::array<T, mapping_type(Extents{}).required_span_size()>;
+  using mdspan_type = std::mdspan<T, Extents, Layout>;
+  using const_mdspan_type = std::mdspan<const T, Extents, Layout>;
+
+  static constexpr rank_type rank() noexcept { return Extents::rank(); }
+  static constexpr rank_type rank_dynamic() noexcept { return 0; }
+  static constexpr std::size_t static_extent(rank_type r) noexcept {
+    return Extents::static_extent(r);
+  }
+  static constexpr index_type extent(rank_type r) noexcept {
+    return static_cast<index_type>(Extents::static_extent(r));
+  }
+  static constexpr extents_type extents() noexcept { return {}; }
+  static constexpr mapping_type mapping() noexcept { return mapping_type(Extents{}); }
+  static constexpr size_type size() noexcept {
+    size_type n = 1;
+    for (rank_type r = 0; r < rank(); ++r)
+      n *= static_cast<size_type>(Extents::static_extent(r));
+    return n;
+  }
+  static constexpr std::size_t container_size() noexcept {
+    return std::tuple_size_v<container_type>;
+  }
+
+  constexpr inline_mdarray() = default;
+
+  // The elements, in storage order.
+  template <class... V>
+    requires(sizeof...(V) == std::tuple_size_v<container_type> &&
+             (std::is_convertible_v<V, T> && ...))
+  constexpr inline_mdarray(V... v) : c_{static_cast<T>(v)...} {}
+
+  constexpr explicit inline_mdarray(const container_type &c) : c_(c) {}
+
+  // Copies the elements of m, whose extents must be those of the array.
+  template <class OT, class OE, class OL, class OA>
+    requires(OE::rank() == Extents::rank() &&
+             std::is_constructible_v<T, typename OA::reference>)
+  constexpr explicit inline_mdarray(const std::mdspan<OT, OE, OL, OA> &m) {
+    for (rank_type r = 0; r < rank(); ++r)
+      if (static_cast<std::size_t>(m.extent(r)) != Extents::static_extent(r))
+        std::terminate();
+    auto copy = [&](auto... i) { (*this)[i...] = T(m[i...]); };
+    impl::inline_for_each_index<Extents>(copy);
+  }
+
+  template <class... I>
+    requires(sizeof...(I) == Extents::rank() && (std::is_convertible_v<I, index_type> && ...))
+  constexpr T &operator[](I... i) {
+    return c_[mapping()(static_cast<index_type>(i)...)];
+  }
+
+  template <class... I>
+    requires(sizeof...(I) == Extents::rank() && (std::is_convertible_v<I, index_type> && ...))
+  constexpr const T &operator[](I... i) const {
+    return c_[mapping()(static_cast<index_type>(i)...)];
+  }
+
+  constexpr T *data() noexcept { return c_.data(); }
+  constexpr const T *data() const noexcept { return c_.data(); }
+  constexpr container_type &container() noexcept { return c_; }
+  constexpr const container_type &container() const noexcept { return c_; }
+
+  constexpr mdspan_type to_mdspan() noexcept { return mdspan_type(c_.data(), mapping()); }
+  constexpr const_mdspan_type to_mdspan() const noexcept {
+    return const_mdspan_type(c_.data(), mapping());
+  }
+
+  template <class OT, class OE, class OL, class OA>
+    requires std::is_convertible_v<const mdspan_type &, std::mdspan<OT, OE, OL, OA>>
+  constexpr operator std::mdspan<OT, OE, OL, OA>() noexcept {
+    return to_mdspan();
+  }
+
+  template <class OT, class OE, class OL, class OA>
+    requires std::is_convertible_v<const const_mdspan_type &, std::mdspan<OT, OE, OL, OA>>
+  constexpr operator std::mdspan<OT, OE, OL, OA>() const noexcept {
+    return to_mdspan();
+  }
+
+  friend constexpr bool operator==(const inline_mdarray &, const inline_mdarray &) = default;
+
+private:
+  container_type c_{};
+};
+
+template <class T, class E, class L, class A>
+  requires(E::rank_dynamic() == 0 && std::is_constructible_v<typename L::template mapping<E>, E>)
+inline_mdarray(const std::mdspan<T, E, L, A> &)
+    -> inline_mdarray<std::remove_cv_t<T>, E, L>;
@@ -0,0 +1,148 @@
+#include "mdfile.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+
+void test_mdfile() {
+  const temp_file path("mdfile_example");
+
+  // mdarray, layout_right.
+  std::experimental::mdarray<double, std::dextents<int, 2>> a(5, 7);
+  for (int i = 0; i < 5; ++i)
+    for (int j = 0; j < 7; ++j)
+      a[i, j] = i * 10 + j;
+  write_mdfile(path, a);
+  {
+    mapped_mdfile f(path, mdfile_advice::sequential);
+    auto A = load_mdspan<double, std::dextents<int, 2>>(f);
+    assert(A.extent(0) == 5 && A.extent(1) == 7);
+    assert((A[4, 6] == 46.));
+
+    auto S = load_mdspan<double, std::extents<int, 5, std::dynamic_extent>, std::layout_stride>(f);
+    assert(S.stride(0) == 7 && S.stride(1) == 1);
+    assert((S[3, 2] == 32.));
+
+    bool thrown = false;
+    try {
+      load_mdspan<float, std::dextents<int, 2>>(f);
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    assert(thrown);
+
+    thrown = false;
+    try {
+      load_mdspan<double, std::dextents<int, 2>, std::layout_left>(f);
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  // layout_left is kept as it is.
+  std::vector<float> v(4 * 3 * 2);
+  std::iota(v.begin(), v.end(), 0.f);
+  auto L = std::mdspan<float, std::dextents<int, 3>, std::layout_left>(v.data(), 4, 3, 2);
+  write_mdfile(path, L);
+  {
+    mapped_mdfile f(path);
+    assert(f.header().layout == mdfile_layout::left);
+    auto B = load_mdspan<float, std::dextents<int, 3>, std::layout_left>(f);
+    assert((B[3, 2, 1] == L[3, 2, 1]));
+  }
+
+  // A payload size that would wrap around past the end of the file.
+  {
+    std::fstream io(path.path(), std::ios::binary | std::ios::in | std::ios::out);
+    const std::uint64_t huge = ~std::uint64_t(0);
+    io.seekp(offsetof(mdfile_header, payload_size));
+    io.write(reinterpret_cast<const char *>(&huge), sizeof(huge));
+  }
+  bool thrown = false;
+  try {
+    mapped_mdfile f(path);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // A submdspan with gaps is packed in layout_right order.
+  auto full = std::mdspan(v.data(), std::dextents<int, 2>{4, 6});
+  auto sub = std::submdspan(full, std::pair{1, 3}, std::strided_slice{.offset = 0, .extent = 6, .stride = 2});
+  write_mdfile(path, sub);
+  {
+    mapped_mdfile f(path, mdfile_advice::random);
+    assert(f.header().layout == mdfile_layout::right);
+    auto C = load_mdspan<float, std::dextents<int, 2>>(f);
+    for (int i = 0; i < 2; ++i)
+      for (int j = 0; j < 3; ++j)
+        assert((C[i, j] == sub[i, j]));
+  }
+}
+
+// Startup cost of reading a file into a vector vs mapping it, and the cost
+// of a first and second pass over the elements.
+void bench(std::size_t n, int reps) {
+  const temp_file path("mdfile_bench");
+  {
+    std::vector<double> v(n * n);
+    std::iota(v.begin(), v.end(), 0.);
+    write_mdfile(path, std::mdspan(v.data(), std::dextents<std::size_t, 2>{n, n}));
+  }
+  const double bytes = double(n) * n * sizeof(double);
+
+  auto sum = [](auto A) {
+    double s = 0;
+    for (std::size_t i = 0; i < A.extent(0); ++i)
+      for (std::size_t j = 0; j < A.extent(1); ++j)
+        s += A[i, j];
+    return s;
+  };
+
+  double t_read = 1e30, t_map = 1e30, t_first = 1e30, t_second = 1e30;
+  double s_read = 0, s_first = 0, s_second = 0;
+  for (int r = 0; r < reps; ++r) {
+    {
+      Timer t;
+      std::ifstream in(path, std::ios::binary);
+      in.seekg(mdfile_header::payload_offset);
+      std::vector<double> v(n * n);
+      in.read(reinterpret_cast<char *>(v.data()), bytes);
+      auto A = std::mdspan(v.data(), std::dextents<std::size_t, 2>{n, n});
+      t_read = std::min(t_read, t.elapsed());
+      s_read = sum(A);
+    }
+    {
+      Timer t;
+      mapped_mdfile f(path, mdfile_advice::sequential);
+      auto A = load_mdspan<double, std::dextents<std::size_t, 2>>(f);
+      t_map = std::min(t_map, t.elapsed());
+      Timer t1;
+      s_first = sum(A);
+      t_first = std::min(t_first, t1.elapsed());
+      Timer t2;
+      s_second = sum(A);
+      t_second = std::min(t_second, t2.elapsed());
+    }
+  }
+  assert(s_read == s_first && s_read == s_second);
+
+  std::cout << n << ", " << bytes / 1e6 << ", " << t_read << ", " << t_map << ", "
+            << t_first << ", " << t_second << std::endl;
+}
+
+// Usage: mdfile_example [<n> [<reps>]]
+// Benchmarks an n x n matrix of doubles.
+int main(int argc, char **argv) {
+  test_mdfile();
+
+  const std::size_t n = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  std::cout << "n, MB, read into vector [s], mmap [s], first pass [s], second pass [s]" << std::endl;
+  bench(n, reps);
+}
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <experimental/mdarray>
+#include <experimental/mdspan>
+
+#include <array>
+#include <cerrno>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Self-describing binary format for mdspans, loaded with mmap.
+//
+// A file is a header page followed by the payload:
+//
+//   [0, 4096)             mdfile_header
+//   [4096, 4096 + bytes)  elements, in the order given by the layout
+//
+// The header records the element type, the extents, the layout (right, left
+// or strided) and, for strided payloads, the strides. The payload starts on a
+// page boundary, so the mapped elements are suitably aligned for any type.
+//
+// load_mdspan maps the file read-only and shared: the elements are not
+// copied, pages are read on first access and the page cache is shared with
+// every other process mapping the same file.
+
+enum class mdfile_type : std::uint32_t {
+  int8 = 1, int16, int32, int64,
+  uint8, uint16, uint32, uint64,
+  float32, float64, complex64, complex128
+};
+
+enum class mdfile_layout : std::uint32_t { right = 0, left = 1, stride = 2 };
+
+// Access pattern hint for the payload, see madvise(2).
+enum class mdfile_advice { normal, sequential, random, willneed };
+
+template <class T> constexpr mdfile_type mdfile_type_of() {
+  using U = std::remove_cv_t<T>;
+  if constexpr (std::is_same_v<U, std::int8_t>) return mdfile_type::int8;
+  else if constexpr (std::is_same_v<U, std::int16_t>) return mdfile_type::int16;
+  else if constexpr (std::is_same_v<U, std::int32_t>) return mdfile_type::int32;
+  else if constexpr (std::is_same_v<U, std::int64_t>) return mdfile_type::int64;
+  else if constexpr (std::is_same_v<U, std::uint8_t>) return mdfile_type::uint8;
+  else if constexpr (std::is_same_v<U, std::uint16_t>) return mdfile_type::uint16;
+  else if constexpr (std::is_same_v<U, std::uint32_t>) return mdfile_type::uint32;
+  else if constexpr (std::is_same_v<U, std::uint64_t>) return mdfile_type::uint64;
+  else if constexpr (std::is_same_v<U, float>) return mdfile_type::float32;
+  else if constexpr (std::is_same_v<U, double>) return mdfile_type::float64;
+  else if constexpr (std::is_same_v<U, std::complex<float>>) return mdfile_type::complex64;
+  else if constexpr (std::is_same_v<U, std::complex<double>>) return mdfile_type::complex128;
+  else static_assert(sizeof(T) == 0, "unsupported element type");
+}
+
+struct mdfile_header {
+  static constexpr std::size_t max_rank = 8;
+  static constexpr std::uint64_t payload_offset = 4096;
+
+  char magic[8] = {'M', 'D', 'S', 'P', 'A', 'N', '\0', '\1'};
+  // Written as 0x01020304, a different value means another byte order.
+  std::uint32_t byte_order = 0x01020304;
+  mdfile_type type{};
+  std::uint32_t element_size = 0;
+  mdfile_layout layout{};
+  std::uint32_t rank = 0;
+  std::uint32_t reserved = 0;
+  // Bytes of the payload, i.e. required_span_size() * element_size.
+  std::uint64_t payload_size = 0;
+  std::uint64_t extents[max_rank] = {};
+  // Only meaningful for mdfile_layout::stride.
+  std::uint64_t strides[max_rank] = {};
+};
+
+static_assert(std::is_trivially_copyable_v<mdfile_header>);
+static_assert(sizeof(mdfile_header) <= mdfile_header::payload_offset);
+
+namespace impl {
+
+[[noreturn]] inline void throw_errno(const std::string &what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Calls f(i...) for all the indices of exts, last index fastest.
+template <class Extents, class F, class... I>
+void for_each_index(const Extents &exts, F &&f, I... i) {
+  if constexpr (sizeof...(I) == Extents::rank()) {
+    f(i...);
+  } else {
+    using index_type = typename Extents::index_type;
+    for (index_type k = 0; k < exts.extent(sizeof...(I)); ++k)
+      for_each_index(exts, f, i..., k);
+  }
+}
+
+} // namespace impl
+
+// A new empty file in the temporary directory, named stem.XXXXXX by
+// mkstemp(3), so that concurrent runs (e.g. tests in parallel) never share
+// it. The file is removed with the object.
+class temp_file {
+public:
+  explicit temp_file(const std::string &stem) {
+    std::string name = (std::filesystem::temp_directory_path() / (stem + ".XXXXXX")).string();
+    const int fd = ::mkstemp(name.data());
+    if (fd < 0)
+      impl::throw_errno("mkstemp " + name);
+    ::close(fd);
+    path_ = std::move(name);
+  }
+
+  temp_file(const temp_file &) = delete;
+  temp_file &operator=(const temp_file &) = delete;
+
+  ~temp_file() { ::unlink(path_.c_str()); }
+
+  const std::string &path() const noexcept { return path_; }
+  operator const std::string &() const noexcept { return path_; }
+
+private:
+  std::string path_;
+};
+
+// Read-only shared mapping of an mdfile. Views returned by load_mdspan are
+// valid as long as the mapped_mdfile is alive.
+class mapped_mdfile {
+  void *addr_ = nullptr;
+  std::size_t size_ = 0;
+
+public:
+  mapped_mdfile() = default;
+
+  explicit mapped_mdfile(const std::string &path,
+                         mdfile_advice advice = mdfile_advice::normal) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      impl::throw_errno("open " + path);
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      impl::throw_errno("fstat " + path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ < mdfile_header::payload_offset) {
+      ::close(fd);
+      throw std::runtime_error(path + ": not an mdfile");
+    }
+
+    addr_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+    if (addr_ == MAP_FAILED) {
+      addr_ = nullptr;
+      impl::throw_errno("mmap " + path);
+    }
+
+    const mdfile_header &h = header();
+    if (std::memcmp(h.magic, mdfile_header{}.magic, sizeof(h.magic)) != 0 ||
+        h.byte_order != mdfile_header{}.byte_order || h.rank > mdfile_header::max_rank ||
+        h.payload_size > size_ - mdfile_header::payload_offset) {
+      unmap();
+      throw std::runtime_error(path + ": not an mdfile or incompatible byte order");
+    }
+
+    advise(advice);
+  }
+
+  mapped_mdfile(const mapped_mdfile &) = delete;
+  mapped_mdfile &operator=(const mapped_mdfile &) = delete;
+
+  mapped_mdfile(mapped_mdfile &&other) noexcept
+      : addr_(std::exchange(other.addr_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+  mapped_mdfile &operator=(mapped_mdfile &&other) noexcept {
+    if (this != &other) {
+      unmap();
+      addr_ = std::exchange(other.addr_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+
+  ~mapped_mdfile() { unmap(); }
+
+  const mdfile_header &header() const {
+    return *static_cast<const mdfile_header *>(addr_);
+  }
+
+  const std::byte *payload() const {
+    return static_cast<const std::byte *>(addr_) + mdfile_header::payload_offset;
+  }
+
+  // Applies an access pattern hint. Hints are advisory, failures are
+  // ignored.
+  void advise(mdfile_advice advice) const {
+    int a = MADV_NORMAL;
+    switch (advice) {
+    case mdfile_advice::normal: a = MADV_NORMAL; break;
+    case mdfile_advice::sequential: a = MADV_SEQUENTIAL; break;
+    case mdfile_advice::random: a = MADV_RANDOM; break;
+    case mdfile_advice::willneed: a = MADV_WILLNEED; break;
+    }
+    // The whole mapping, madvise needs a page aligned address.
+    ::madvise(addr_, size_, a);
+  }
+
+private:
+  void unmap() {
+    if (addr_)
+      ::munmap(addr_, size_);
+    addr_ = nullptr;
+    size_ = 0;
+  }
+};
+
+// Typed view of the payload of a mapped file, without copying.
+//
+// Throws std::runtime_error if the element type, the rank, a static extent or
+// the layout doesn't match the file. A layout_stride view can be obtained
+// from files of any layout.
+template <class T, class Extents, class Layout = std::layout_right>
+std::mdspan<const T, Extents, Layout> load_mdspan(const mapped_mdfile &file) {
+  using index_type = typename Extents::index_type;
+  constexpr std::size_t rank = Extents::rank();
+  const mdfile_header &h = file.header();
+
+  if (h.type != mdfile_type_of<T>() || h.element_size != sizeof(T))
+    throw std::runtime_error("mdfile: element type mismatch");
+  if (h.rank != rank)
+    throw std::runtime_error("mdfile: rank mismatch");
+
+  std::array<index_type, rank> exts;
+  for (std::size_t r = 0; r < rank; ++r) {
+    exts[r] = static_cast<index_type>(h.extents[r]);
+    if (Extents::static_extent(r) != std::dynamic_extent &&
+        Extents::static_extent(r) != h.extents[r])
+      throw std::runtime_error("mdfile: static extent mismatch");
+  }
+  const Extents e(exts);
+  const T *data = reinterpret_cast<const T *>(file.payload());
+
+  std::mdspan<const T, Extents, Layout> view;
+  if constexpr (std::is_same_v<Layout, std::layout_stride>) {
+    std::array<index_type, rank> strides;
+    for (std::size_t r = 0; r < rank; ++r) {
+      if (h.layout == mdfile_layout::stride) {
+        strides[r] = static_cast<index_type>(h.strides[r]);
+      } else {
+        // Contiguous layouts: product of the faster extents.
+        index_type s = 1;
+        for (std::size_t q = 0; q < rank; ++q)
+          if (h.layout == mdfile_layout::right ? q > r : q < r)
+            s *= exts[q];
+        strides[r] = s;
+      }
+    }
+    view = {data, std::layout_stride::mapping<Extents>(e, strides)};
+  } else {
+    constexpr mdfile_layout expected =
+        std::is_same_v<Layout, std::layout_right> ? mdfile_layout::right : mdfile_layout::left;
+    static_assert(std::is_same_v<Layout, std::layout_right> ||
+                      std::is_same_v<Layout, std::layout_left>,
+                  "load_mdspan supports layout_right, layout_left and layout_stride");
+    if (h.layout != expected)
+      throw std::runtime_error("mdfile: layout mismatch");
+    view = {data, e};
+  }
+
+  if (static_cast<std::uint64_t>(view.mapping().required_span_size()) >
+      h.payload_size / sizeof(T))
+    throw std::runtime_error("mdfile: payload too small");
+  return view;
+}
+
+// Writes an mdspan. layout_right and layout_left payloads are written as
+// they are, exhaustive strided ones with their strides, anything else (e.g. a
+// submdspan with gaps, or a custom layout) is written in layout_right order.
+template <class T, class Extents, class Layout, class Accessor>
+void write_mdfile(const std::string &path, std::mdspan<T, Extents, Layout, Accessor> m) {
+  using value_type = std::remove_cv_t<T>;
+  constexpr std::size_t rank = Extents::rank();
+  static_assert(rank <= mdfile_header::max_rank);
+
+  mdfile_header h;
+  h.type = mdfile_type_of<value_type>();
+  h.element_size = sizeof(value_type);
+  h.rank = rank;
+  for (std::size_t r = 0; r < rank; ++r)
+    h.extents[r] = m.extent(r);
+
+  constexpr bool raw =
+      std::is_same_v<Accessor, std::default_accessor<T>> &&
+      (std::is_same_v<Layout, std::layout_right> || std::is_same_v<Layout, std::layout_left> ||
+       Layout::template mapping<Extents>::is_always_strided());
+  std::vector<value_type> packed;
+  const value_type *data = nullptr;
+  std::size_t count = 0;
+
+  if constexpr (raw) {
+    if (m.is_exhaustive()) {
+      if constexpr (std::is_same_v<Layout, std::layout_right>) {
+        h.layout = mdfile_layout::right;
+      } else if constexpr (std::is_same_v<Layout, std::layout_left>) {
+        h.layout = mdfile_layout::left;
+      } else {
+        h.layout = mdfile_layout::stride;
+        for (std::size_t r = 0; r < rank; ++r)
+          h.strides[r] = m.stride(r);
+      }
+      data = m.data_handle();
+      count = m.mapping().required_span_size();
+    }
+  }
+
+  if (!data) {
+    h.layout = mdfile_layout::right;
+    packed.reserve(m.size());
+    impl::for_each_index(m.extents(), [&](auto... i) { packed.push_back(m[i...]); });
+    data = packed.data();
+    count = packed.size();
+  }
+  h.payload_size = count * sizeof(value_type);
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  std::vector<char> page(mdfile_header::payload_offset, 0);
+  std::memcpy(page.data(), &h, sizeof(h));
+  out.write(page.data(), page.size());
+  out.write(reinterpret_cast<const char *>(data), h.payload_size);
+  if (!out)
+    throw std::runtime_error("mdfile: cannot write " + path);
+}
+
+template <class T, class Extents, class Layout, class Container>
+void write_mdfile(const std::string &path,
+                  const std::experimental::mdarray<T, Extents, Layout, Container> &a) {
+  write_mdfile(path, a.to_mdspan());
+}
+
+// Owning types exposing their elements through an mdspan() member, such as
+// my_mdarray in mdspan.cpp.
+template <class A>
+  requires requires(A &a) { a.mdspan(); }
+void write_mdfile(const std::string &path, A &a) {
+  write_mdfile(path, a.mdspan());
+}
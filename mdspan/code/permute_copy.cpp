@@ -0,0 +1,115 @@
+#include "permute_copy.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+template <class Src, class Dst>
+void naive_transpose(Src src, Dst dst) {
+  for (int i = 0; i < dst.extent(0); ++i) {
+    for (int j = 0; j < dst.extent(1); ++j) {
+      dst[i, j] = src[j, i];
+    }
+  }
+}
+
+template <class Src, class Dst>
+void naive_permute_201(Src src, Dst dst) {
+  for (int i = 0; i < dst.extent(0); ++i) {
+    for (int j = 0; j < dst.extent(1); ++j) {
+      for (int k = 0; k < dst.extent(2); ++k) {
+        dst[i, j, k] = src[j, k, i];
+      }
+    }
+  }
+}
+
+void test_permute_copy() {
+  // 2D, layout_right -> layout_right and layout_left, odd sizes.
+  std::vector<float> a(37 * 70);
+  std::iota(a.begin(), a.end(), 0.f);
+  auto A = std::mdspan(a.data(), std::dextents<int, 2>{37, 70});
+
+  std::vector<float> b(a.size());
+  auto B = std::mdspan(b.data(), std::dextents<int, 2>{70, 37});
+  permute_copy(A, B, {1, 0});
+  for (int i = 0; i < 70; ++i)
+    for (int j = 0; j < 37; ++j)
+      assert((B[i, j] == A[j, i]));
+
+  auto BL = std::mdspan<float, std::dextents<int, 2>, std::layout_left>(b.data(), 70, 37);
+  permute_copy(std::execution::par, A, BL, {1, 0});
+  for (int i = 0; i < 70; ++i)
+    for (int j = 0; j < 37; ++j)
+      assert((BL[i, j] == A[j, i]));
+
+  // Identity permutation of a strided source.
+  auto S = std::submdspan(A, std::strided_slice{.offset = 1, .extent = 36, .stride = 3}, std::full_extent);
+  std::vector<float> c(S.extent(0) * S.extent(1));
+  auto C = std::mdspan(c.data(), std::dextents<int, 2>{S.extent(0), S.extent(1)});
+  permute_copy(S, C, {0, 1});
+  for (int i = 0; i < C.extent(0); ++i)
+    for (int j = 0; j < C.extent(1); ++j)
+      assert((C[i, j] == S[i, j]));
+
+  // 3D
+  std::vector<double> d(5 * 66 * 9);
+  std::iota(d.begin(), d.end(), 0.);
+  auto D = std::mdspan(d.data(), std::dextents<int, 3>{5, 66, 9});
+  std::vector<double> e(d.size());
+  auto E = std::mdspan<double, std::dextents<int, 3>, std::layout_left>(e.data(), 9, 5, 66);
+  permute_copy(std::execution::par, D, E, {2, 0, 1});
+  for (int i = 0; i < 9; ++i)
+    for (int j = 0; j < 5; ++j)
+      for (int k = 0; k < 66; ++k)
+        assert((E[i, j, k] == D[j, k, i]));
+}
+
+void bench_transpose(int n, int reps) {
+  std::vector<float> a(std::size_t(n) * n);
+  std::vector<float> b(a.size());
+  std::iota(a.begin(), a.end(), 0.f);
+  auto A = std::mdspan(a.data(), std::dextents<int, 2>{n, n});
+  auto B = std::mdspan(b.data(), std::dextents<int, 2>{n, n});
+  const double bytes = 2. * a.size() * sizeof(float);
+
+  double t_naive = best_of(reps, [&] { naive_transpose(A, B); });
+  double t_seq = best_of(reps, [&] { permute_copy(A, B, {1, 0}); });
+  double t_par = best_of(reps, [&] { permute_copy(std::execution::par, A, B, {1, 0}); });
+
+  std::cout << "transpose " << n << "x" << n << " float: naive " << bytes / t_naive / 1e9
+            << " GB/s, permute_copy " << bytes / t_seq / 1e9
+            << " GB/s, permute_copy(par) " << bytes / t_par / 1e9 << " GB/s" << std::endl;
+}
+
+void bench_permute_3d(int n, int reps) {
+  std::vector<double> a(std::size_t(n) * n * n);
+  std::vector<double> b(a.size());
+  std::iota(a.begin(), a.end(), 0.);
+  auto A = std::mdspan(a.data(), std::dextents<int, 3>{n, n, n});
+  auto B = std::mdspan(b.data(), std::dextents<int, 3>{n, n, n});
+  const double bytes = 2. * a.size() * sizeof(double);
+
+  double t_naive = best_of(reps, [&] { naive_permute_201(A, B); });
+  double t_seq = best_of(reps, [&] { permute_copy(A, B, {2, 0, 1}); });
+  double t_par = best_of(reps, [&] { permute_copy(std::execution::par, A, B, {2, 0, 1}); });
+
+  std::cout << "permute {2, 0, 1} " << n << "^3 double: naive " << bytes / t_naive / 1e9
+            << " GB/s, permute_copy " << bytes / t_seq / 1e9
+            << " GB/s, permute_copy(par) " << bytes / t_par / 1e9 << " GB/s" << std::endl;
+}
+
+// Usage: permute_copy_example [<n2d> [<n3d> [<reps>]]]
+int main(int argc, char **argv) {
+  test_permute_copy();
+
+  const int n2d = argc > 1 ? std::atoi(argv[1]) : 2048;
+  const int n3d = argc > 2 ? std::atoi(argv[2]) : 128;
+  const int reps = argc > 3 ? std::atoi(argv[3]) : 3;
+
+  bench_transpose(n2d, reps);
+  bench_permute_3d(n3d, reps);
+}
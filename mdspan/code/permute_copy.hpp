@@ -0,0 +1,235 @@
+#pragma once
+
+#include <experimental/mdspan>
+#include <experimental/simd>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <execution>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+// permute_copy(src, dst, axes) materializes a permutation of the axes of src
+// into dst: dst[i_0, ..., i_{R-1}] == src[j] with j[axes[k]] == i_k, i.e.
+// dst.extent(k) == src.extent(axes[k]). transposed(m) corresponds to axes
+// {1, 0}. src and dst may have different layouts.
+//
+// For strided layouts the copy is done in tiles over the fastest axis of dst
+// and the fastest axis of src, so that both are read and written in
+// contiguous runs. When both of these axes have unit stride, the tiles are
+// transposed through simd registers. The tiles are distributed with the
+// given execution policy.
+//
+// Other layouts or accessors fall back to an element-wise loop.
+
+namespace impl {
+
+namespace stdx = std::experimental;
+
+inline constexpr std::size_t permute_tile = 64;
+inline constexpr std::size_t permute_tile_1d = 4096;
+
+// dst[ia + ib * dst_ld] = src[ia * src_ld + ib] for ia < na, ib < nb,
+// i.e. src is contiguous along b and dst is contiguous along a.
+template <class T>
+void transpose_block(const T *src, std::ptrdiff_t src_ld, T *dst,
+                     std::ptrdiff_t dst_ld, std::size_t na, std::size_t nb) {
+  std::size_t na_w = 0;
+
+  if constexpr (std::is_arithmetic_v<T>) {
+    using simd_t = stdx::native_simd<T>;
+    constexpr std::size_t W = simd_t::size();
+    na_w = na / W * W;
+    const std::size_t nb_w = nb / W * W;
+
+    for (std::size_t ia = 0; ia < na_w; ia += W) {
+      for (std::size_t ib = 0; ib < nb_w; ib += W) {
+        // W x W in-register transpose: W row loads, W column stores.
+        std::array<simd_t, W> rows;
+        for (std::size_t r = 0; r < W; ++r) {
+          rows[r].copy_from(src + (ia + r) * src_ld + ib, stdx::element_aligned);
+        }
+        for (std::size_t c = 0; c < W; ++c) {
+          const simd_t col([&](auto r) { return T(rows[r][c]); });
+          col.copy_to(dst + ia + (ib + c) * dst_ld, stdx::element_aligned);
+        }
+      }
+      for (std::size_t ib = nb_w; ib < nb; ++ib) {
+        for (std::size_t r = ia; r < ia + W; ++r) {
+          dst[r + ib * dst_ld] = src[r * src_ld + ib];
+        }
+      }
+    }
+  }
+
+  for (std::size_t ia = na_w; ia < na; ++ia) {
+    for (std::size_t ib = 0; ib < nb; ++ib) {
+      dst[ia + ib * dst_ld] = src[ia * src_ld + ib];
+    }
+  }
+}
+
+// Index of the axis with the smallest stride among the axes with extent > 1.
+template <std::size_t R>
+std::size_t fastest_axis(const std::array<std::size_t, R> &ext,
+                         const std::array<std::ptrdiff_t, R> &stride) {
+  std::size_t fastest = R;
+  for (std::size_t k = 0; k < R; ++k) {
+    if (ext[k] > 1 && (fastest == R || stride[k] < stride[fastest]))
+      fastest = k;
+  }
+  return fastest == R ? 0 : fastest;
+}
+
+// ext, ss and ds are indexed by the axes of dst.
+template <class ExecutionPolicy, class T, std::size_t R>
+void permute_copy_strided(ExecutionPolicy &&policy, const T *src, T *dst,
+                          const std::array<std::size_t, R> &ext,
+                          const std::array<std::ptrdiff_t, R> &ss,
+                          const std::array<std::ptrdiff_t, R> &ds) {
+  if constexpr (R == 0) {
+    *dst = *src;
+  } else {
+    const std::size_t a = fastest_axis(ext, ds);
+    const std::size_t b = fastest_axis(ext, ss);
+
+    std::array<std::size_t, R> outer{};
+    std::size_t n_outer_axes = 0;
+    std::size_t n_outer = 1;
+    for (std::size_t k = 0; k < R; ++k) {
+      if (k != a && k != b) {
+        outer[n_outer_axes++] = k;
+        n_outer *= ext[k];
+      }
+    }
+
+    const std::size_t tile_a = a == b ? permute_tile_1d : permute_tile;
+    const std::size_t nta = (ext[a] + tile_a - 1) / tile_a;
+    const std::size_t ntb = a == b ? 1 : (ext[b] + permute_tile - 1) / permute_tile;
+
+    std::vector<std::size_t> tiles(n_outer * nta * ntb);
+    std::iota(tiles.begin(), tiles.end(), std::size_t{0});
+
+    std::for_each(std::forward<ExecutionPolicy>(policy), tiles.begin(), tiles.end(), [&](std::size_t id) {
+      const std::size_t tb = id % ntb;
+      id /= ntb;
+      const std::size_t ta = id % nta;
+      std::size_t o = id / nta;
+
+      const T *s = src;
+      T *d = dst;
+      for (std::size_t k = n_outer_axes; k-- > 0;) {
+        const std::size_t axis = outer[k];
+        const std::ptrdiff_t i = o % ext[axis];
+        o /= ext[axis];
+        s += i * ss[axis];
+        d += i * ds[axis];
+      }
+
+      const std::size_t ia0 = ta * tile_a;
+      const std::size_t na = std::min(tile_a, ext[a] - ia0);
+      s += ia0 * ss[a];
+      d += ia0 * ds[a];
+
+      if (a == b) {
+        if (ss[a] == 1 && ds[a] == 1) {
+          std::copy(s, s + na, d);
+        } else {
+          for (std::size_t ia = 0; ia < na; ++ia) {
+            d[ia * ds[a]] = s[ia * ss[a]];
+          }
+        }
+        return;
+      }
+
+      const std::size_t ib0 = tb * permute_tile;
+      const std::size_t nb = std::min(permute_tile, ext[b] - ib0);
+      s += ib0 * ss[b];
+      d += ib0 * ds[b];
+
+      if (ss[b] == 1 && ds[a] == 1) {
+        transpose_block(s, ss[a], d, ds[b], na, nb);
+      } else {
+        for (std::size_t ia = 0; ia < na; ++ia) {
+          for (std::size_t ib = 0; ib < nb; ++ib) {
+            d[ia * ds[a] + ib * ds[b]] = s[ia * ss[a] + ib * ss[b]];
+          }
+        }
+      }
+    });
+  }
+}
+
+template <class Accessor>
+inline constexpr bool is_default_accessor_v = false;
+
+template <class T>
+inline constexpr bool is_default_accessor_v<std::default_accessor<T>> = true;
+
+} // namespace impl
+
+template <class ExecutionPolicy, class ST, class SE, class SL, class SA,
+          class DT, class DE, class DL, class DA>
+  requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void permute_copy(ExecutionPolicy &&policy, std::mdspan<ST, SE, SL, SA> src,
+                  std::mdspan<DT, DE, DL, DA> dst,
+                  const std::array<std::size_t, SE::rank()> &axes) {
+  static_assert(SE::rank() == DE::rank());
+  constexpr std::size_t R = SE::rank();
+
+  std::array<bool, R> seen{};
+  for (std::size_t k = 0; k < R; ++k) {
+    if (axes[k] >= R || seen[axes[k]])
+      std::terminate();
+    seen[axes[k]] = true;
+    if (static_cast<std::size_t>(dst.extent(k)) != static_cast<std::size_t>(src.extent(axes[k])))
+      std::terminate();
+  }
+
+  if constexpr (SL::template mapping<SE>::is_always_strided() &&
+                DL::template mapping<DE>::is_always_strided() &&
+                impl::is_default_accessor_v<SA> &&
+                impl::is_default_accessor_v<DA> &&
+                std::is_same_v<std::remove_const_t<ST>, DT>) {
+    std::array<std::size_t, R> ext{};
+    std::array<std::ptrdiff_t, R> ss{};
+    std::array<std::ptrdiff_t, R> ds{};
+    for (std::size_t k = 0; k < R; ++k) {
+      ext[k] = dst.extent(k);
+      ss[k] = src.stride(axes[k]);
+      ds[k] = dst.stride(k);
+    }
+    impl::permute_copy_strided(std::forward<ExecutionPolicy>(policy),
+                               src.data_handle(), dst.data_handle(), ext, ss, ds);
+  } else {
+    // Element-wise, in the index order of dst.
+    using dst_index = typename DE::index_type;
+    using src_index = typename SE::index_type;
+    std::size_t size = 1;
+    for (std::size_t k = 0; k < R; ++k)
+      size *= dst.extent(k);
+
+    std::array<dst_index, R> di{};
+    std::array<src_index, R> si{};
+    for (std::size_t n = 0; n < size; ++n) {
+      std::size_t f = n;
+      for (std::size_t k = R; k-- > 0;) {
+        di[k] = f % dst.extent(k);
+        f /= dst.extent(k);
+        si[axes[k]] = di[k];
+      }
+      dst[di] = src[si];
+    }
+  }
+}
+
+template <class ST, class SE, class SL, class SA, class DT, class DE, class DL,
+          class DA>
+void permute_copy(std::mdspan<ST, SE, SL, SA> src,
+                  std::mdspan<DT, DE, DL, DA> dst,
+                  const std::array<std::size_t, SE::rank()> &axes) {
+  permute_copy(std::execution::seq, src, dst, axes);
+}
@@ -0,0 +1,126 @@
+#include "prefetch.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using ext2 = std::dextents<int, 2>;
+
+// Column sums of a matrix, walking each column along the strided axis 0,
+// like B[l, j] in gemm_2.
+template <class M> void column_sums(M b, float *out, int first = 0, int last = -1) {
+  if (last < 0)
+    last = b.extent(1);
+  for (int j = first; j < last; ++j) {
+    float s = 0;
+    for (int l = 0; l < b.extent(0); ++l)
+      s += b[l, j];
+    out[j] = s;
+  }
+}
+
+// y[k] = x[idx[k]] for k in [first, last).
+void gather(const float *x, const std::uint32_t *idx, float *y, std::size_t first,
+            std::size_t last, std::size_t distance) {
+  prefetch_loop(
+      last - first, distance, [&](std::size_t k) { return x + idx[first + k]; },
+      [&](std::size_t k) { y[first + k] = x[idx[first + k]]; });
+}
+
+void test_prefetch() {
+  const int m = 50, n = 30;
+  std::vector<float> v(m * n);
+  std::iota(v.begin(), v.end(), 0.f);
+  auto A = std::mdspan(v.data(), ext2{m, n});
+  std::vector<float> s0(n), s1(n);
+  column_sums(A, s0.data());
+  // Past the end of A, up to 64 rows ahead: prefetches do not fault.
+  column_sums(with_prefetch(A, 0, 64), s1.data());
+  assert(s0 == s1);
+
+  auto S = std::submdspan(A, std::strided_slice{.offset = 1, .extent = 45, .stride = 3},
+                          std::full_extent);
+  auto P = with_prefetch(S, 0, 4);
+  assert(P.accessor().ahead == 4 * 3 * n);
+  for (int i = 0; i < S.extent(0); ++i)
+    for (int j = 0; j < n; ++j)
+      assert((P[i, j] == S[i, j]));
+
+  // Every index once, in order, whatever the distance.
+  for (std::size_t d : {0, 1, 7, 100}) {
+    std::vector<int> seen;
+    prefetch_loop(10, d, [&](int k) { return &v[k]; }, [&](int k) { seen.push_back(k); });
+    std::vector<int> all(10);
+    std::iota(all.begin(), all.end(), 0);
+    assert(seen == all);
+  }
+
+  const prefetch_tuning t = tune_prefetch_distance([&](std::size_t d) {
+    column_sums(with_prefetch(A, 0, d), s1.data());
+  });
+  assert(std::find(prefetch_distances.begin(), prefetch_distances.end(), t.distance) !=
+         prefetch_distances.end());
+  assert(t.distance == 0 ? t.seconds == t.seconds_without : t.seconds < t.seconds_without);
+}
+
+void bench_columns(int n, int reps) {
+  std::vector<float> b(std::size_t(n) * n);
+  for (std::size_t i = 0; i < b.size(); ++i)
+    b[i] = float(i % 100);
+  auto B = std::mdspan(b.data(), ext2{n, n});
+  std::vector<float> s0(n), s1(n);
+
+  // Calibration on the first 16 columns.
+  const prefetch_tuning t = tune_prefetch_distance([&](std::size_t d) {
+    column_sums(with_prefetch(B, 0, d), s1.data(), 0, std::min(n, 16));
+  });
+  const double plain = best_of(reps, [&] { column_sums(B, s0.data()); });
+  const double pref = best_of(reps, [&] { column_sums(with_prefetch(B, 0, t.distance), s1.data()); });
+  assert(s0 == s1);
+
+  const double gb = b.size() * sizeof(float) * 1e-9;
+  std::cout << "column walk, " << n << ", " << t.distance << ", " << gb / plain << ", "
+            << gb / pref << ", " << plain / pref << std::endl;
+}
+
+void bench_gather(std::size_t n, std::size_t k, int reps) {
+  std::vector<float> x(n);
+  std::iota(x.begin(), x.end(), 0.f);
+  std::vector<std::uint32_t> idx(k);
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<std::uint32_t> dist(0, std::uint32_t(n - 1));
+  for (auto &i : idx)
+    i = dist(gen);
+  std::vector<float> y0(k), y1(k);
+
+  // Calibration on the first 1/16 of the gathers.
+  const prefetch_tuning t = tune_prefetch_distance(
+      [&](std::size_t d) { gather(x.data(), idx.data(), y1.data(), 0, k / 16, d); });
+  const double plain = best_of(reps, [&] { gather(x.data(), idx.data(), y0.data(), 0, k, 0); });
+  const double pref =
+      best_of(reps, [&] { gather(x.data(), idx.data(), y1.data(), 0, k, t.distance); });
+  assert(y0 == y1);
+
+  // Bytes used: the gathered elements, the indices and y.
+  const double gb = k * (sizeof(float) * 2 + sizeof(std::uint32_t)) * 1e-9;
+  std::cout << "gather, " << n << ", " << t.distance << ", " << gb / plain << ", " << gb / pref
+            << ", " << plain / pref << std::endl;
+}
+
+// Usage: prefetch_example [<n> [<reps>]]
+int main(int argc, char **argv) {
+  test_prefetch();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  std::cout << "kernel, n, tuned distance, plain [GB/s], prefetch, speedup" << std::endl;
+  bench_columns(n, reps);
+  bench_gather(std::size_t(n) * n, std::size_t(n) * n / 4, reps);
+}
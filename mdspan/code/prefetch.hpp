@@ -0,0 +1,148 @@
+#pragma once
+
+#include <experimental/mdspan>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <xmmintrin.h>
+#endif
+
+// Software prefetches for traversals the hardware prefetchers miss: walks
+// along the non-contiguous axis of a layout (B[l, j] over l in gemm_2, the
+// rows of a column of a layout_right matrix), layout_stride views with a
+// large stride, and gathers x[idx[k]].
+//
+// with_prefetch(m, axis, distance) returns m with a prefetch_accessor,
+// which on each access m[i...] prefetches the element distance steps
+// further along axis, m[i... + distance * e_axis], into the caches. A
+// kernel walking m along axis then has the element it reads distance
+// iterations later in flight. Prefetches do not fault, the element ahead
+// may be past the end of m. Prefetching along a contiguous axis only
+// repeats the prefetch of the same line.
+//
+// prefetch_loop(n, distance, address, f) calls f(k) for k in [0, n) and
+// prefetches address(k + distance) before, for indirect accesses:
+//
+//   prefetch_loop(n, d, [&](int k) { return &x[idx[k]]; },
+//                 [&](int k) { y[k] = x[idx[k]]; });
+//
+// The best distance depends on the latency of the memory, the work per
+// iteration and the machine. tune_prefetch_distance(run) times run(d), a
+// small calibration run of the kernel with distance d, for a few distances,
+// d = 0 (no prefetch) included, and returns the fastest. Where the out of
+// order core already overlaps the misses (independent loads, large last
+// level caches), it returns 0.
+
+namespace impl {
+
+inline void prefetch_read(const void *p) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(p, 0, 3);
+#elif defined(_MSC_VER)
+  _mm_prefetch(static_cast<const char *>(p), _MM_HINT_T0);
+#endif
+}
+
+// p + n elements, without pointer arithmetic past the end of the array.
+template <class T> const void *prefetch_address(const T *p, std::ptrdiff_t n) noexcept {
+  return reinterpret_cast<const void *>(reinterpret_cast<std::uintptr_t>(p) +
+                                        static_cast<std::uintptr_t>(n * std::ptrdiff_t(sizeof(T))));
+}
+
+} // namespace impl
+
+template <class T> struct prefetch_accessor {
+  using element_type = T;
+  using reference = T &;
+  using data_handle_type = T *;
+  using offset_policy = prefetch_accessor;
+
+  // Distance of the prefetched element, in elements of the storage.
+  std::ptrdiff_t ahead = 0;
+
+  constexpr prefetch_accessor() = default;
+  constexpr explicit prefetch_accessor(std::ptrdiff_t ahead) : ahead(ahead) {}
+
+  constexpr data_handle_type offset(data_handle_type p, std::size_t i) const noexcept {
+    return p + i;
+  }
+
+  reference access(data_handle_type p, std::size_t i) const noexcept {
+    impl::prefetch_read(impl::prefetch_address(p + i, ahead));
+    return p[i];
+  }
+};
+
+template <class T, class E, class L>
+  requires(L::template mapping<E>::is_always_strided())
+std::mdspan<T, E, L, prefetch_accessor<T>> with_prefetch(std::mdspan<T, E, L> m, std::size_t axis,
+                                                         std::size_t distance) {
+  if (axis >= E::rank())
+    std::terminate();
+  const auto ahead = std::ptrdiff_t(distance) * std::ptrdiff_t(m.stride(axis));
+  return {m.data_handle(), m.mapping(), prefetch_accessor<T>(ahead)};
+}
+
+template <class I, class A, class F>
+void prefetch_loop(I n, std::size_t distance, A &&address, F &&f) {
+  const I d = static_cast<I>(std::min<std::size_t>(distance, std::size_t(n)));
+  I k = 0;
+  if (d > 0) {
+    for (; k + d < n; ++k) {
+      impl::prefetch_read(address(k + d));
+      f(k);
+    }
+  }
+  for (; k < n; ++k)
+    f(k);
+}
+
+struct prefetch_tuning {
+  std::size_t distance = 0;
+  // Best times of the calibration run, with the distance and without
+  // prefetches.
+  double seconds = 0;
+  double seconds_without = 0;
+
+  double speedup() const { return seconds > 0 ? seconds_without / seconds : 1; }
+};
+
+// The candidates distances, in iterations.
+inline const std::vector<std::size_t> prefetch_distances = {0, 2, 4, 8, 16, 32, 64};
+
+// Prefetches are used if they make the calibration run at least this much
+// faster, rather than on timing noise.
+inline constexpr double prefetch_min_gain = 1.02;
+
+template <class F>
+prefetch_tuning tune_prefetch_distance(F &&run, const std::vector<std::size_t> &distances = prefetch_distances,
+                                       int reps = 3) {
+  std::vector<double> best(distances.size(), std::numeric_limits<double>::infinity());
+  double without = std::numeric_limits<double>::infinity();
+  auto time = [&](std::size_t d) {
+    const auto start = std::chrono::steady_clock::now();
+    run(d);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+  // Interleaved, so that a slow period of the machine affects every
+  // distance alike.
+  for (int r = 0; r < reps; ++r) {
+    without = std::min(without, time(0));
+    for (std::size_t c = 0; c < distances.size(); ++c)
+      best[c] = distances[c] == 0 ? without : std::min(best[c], time(distances[c]));
+  }
+  if (distances.empty())
+    return {0, without, without};
+  const std::size_t c = std::min_element(best.begin(), best.end()) - best.begin();
+  if (best[c] * prefetch_min_gain >= without)
+    return {0, without, without};
+  return {distances[c], best[c], without};
+}
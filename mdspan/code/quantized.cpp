@@ -0,0 +1,165 @@
+#include "quantized.hpp"
+#include "timer.hpp"
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+void test_half() {
+  for (float f : {0.f, 1.f, -2.5f, 65504.f, 0x1p-14f, 0x1p-24f, 1.f / 3})
+    assert(std::abs(impl::half_to_float(impl::float_to_half(f)) - f) <= std::abs(f) * 0x1p-11f);
+  assert(std::isinf(impl::half_to_float(impl::float_to_half(1e6f))));
+  assert(std::isnan(impl::half_to_float(impl::float_to_half(NAN))));
+  // Ties round to even: 1 + 2^-11 is halfway between 1 and 1 + 2^-10.
+  assert(impl::half_to_float(impl::float_to_half(1.f + 0x1p-11f)) == 1.f);
+  // All the halves but NaNs round trip.
+  for (unsigned h = 0; h < 0x10000; ++h) {
+    const float f = impl::half_to_float(h);
+    if (!std::isnan(f))
+      assert(impl::float_to_half(f) == h);
+  }
+}
+
+template <class Accessor> void test_accessor(float tolerance) {
+  const int m = 37, n = 53;
+  std::vector<float> v(m * n);
+  for (int i = 0; i < m * n; ++i)
+    v[i] = std::sin(0.1f * i) * (1 + i % 7);
+  auto A = std::mdspan(v.data(), std::dextents<int, 2>{m, n});
+
+  const auto q = quantize<Accessor>(A);
+  const auto Q = q.to_mdspan();
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      assert((std::abs(Q[i, j] - A[i, j]) <= tolerance * 7));
+
+  // Views of a quantized mdspan decode with the scales of their blocks.
+  auto S = std::submdspan(Q, std::pair{5, 30}, std::pair{7, 50});
+  auto SA = std::submdspan(A, std::pair{5, 30}, std::pair{7, 50});
+  for (int i = 0; i < S.extent(0); ++i)
+    for (int j = 0; j < S.extent(1); ++j)
+      assert((S[i, j] == Q[i + 5, j + 7]));
+  assert((std::abs(S[3, 4] - SA[3, 4]) <= tolerance * 7));
+}
+
+// Keeps the kernels from being optimized away.
+volatile double sink;
+
+// Both kernels use 8 partial sums so that they are limited by the loads and
+// the decoding rather than by the latency of the additions.
+template <class V> double sum(V x) {
+  std::array<float, 8> s{};
+  const int n = x.extent(0);
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    for (int k = 0; k < 8; ++k)
+      s[k] += x[i + k];
+  for (; i < n; ++i)
+    s[0] += x[i];
+  return std::accumulate(s.begin(), s.end(), 0.);
+}
+
+template <class M> void gemv(M A, const std::vector<float> &x, std::vector<float> &y) {
+  const int n = A.extent(1);
+  for (int i = 0; i < A.extent(0); ++i) {
+    std::array<float, 8> s{};
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+      for (int k = 0; k < 8; ++k)
+        s[k] += A[i, j + k] * x[j + k];
+    for (; j < n; ++j)
+      s[0] += A[i, j] * x[j];
+    y[i] = std::accumulate(s.begin(), s.end(), 0.f);
+  }
+}
+
+struct bench_data {
+  int n;
+  std::vector<float> a;
+  std::vector<float> x;
+  std::vector<float> y_ref;
+  double sum_ref;
+};
+
+// Reports the bytes moved per element, the bandwidth actually moved and the
+// effective one (bytes of the float data per second) of a sum and of an
+// n x n GEMV, and the error of the elements, the sum and the result of the
+// GEMV relative to the max norm of the reference.
+template <class Mat, class Vec>
+void bench(const std::string &name, Mat A, Vec a, double bytes, const bench_data &d, int reps) {
+  const double elems = double(d.n) * d.n;
+  double s = 0;
+  std::vector<float> y(d.n);
+  const double t_sum = best_of(reps, [&] { s = sum(a); });
+  const double t_gemv = best_of(reps, [&] { gemv(A, d.x, y); });
+  sink = s + y[0];
+
+  double amax = 0, err = 0, ymax = 0, yerr = 0;
+  for (std::size_t i = 0; i < d.a.size(); ++i) {
+    amax = std::max(amax, double(std::abs(d.a[i])));
+    err = std::max(err, double(std::abs(a[i] - d.a[i])));
+  }
+  for (int i = 0; i < d.n; ++i) {
+    ymax = std::max(ymax, double(std::abs(d.y_ref[i])));
+    yerr = std::max(yerr, double(std::abs(y[i] - d.y_ref[i])));
+  }
+
+  std::cout << name << ", " << bytes / elems << ", " << bytes / t_sum / 1e9 << ", "
+            << 4 * elems / t_sum / 1e9 << ", " << bytes / t_gemv / 1e9 << ", "
+            << 4 * elems / t_gemv / 1e9 << ", " << err / amax << ", "
+            << std::abs(s - d.sum_ref) / std::abs(d.sum_ref) << ", " << yerr / ymax << std::endl;
+}
+
+template <class Accessor>
+void bench_quantized(const std::string &name, const bench_data &d, int reps) {
+  auto A = std::mdspan(d.a.data(), std::dextents<int, 2>{d.n, d.n});
+  auto a = std::mdspan(d.a.data(), std::dextents<int, 1>{d.n * d.n});
+  const auto qA = quantize<Accessor>(A);
+  const auto qa = quantize<Accessor>(a);
+  bench(name, qA.to_mdspan(), qa.to_mdspan(), qa.bytes(), d, reps);
+}
+
+// Usage: quantized_example [<n> [<reps>]]
+// Benchmarks an n x n matrix of smooth data plus noise.
+int main(int argc, char **argv) {
+  test_half();
+  test_accessor<fp16_accessor<float>>(1.f / 1024);
+  test_accessor<int16_block_accessor<64>>(1.f / 32767);
+  test_accessor<int8_block_accessor<32>>(1.f / 127);
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  bench_data d{n, std::vector<float>(std::size_t(n) * n), std::vector<float>(n),
+               std::vector<float>(n), 0.};
+  std::mt19937 gen(42);
+  std::normal_distribution<float> noise(0.f, 0.1f);
+  for (std::size_t i = 0; i < d.a.size(); ++i)
+    d.a[i] = 10 * std::sin(1e-3f * i) + noise(gen);
+  for (int i = 0; i < n; ++i)
+    d.x[i] = std::cos(0.01f * i);
+  for (float v : d.a)
+    d.sum_ref += v;
+  for (int i = 0; i < n; ++i) {
+    double s = 0;
+    for (int j = 0; j < n; ++j)
+      s += double(d.a[std::size_t(i) * n + j]) * d.x[j];
+    d.y_ref[i] = s;
+  }
+
+  std::cout << "format, bytes/element, sum [GB/s], sum effective [GB/s], gemv [GB/s], "
+               "gemv effective [GB/s], element error, sum error, gemv error"
+            << std::endl;
+  bench("float", std::mdspan(d.a.data(), std::dextents<int, 2>{n, n}),
+        std::mdspan(d.a.data(), std::dextents<int, 1>{n * n}), 4. * n * n, d, reps);
+  bench_quantized<fp16_accessor<float>>("fp16", d, reps);
+  bench_quantized<int16_block_accessor<64>>("int16/64", d, reps);
+  bench_quantized<int8_block_accessor<64>>("int8/64", d, reps);
+  bench_quantized<int8_block_accessor<256>>("int8/256", d, reps);
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <experimental/mdspan>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+// Read-only accessors over compressed storage, decoding on access, like
+// scaled_accessor in mdspan.cpp scales on access:
+//
+// fp16_accessor<T>: IEEE binary16 storage, 2 bytes per element.
+// block_quantized_accessor<Q, B, T>: signed integer codes Q (int8_t or
+// int16_t) with one scale factor per block of B consecutive elements of the
+// storage, value = code * scale[offset / B]. The scale of a block is
+// max |x| / numeric_limits<Q>::max(), i.e. symmetric quantization.
+//
+// Streaming kernels reading these views move 2x (fp16, int16) to about 4x
+// (int8) fewer bytes than over float.
+//
+// quantize<Accessor>(m) encodes an mdspan into a quantized_mdarray, which
+// keeps the mapping of m and owns the encoded storage. The whole range
+// [0, required_span_size()) of the storage of m is encoded.
+
+namespace impl {
+
+inline std::uint16_t float_to_half(float f) {
+  const std::uint32_t x = std::bit_cast<std::uint32_t>(f);
+  const std::uint16_t sign = (x >> 16) & 0x8000;
+  std::uint32_t ax = x & 0x7fffffff;
+
+  // Inf and NaN
+  if (ax >= 0x7f800000)
+    return sign | 0x7c00 | (ax > 0x7f800000 ? 0x200 : 0);
+  // Rounds to inf, from 65520 on.
+  if (ax >= 0x477ff000)
+    return sign | 0x7c00;
+  // Subnormal halves, in units of 2^-24.
+  if (ax < 0x38800000)
+    return sign | static_cast<std::uint16_t>(std::nearbyint(std::bit_cast<float>(ax) * 0x1p24f));
+  // Normal halves, rounded to nearest even.
+  ax += 0xfff + ((ax >> 13) & 1);
+  return sign | static_cast<std::uint16_t>((ax - 0x38000000) >> 13);
+}
+
+inline float half_to_float(std::uint16_t h) {
+#if defined(__F16C__)
+  return _cvtsh_ss(h);
+#else
+  const std::uint32_t sign = std::uint32_t(h & 0x8000) << 16;
+  const std::uint32_t exp = (h >> 10) & 0x1f;
+  const std::uint32_t mant = h & 0x3ff;
+
+  if (exp == 0) {
+    const float f = mant * 0x1p-24f;
+    return sign ? -f : f;
+  }
+  if (exp == 31)
+    return std::bit_cast<float>(sign | 0x7f800000 | (mant << 13));
+  return std::bit_cast<float>(sign | ((exp + 112) << 23) | (mant << 13));
+#endif
+}
+
+} // namespace impl
+
+template <class T = float> struct fp16_accessor {
+  using element_type = const T;
+  using reference = T;
+  using data_handle_type = const std::uint16_t *;
+  using offset_policy = fp16_accessor;
+
+  // Encoded storage.
+  struct storage {
+    std::vector<std::uint16_t> codes;
+  };
+
+  static storage encode(const T *src, std::size_t n) {
+    storage s{std::vector<std::uint16_t>(n)};
+    for (std::size_t i = 0; i < n; ++i)
+      s.codes[i] = impl::float_to_half(static_cast<float>(src[i]));
+    return s;
+  }
+
+  static data_handle_type data_handle(const storage &s) { return s.codes.data(); }
+
+  static std::size_t bytes(const storage &s) {
+    return s.codes.size() * sizeof(std::uint16_t);
+  }
+
+  constexpr data_handle_type offset(data_handle_type p, std::size_t i) const noexcept {
+    return p + i;
+  }
+
+  reference access(data_handle_type p, std::size_t i) const noexcept {
+    return static_cast<T>(impl::half_to_float(p[i]));
+  }
+};
+
+template <class Q, std::size_t B = 64, class T = float>
+struct block_quantized_accessor {
+  static_assert(std::is_integral_v<Q> && std::is_signed_v<Q>);
+  static_assert(B > 0);
+
+  using element_type = const T;
+  using reference = T;
+  using offset_policy = block_quantized_accessor;
+
+  // Codes, scales and the storage offset of codes[0], so that offset()
+  // keeps track of the block an element belongs to.
+  struct data_handle_type {
+    const Q *codes = nullptr;
+    const T *scales = nullptr;
+    std::size_t start = 0;
+  };
+
+  struct storage {
+    std::vector<Q> codes;
+    std::vector<T> scales;
+  };
+
+  static storage encode(const T *src, std::size_t n) {
+    constexpr T qmax = std::numeric_limits<Q>::max();
+    storage s{std::vector<Q>(n), std::vector<T>((n + B - 1) / B)};
+    for (std::size_t b = 0; b < s.scales.size(); ++b) {
+      const std::size_t first = b * B;
+      const std::size_t last = std::min(n, first + B);
+      T amax = 0;
+      for (std::size_t i = first; i < last; ++i)
+        amax = std::max(amax, std::abs(src[i]));
+      const T scale = amax / qmax;
+      const T inv = scale == 0 ? T(0) : 1 / scale;
+      s.scales[b] = scale;
+      for (std::size_t i = first; i < last; ++i)
+        s.codes[i] = static_cast<Q>(std::clamp<T>(std::nearbyint(src[i] * inv), -qmax, qmax));
+    }
+    return s;
+  }
+
+  static data_handle_type data_handle(const storage &s) {
+    return {s.codes.data(), s.scales.data(), 0};
+  }
+
+  static std::size_t bytes(const storage &s) {
+    return s.codes.size() * sizeof(Q) + s.scales.size() * sizeof(T);
+  }
+
+  constexpr data_handle_type offset(data_handle_type p, std::size_t i) const noexcept {
+    return {p.codes, p.scales, p.start + i};
+  }
+
+  constexpr reference access(data_handle_type p, std::size_t i) const noexcept {
+    const std::size_t k = p.start + i;
+    return p.codes[k] * p.scales[k / B];
+  }
+};
+
+template <std::size_t B = 64, class T = float>
+using int8_block_accessor = block_quantized_accessor<std::int8_t, B, T>;
+
+template <std::size_t B = 64, class T = float>
+using int16_block_accessor = block_quantized_accessor<std::int16_t, B, T>;
+
+// Owns the encoded elements of an mdspan, see quantize.
+template <class Accessor, class Extents, class Layout> class quantized_mdarray {
+public:
+  using mapping_type = typename Layout::template mapping<Extents>;
+  using mdspan_type =
+      std::mdspan<typename Accessor::element_type, Extents, Layout, Accessor>;
+
+  quantized_mdarray(typename Accessor::storage storage, const mapping_type &map)
+      : storage_(std::move(storage)), map_(map) {}
+
+  mdspan_type to_mdspan() const {
+    return mdspan_type(Accessor::data_handle(storage_), map_, Accessor{});
+  }
+
+  // Bytes of the encoded storage, scales included.
+  std::size_t bytes() const { return Accessor::bytes(storage_); }
+
+private:
+  typename Accessor::storage storage_;
+  mapping_type map_;
+};
+
+template <class Accessor, class T, class E, class L, class A>
+quantized_mdarray<Accessor, E, L> quantize(std::mdspan<T, E, L, A> m) {
+  static_assert(std::is_same_v<A, std::default_accessor<T>>,
+                "quantize reads the storage of m directly");
+  return {Accessor::encode(m.data_handle(), m.mapping().required_span_size()), m.mapping()};
+}
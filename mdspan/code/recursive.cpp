@@ -0,0 +1,184 @@
+#include "recursive.hpp"
+#include "timer.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using ext2 = std::dextents<int, 2>;
+using enum recursive_dim;
+
+// The leaf kernels, plain loops over the leaf views.
+inline constexpr auto transpose_leaf = [](auto a, auto b) {
+  for (int i = 0; i < a.extent(0); ++i)
+    for (int j = 0; j < a.extent(1); ++j)
+      b[j, i] = a[i, j];
+};
+
+// The leaf views are layout_stride: rows with unit stride are walked through
+// pointers, for loops the compiler vectorizes.
+inline constexpr auto gemm_leaf = [](auto c, auto a, auto b) {
+  const bool rows = c.stride(1) == 1 && b.stride(1) == 1;
+  for (int i = 0; i < c.extent(0); ++i)
+    for (int l = 0; l < a.extent(1); ++l) {
+      const auto ail = a[i, l];
+      if (rows) {
+        auto *ci = &c[i, 0];
+        const auto *bl = &b[l, 0];
+        for (int j = 0; j < c.extent(1); ++j)
+          ci[j] += ail * bl[j];
+      } else {
+        for (int j = 0; j < c.extent(1); ++j)
+          c[i, j] += ail * b[l, j];
+      }
+    }
+};
+
+// out = average of the 4 neighbours, out and in with a halo of 1.
+inline constexpr auto stencil_leaf = [](auto out, auto in) {
+  for (int i = 0; i < out.extent(0); ++i)
+    for (int j = 0; j < out.extent(1); ++j)
+      out[i, j] = 0.25 * (in[i, j + 1] + in[i + 2, j + 1] + in[i + 1, j] + in[i + 1, j + 2]);
+};
+
+// Leaves along a dimension of extent n, halved down to at most leaf.
+int leaf_count(int n, int leaf) {
+  return n <= leaf ? 1 : leaf_count(n / 2, leaf) + leaf_count(n - n / 2, leaf);
+}
+
+void test_recursive() {
+  // Transpose, not square, and leaf sizes.
+  const int m = 37, n = 1000;
+  std::vector<int> a(m * n), b(m * n, -1);
+  for (int i = 0; i < m * n; ++i)
+    a[i] = i;
+  auto A = std::mdspan(a.data(), ext2{m, n});
+  auto B = std::mdspan(b.data(), ext2{n, m});
+  int leaves = 0;
+  recursive_split({independent, independent}, {.leaf = 16},
+                  [&](auto x, auto y) {
+                    assert(x.extent(0) <= 16 && x.extent(1) <= 16);
+                    ++leaves;
+                    transpose_leaf(x, y);
+                  },
+                  split_along(A, {0, 1}), split_along(B, {1, 0}));
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      assert((B[j, i] == A[i, j]));
+  assert(leaves == leaf_count(m, 16) * leaf_count(n, 16));
+
+  // Product, in parallel; the k halves are ordered, so that the sums are
+  // those of the loop, in the same order.
+  const int p = 70, q = 45, r = 90;
+  std::vector<double> ga(p * q), gb(q * r), gc(p * r, 1.), gd(p * r, 1.);
+  for (int i = 0; i < p * q; ++i)
+    ga[i] = (i % 13) * 0.1;
+  for (int i = 0; i < q * r; ++i)
+    gb[i] = (i % 7) * 0.3 - 1;
+  auto GA = std::mdspan(ga.data(), ext2{p, q});
+  auto GB = std::mdspan(gb.data(), ext2{q, r});
+  auto GC = std::mdspan(gc.data(), ext2{p, r});
+  gemm_leaf(std::mdspan(gd.data(), ext2{p, r}), GA, GB);
+  std::atomic<int> gemm_leaves = 0;
+  recursive_split(std::execution::par, {independent, independent, ordered},
+                  {.leaf = 8, .parallel_grain = 64},
+                  [&](auto c, auto x, auto y) {
+                    ++gemm_leaves;
+                    gemm_leaf(c, x, y);
+                  },
+                  split_along(GC, {0, 1}), split_along(GA, {0, 2}), split_along(GB, {2, 1}));
+  assert(gc == gd && gemm_leaves == leaf_count(p, 8) * leaf_count(q, 8) * leaf_count(r, 8));
+
+  // Stencil on the interior, the input with a halo of 1.
+  const int s = 50;
+  std::vector<double> in(s * s), out(s * s, 0.), ref(s * s, 0.);
+  for (int i = 0; i < s * s; ++i)
+    in[i] = (i * 17) % 23;
+  auto In = std::mdspan(in.data(), ext2{s, s});
+  auto interior = [&](std::vector<double> &v) {
+    return std::submdspan(std::mdspan(v.data(), ext2{s, s}), std::pair{1, s - 1},
+                          std::pair{1, s - 1});
+  };
+  stencil_leaf(interior(ref), In);
+  recursive_split(std::execution::par, {independent, independent}, {.leaf = 7, .parallel_grain = 0},
+                  stencil_leaf, split_along(interior(out), {0, 1}), split_along(In, {0, 1}, 1));
+  assert(out == ref);
+}
+
+void bench_transpose(int n, int reps) {
+  std::vector<float> a(std::size_t(n) * n), b(a.size()), c(a.size());
+  for (std::size_t i = 0; i < a.size(); ++i)
+    a[i] = float(i % 1000);
+  auto A = std::mdspan(a.data(), ext2{n, n});
+  auto B = std::mdspan(b.data(), ext2{n, n});
+  auto C = std::mdspan(c.data(), ext2{n, n});
+  const double gb = 2 * a.size() * sizeof(float) * 1e-9;
+
+  double t[3] = {1e30, 1e30, 1e30};
+  for (int k = 0; k < reps; ++k) {
+    Timer t0;
+    transpose_leaf(A, B);
+    t[0] = std::min(t[0], t0.elapsed());
+    Timer t1;
+    recursive_split({independent, independent}, {}, transpose_leaf, split_along(A, {0, 1}),
+                    split_along(C, {1, 0}));
+    t[1] = std::min(t[1], t1.elapsed());
+    Timer t2;
+    recursive_split(std::execution::par, {independent, independent}, {}, transpose_leaf,
+                    split_along(A, {0, 1}), split_along(C, {1, 0}));
+    t[2] = std::min(t[2], t2.elapsed());
+  }
+  assert(b == c);
+  std::cout << "transpose, " << n << ", " << gb / t[0] << ", " << gb / t[1] << ", " << gb / t[2]
+            << std::endl;
+}
+
+void bench_gemm(int n, int reps) {
+  std::vector<float> a(std::size_t(n) * n), b(a.size()), c(a.size()), d(a.size());
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    a[i] = float(i % 5);
+    b[i] = float(i % 3);
+  }
+  auto A = std::mdspan(a.data(), ext2{n, n});
+  auto B = std::mdspan(b.data(), ext2{n, n});
+  auto C = std::mdspan(c.data(), ext2{n, n});
+  auto D = std::mdspan(d.data(), ext2{n, n});
+  const double gflop = 2. * n * n * n * 1e-9;
+
+  double t[3] = {1e30, 1e30, 1e30};
+  for (int k = 0; k < reps; ++k) {
+    std::fill(c.begin(), c.end(), 0.f);
+    Timer t0;
+    gemm_leaf(C, A, B);
+    t[0] = std::min(t[0], t0.elapsed());
+    for (int par = 0; par < 2; ++par) {
+      std::fill(d.begin(), d.end(), 0.f);
+      Timer t1;
+      if (par)
+        recursive_split(std::execution::par, {independent, independent, ordered}, {.leaf = 64},
+                        gemm_leaf, split_along(D, {0, 1}), split_along(A, {0, 2}),
+                        split_along(B, {2, 1}));
+      else
+        recursive_split({independent, independent, ordered}, {.leaf = 64}, gemm_leaf,
+                        split_along(D, {0, 1}), split_along(A, {0, 2}), split_along(B, {2, 1}));
+      t[1 + par] = std::min(t[1 + par], t1.elapsed());
+    }
+  }
+  assert(c == d);
+  std::cout << "gemm, " << n << ", " << gflop / t[0] << ", " << gflop / t[1] << ", "
+            << gflop / t[2] << std::endl;
+}
+
+// Usage: recursive_example [<n> [<reps>]]
+int main(int argc, char **argv) {
+  test_recursive();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  std::cout << "kernel, n, loop [GB/s or GFLOP/s], recursive_split, par" << std::endl;
+  bench_transpose(n, reps);
+  bench_gemm(n / 4, reps);
+}
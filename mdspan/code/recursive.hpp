@@ -0,0 +1,167 @@
+#pragma once
+
+#include <experimental/mdspan>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <execution>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// recursive_split(policy, dims, opt, leaf, operands...): cache-oblivious
+// divide and conquer over a set of mdspans. The iteration space has one
+// dimension per entry of dims, each
+//  - recursive_dim::independent: the two halves of a split touch disjoint
+//    parts of the outputs and may run concurrently,
+//  - recursive_dim::ordered: the halves update the same outputs (the k of a
+//    product) and run one after the other, first half first.
+// Each operand, given as split_along(m, axes, halo), binds every axis of m
+// to a dimension of the space, or to recursive_whole to keep the whole axis.
+// An axis bound to a dimension of extent n has extent n + 2 * halo: for a
+// box [lo, hi) of the space the operand is sliced to [lo, hi + 2 * halo),
+// i.e. the box and its neighbours within halo, as a stencil input needs.
+//
+// The space is halved along its largest dimension until no extent exceeds
+// opt.leaf, then leaf(sub...) is called with the submdspans of the operands
+// for the box. Whatever the sizes of the caches, some level of the recursion
+// has boxes that fit in each of them, without tuning per kernel.
+//
+// With a parallel policy, the halves of a split along an independent
+// dimension are run through std::for_each(policy, ...) while the box has
+// more than opt.parallel_grain points, nested splits included.
+//
+//   // C += A B, C m x n, A m x k, B k x n.
+//   using enum recursive_dim;
+//   recursive_split(std::execution::par, {independent, independent, ordered}, {},
+//                   [](auto c, auto a, auto b) { ... loops over the leaf ... },
+//                   split_along(C, {0, 1}), split_along(A, {0, 2}), split_along(B, {2, 1}));
+//   // B = A^t.
+//   recursive_split({independent, independent}, {}, leaf, split_along(A, {0, 1}),
+//                   split_along(B, {1, 0}));
+//   // 5 point stencil, into the interior of out (a submdspan without the
+//   // boundary), in with the boundary.
+//   recursive_split({independent, independent}, {}, leaf, split_along(out_interior, {0, 1}),
+//                   split_along(in, {0, 1}, 1));
+//
+// The leaf receives strided submdspans, in general layout_stride.
+
+enum class recursive_dim { independent, ordered };
+
+inline constexpr int recursive_whole = -1;
+
+struct recursive_options {
+  // Largest extent of a leaf box.
+  std::size_t leaf = 32;
+  // Boxes with fewer points run sequentially.
+  std::size_t parallel_grain = std::size_t(1) << 16;
+};
+
+template <class M> struct recursive_operand {
+  M m;
+  // Dimension of the space of each axis of m, or recursive_whole.
+  std::array<int, M::rank()> dims;
+  std::size_t halo = 0;
+};
+
+template <class M>
+recursive_operand<M> split_along(M m, const std::array<int, M::rank()> &dims,
+                                 std::size_t halo = 0) {
+  return {m, dims, halo};
+}
+
+namespace impl {
+
+template <std::size_t D> struct recursive_box {
+  std::array<std::size_t, D> lo{}, hi{};
+};
+
+// The extents of the space, from the operands. Every dimension must be bound
+// and all the axes bound to a dimension must agree.
+template <std::size_t D, class... M>
+std::array<std::size_t, D> recursive_extents(const recursive_operand<M> &...ops) {
+  std::array<std::size_t, D> ext;
+  std::array<bool, D> bound{};
+  auto bind = [&](const auto &op) {
+    for (std::size_t a = 0; a < op.dims.size(); ++a) {
+      const int d = op.dims[a];
+      if (d == recursive_whole)
+        continue;
+      if (d < 0 || std::size_t(d) >= D || std::size_t(op.m.extent(a)) < 2 * op.halo)
+        std::terminate();
+      const std::size_t n = std::size_t(op.m.extent(a)) - 2 * op.halo;
+      if (bound[d] && ext[d] != n)
+        std::terminate();
+      ext[d] = n;
+      bound[d] = true;
+    }
+  };
+  (bind(ops), ...);
+  if (!std::all_of(bound.begin(), bound.end(), [](bool b) { return b; }))
+    std::terminate();
+  return ext;
+}
+
+template <std::size_t D, class M, std::size_t... A>
+auto recursive_slice(const recursive_operand<M> &op, const recursive_box<D> &box,
+                     std::index_sequence<A...>) {
+  using I = typename M::index_type;
+  auto slice = [&](std::size_t a) {
+    const int d = op.dims[a];
+    if (d == recursive_whole)
+      return std::pair<I, I>{0, op.m.extent(a)};
+    return std::pair<I, I>{I(box.lo[d]), I(box.hi[d] + 2 * op.halo)};
+  };
+  return std::submdspan(op.m, slice(A)...);
+}
+
+template <class P, std::size_t D, class F, class... M>
+void recursive_run(P &&policy, const std::array<recursive_dim, D> &dims,
+                   const recursive_options &opt, F &f, const recursive_box<D> &box,
+                   const recursive_operand<M> &...ops) {
+  std::size_t d = 0, points = 1;
+  for (std::size_t k = 0; k < D; ++k) {
+    points *= box.hi[k] - box.lo[k];
+    if (box.hi[k] - box.lo[k] > box.hi[d] - box.lo[d])
+      d = k;
+  }
+  if (box.hi[d] - box.lo[d] <= opt.leaf || points == 0) {
+    f(recursive_slice(ops, box, std::make_index_sequence<M::rank()>{})...);
+    return;
+  }
+
+  std::array<recursive_box<D>, 2> halves{box, box};
+  halves[0].hi[d] = halves[1].lo[d] = box.lo[d] + (box.hi[d] - box.lo[d]) / 2;
+  if (dims[d] == recursive_dim::independent && points > opt.parallel_grain &&
+      !std::is_same_v<std::remove_cvref_t<P>, std::execution::sequenced_policy>) {
+    std::for_each(policy, halves.begin(), halves.end(),
+                  [&](const recursive_box<D> &h) { recursive_run(policy, dims, opt, f, h, ops...); });
+  } else {
+    for (const auto &h : halves)
+      recursive_run(policy, dims, opt, f, h, ops...);
+  }
+}
+
+} // namespace impl
+
+template <class P, std::size_t D, class F, class... M>
+  requires std::is_execution_policy_v<std::remove_cvref_t<P>>
+void recursive_split(P &&policy, const recursive_dim (&dims)[D], const recursive_options &opt,
+                     F &&leaf, const recursive_operand<M> &...ops) {
+  static_assert(sizeof...(M) > 0, "recursive_split needs at least one operand");
+  if (opt.leaf == 0)
+    std::terminate();
+  std::array<recursive_dim, D> d;
+  std::copy(dims, dims + D, d.begin());
+  impl::recursive_box<D> box;
+  box.hi = impl::recursive_extents<D>(ops...);
+  impl::recursive_run(policy, d, opt, leaf, box, ops...);
+}
+
+template <std::size_t D, class F, class... M>
+void recursive_split(const recursive_dim (&dims)[D], const recursive_options &opt, F &&leaf,
+                     const recursive_operand<M> &...ops) {
+  recursive_split(std::execution::seq, dims, opt, leaf, ops...);
+}
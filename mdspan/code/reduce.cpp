@@ -0,0 +1,208 @@
+#include "permute_copy.hpp"
+#include "reduce.hpp"
+#include "tiled_layouts.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Checks reduce_axes over axis 1 of a rank-3 in against a loop, for every op.
+template <class M> void check_axis1(M in) {
+  const int n0 = in.extent(0), n1 = in.extent(1), n2 = in.extent(2);
+  std::vector<double> s(n0 * n2), mn(n0 * n2), mx(n0 * n2), nrm(n0 * n2);
+  std::vector<std::int64_t> am(n0 * n2);
+  auto out = [&](auto &v) { return std::mdspan(v.data(), std::dextents<int, 2>{n0, n2}); };
+  reduce_axes(std::execution::par, in, out(s), {1}, reduce_sum);
+  reduce_axes(in, out(mn), {1}, reduce_min);
+  reduce_axes(std::execution::par, in, out(mx), {1}, reduce_max);
+  reduce_axes(in, out(nrm), {1}, reduce_norm2, {.pairwise = true});
+  reduce_axes(std::execution::par, in, out(am), {1}, reduce_argmax);
+  for (int i = 0; i < n0; ++i)
+    for (int k = 0; k < n2; ++k) {
+      double rs = 0, rmin = INFINITY, rmax = -INFINITY, rsq = 0;
+      int rarg = -1;
+      for (int j = 0; j < n1; ++j) {
+        const double x = in[i, j, k];
+        rs += x;
+        rsq += x * x;
+        rmin = std::min(rmin, x);
+        if (x > rmax) {
+          rmax = x;
+          rarg = j;
+        }
+      }
+      assert(s[i * n2 + k] == rs);
+      assert(mn[i * n2 + k] == rmin && mx[i * n2 + k] == rmax);
+      assert(am[i * n2 + k] == rarg);
+      assert(std::abs(nrm[i * n2 + k] - std::sqrt(rsq)) <= 1e-12 * std::sqrt(rsq));
+    }
+}
+
+void test_reduce() {
+  const int n0 = 5, n1 = 301, n2 = 29;
+  std::vector<double> v(n0 * n1 * n2);
+  for (std::size_t i = 0; i < v.size(); ++i)
+    v[i] = double((i * 37) % 101) - 50; // small integers, with ties
+  using ext3 = std::dextents<int, 3>;
+
+  // Along a strided axis (across the contiguous one), then along the
+  // contiguous axis, then element by element.
+  check_axis1(std::mdspan(v.data(), ext3{n0, n1, n2}));
+  check_axis1(std::mdspan<double, ext3, std::layout_left>(v.data(), n0, n1, n2));
+  std::vector<double> t(v.size());
+  auto T = std::mdspan(t.data(), ext3{n0, n2, n1});
+  permute_copy(std::mdspan(v.data(), ext3{n0, n1, n2}), T, {0, 2, 1});
+  check_axis1(std::mdspan(t.data(), std::layout_stride::mapping(ext3{n0, n1, n2},
+                                                                std::array{n1 * n2, 1, n1})));
+
+  // Several axes, all of them, few outputs (split), argmax as a linear index.
+  auto V = std::mdspan(v.data(), ext3{n0, n1, n2});
+  std::vector<double> s1(n1);
+  reduce_axes(std::execution::par, V, std::mdspan(s1.data(), std::dextents<int, 1>{n1}), {0, 2},
+              reduce_sum);
+  double total = 0;
+  for (int j = 0; j < n1; ++j) {
+    double r = 0;
+    for (int i = 0; i < n0; ++i)
+      for (int k = 0; k < n2; ++k)
+        r += V[i, j, k];
+    assert(s1[j] == r);
+    total += r;
+  }
+  double s0 = 0;
+  reduce_axes(std::execution::par, V, std::mdspan(&s0, std::extents<int>{}), {0, 1, 2}, reduce_sum);
+  assert(s0 == total);
+  std::size_t arg = 0;
+  reduce_axes(V, std::mdspan(&arg, std::extents<int>{}), {2, 0, 1}, reduce_argmax);
+  assert(arg == std::size_t(std::max_element(v.begin(), v.end()) - v.begin()));
+  std::vector<std::size_t> argl(n1);
+  reduce_axes(std::mdspan<double, ext3, std::layout_left>(v.data(), n0, n1, n2),
+              std::mdspan(argl.data(), std::dextents<int, 1>{n1}), {0, 2}, reduce_argmax);
+  auto VL = std::mdspan<double, ext3, std::layout_left>(v.data(), n0, n1, n2);
+  for (int j = 0; j < n1; ++j) {
+    std::size_t best = 0;
+    for (std::size_t l = 1; l < std::size_t(n0 * n2); ++l)
+      if (VL[l / n2, j, l % n2] > VL[best / n2, j, best % n2])
+        best = l;
+    assert(argl[j] == best);
+  }
+
+  // Tall columns and long rows: the reduced range is split.
+  const int m = 100000;
+  std::vector<float> w(m * 8);
+  for (std::size_t i = 0; i < w.size(); ++i)
+    w[i] = float(i % 8 + 1);
+  std::vector<float> cols(8), rows(8);
+  reduce_axes(std::execution::par, std::mdspan(w.data(), std::dextents<int, 2>{m, 8}),
+              std::mdspan(cols.data(), std::dextents<int, 1>{8}), {0}, reduce_max);
+  reduce_axes(std::execution::par, std::mdspan(w.data(), std::dextents<int, 2>{8, m}),
+              std::mdspan(rows.data(), std::dextents<int, 1>{8}), {1}, reduce_sum, {.pairwise = true});
+  for (int j = 0; j < 8; ++j) {
+    assert(cols[j] == float(j + 1));
+    assert(rows[j] == float(4.5 * m));
+  }
+
+  // A non-strided layout.
+  using tiled = layout_tiled<8, 8>;
+  using ext2 = std::dextents<int, 2>;
+  std::vector<double> g(tiled::mapping<ext2>(ext2{50, 70}).required_span_size());
+  std::mdspan G(g.data(), tiled::mapping<ext2>(ext2{50, 70}));
+  for (int i = 0; i < 50; ++i)
+    for (int j = 0; j < 70; ++j)
+      G[i, j] = i - j;
+  std::vector<int> ga(50);
+  std::vector<double> gs(70);
+  reduce_axes(std::execution::par, G, std::mdspan(ga.data(), std::dextents<int, 1>{50}), {1},
+              reduce_argmax);
+  reduce_axes(G, std::mdspan(gs.data(), std::dextents<int, 1>{70}), {0}, reduce_sum);
+  for (int i = 0; i < 50; ++i)
+    assert(ga[i] == 0);
+  for (int j = 0; j < 70; ++j)
+    assert(gs[j] == 49 * 25 - 50 * j);
+}
+
+// Rounding error of a float sum of 0.1f, in order and pairwise, along and
+// across the contiguous axis.
+void report_accuracy(int n) {
+  std::vector<float> v(std::size_t(n) * 4, 0.1f);
+  const double exact = double(0.1f) * n;
+  float along[2], across[4][2];
+  for (bool pairwise : {false, true}) {
+    reduce_axes(std::mdspan(v.data(), std::dextents<int, 1>{4 * n}),
+                std::mdspan(&along[pairwise], std::extents<int>{}), {0}, reduce_sum,
+                {.pairwise = pairwise});
+    std::vector<float> c(4);
+    reduce_axes(std::mdspan(v.data(), std::dextents<int, 2>{n, 4}),
+                std::mdspan(c.data(), std::dextents<int, 1>{4}), {0}, reduce_sum, {.pairwise = pairwise});
+    for (int j = 0; j < 4; ++j)
+      across[j][pairwise] = c[j];
+  }
+  std::cout << "relative error of a float sum of " << 4 * n << " (along) and " << n
+            << " (across) elements: along " << std::abs(along[0] - 4 * exact) / (4 * exact)
+            << ", pairwise " << std::abs(along[1] - 4 * exact) / (4 * exact) << "; across "
+            << std::abs(across[0][0] - exact) / exact << ", pairwise "
+            << std::abs(across[0][1] - exact) / exact << std::endl;
+  assert(std::abs(along[1] - 4 * exact) / (4 * exact) < 1e-6);
+  assert(std::abs(across[0][1] - exact) / exact < 1e-6);
+}
+
+// The hand written loops reduce_axes replaces.
+template <class M> void row_sums(M a, float *out) {
+  for (int i = 0; i < a.extent(0); ++i) {
+    float s = 0;
+    for (int j = 0; j < a.extent(1); ++j)
+      s += a[i, j];
+    out[i] = s;
+  }
+}
+
+template <class M> void col_max(M a, float *out) {
+  for (int j = 0; j < a.extent(1); ++j) {
+    float s = -INFINITY;
+    for (int i = 0; i < a.extent(0); ++i)
+      s = std::max(s, a[i, j]);
+    out[j] = s;
+  }
+}
+
+void bench(int n, int reps) {
+  std::vector<float> a(std::size_t(n) * n);
+  for (std::size_t i = 0; i < a.size(); ++i)
+    a[i] = float(i % 1000) * 0.001f;
+  auto A = std::mdspan(a.data(), std::dextents<int, 2>{n, n});
+  std::vector<float> r1(n), r2(n);
+  auto R2 = std::mdspan(r2.data(), std::dextents<int, 1>{n});
+  const double gb = a.size() * sizeof(float) * 1e-9;
+
+  const double rows_loop = best_of(reps, [&] { row_sums(A, r1.data()); });
+  const double rows_seq = best_of(reps, [&] { reduce_axes(A, R2, {1}, reduce_sum); });
+  const double rows_par = best_of(reps, [&] { reduce_axes(std::execution::par, A, R2, {1}, reduce_sum); });
+  for (int i = 0; i < n; ++i)
+    assert(std::abs(r1[i] - r2[i]) <= 1e-3f * std::abs(r1[i]));
+  const double cols_loop = best_of(reps, [&] { col_max(A, r1.data()); });
+  const double cols_seq = best_of(reps, [&] { reduce_axes(A, R2, {0}, reduce_max); });
+  const double cols_par = best_of(reps, [&] { reduce_axes(std::execution::par, A, R2, {0}, reduce_max); });
+  assert(r1 == r2);
+  const double rows_pw = best_of(reps, [&] { reduce_axes(A, R2, {1}, reduce_sum, {.pairwise = true}); });
+
+  std::cout << n << ", " << gb / rows_loop << ", " << gb / rows_seq << ", " << gb / rows_par << ", "
+            << gb / rows_pw << ", " << gb / cols_loop << ", " << gb / cols_seq << ", " << gb / cols_par
+            << std::endl;
+}
+
+// Usage: reduce_example [<n> [<reps>]]
+int main(int argc, char **argv) {
+  test_reduce();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  report_accuracy(1 << 22);
+  std::cout << "n, row sums loop [GB/s], reduce_axes, par, pairwise, column max loop, reduce_axes, par"
+            << std::endl;
+  bench(n, reps);
+}
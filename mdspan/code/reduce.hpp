@@ -0,0 +1,585 @@
+#pragma once
+
+#include "for_each.hpp"
+
+#include <experimental/mdspan>
+#include <experimental/simd>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// reduce_axes(policy, in, out, axes, op) reduces in along the given axes:
+// out has the other axes of in, in order, and each element of out is op over
+// the corresponding slice of in. With in[i, j, k] and axes {1},
+// out[i, k] = op over j of in[i, j, k]. The ops:
+//
+//   reduce_sum, reduce_min, reduce_max, reduce_norm2 (square root of the sum
+//   of the squares), reduce_argmax (the index of the largest element in the
+//   slice, the smallest one on ties; for several axes the row-major index
+//   over them, in increasing axis order; out must be integral).
+//
+// For strided layouts with default accessors the loops follow the memory
+// order of in:
+//  - when in is fastest along a reduced axis (row sums of a layout_right
+//    matrix), each output element reduces contiguous runs with several simd
+//    accumulators; adjacent reduced axes contiguous in memory are collapsed
+//    into longer runs,
+//  - when in is fastest along a kept axis (column sums), tiles of outputs
+//    along that axis are accumulated a simd at a time, row after row of in,
+//  - the items (output elements or tiles) are distributed with the
+//    execution policy; when there are few outputs the reduced range is split
+//    too and the partial results combined.
+// Other layouts or accessors fall back to index order loops.
+//
+// With reduce_options::pairwise, sums (reduce_sum, reduce_norm2) are
+// computed pairwise over blocks of about 256 elements, so that the rounding
+// error grows as O(log n) instead of O(n). min, max and argmax are exact in
+// either mode.
+
+struct reduce_sum_t {};
+struct reduce_min_t {};
+struct reduce_max_t {};
+struct reduce_norm2_t {};
+struct reduce_argmax_t {};
+
+inline constexpr reduce_sum_t reduce_sum{};
+inline constexpr reduce_min_t reduce_min{};
+inline constexpr reduce_max_t reduce_max{};
+inline constexpr reduce_norm2_t reduce_norm2{};
+inline constexpr reduce_argmax_t reduce_argmax{};
+
+struct reduce_options {
+  bool pairwise = false;
+};
+
+namespace impl {
+
+namespace stdx = std::experimental;
+
+// Elements per parallel item.
+inline constexpr std::size_t reduce_grain = 16384;
+// Outputs per item when accumulating across the contiguous axis.
+inline constexpr std::size_t reduce_tile = 512;
+// Leaves of the pairwise summation, in elements, and in rows of a tile.
+inline constexpr std::size_t reduce_pairwise_block = 256;
+inline constexpr std::size_t reduce_pairwise_rows = 64;
+
+template <class T> constexpr T reduce_lowest() {
+  if constexpr (std::numeric_limits<T>::has_infinity)
+    return -std::numeric_limits<T>::infinity();
+  else
+    return std::numeric_limits<T>::lowest();
+}
+
+template <class T> constexpr T reduce_highest() {
+  if constexpr (std::numeric_limits<T>::has_infinity)
+    return std::numeric_limits<T>::infinity();
+  else
+    return std::numeric_limits<T>::max();
+}
+
+// state: the partial result; add(s, x, index) with the linear index of x in
+// the slice, merge(s, t) combines partial results. The v* members are the
+// simd versions, for the non-indexed ops.
+template <class Op, class T> struct reducer;
+
+template <class T> struct reducer<reduce_sum_t, T> {
+  using state = T;
+  static constexpr bool indexed = false;
+  static constexpr bool summation = true;
+  static state init() { return T{}; }
+  static void add(state &s, T x, std::size_t) { s += x; }
+  static void merge(state &s, const state &t) { s += t; }
+  template <class V> static void vadd(V &a, const V &x) { a += x; }
+  template <class V> static state fold(const V &a) { return stdx::reduce(a); }
+  template <class Out> static Out result(const state &s) { return static_cast<Out>(s); }
+};
+
+template <class T> struct reducer<reduce_norm2_t, T> : reducer<reduce_sum_t, T> {
+  using state = T;
+  static void add(state &s, T x, std::size_t) { s += x * x; }
+  template <class V> static void vadd(V &a, const V &x) { a += x * x; }
+  template <class Out> static Out result(const state &s) {
+    using std::sqrt;
+    return static_cast<Out>(sqrt(s));
+  }
+};
+
+template <class T> struct reducer<reduce_min_t, T> {
+  using state = T;
+  static constexpr bool indexed = false;
+  static constexpr bool summation = false;
+  static state init() { return reduce_highest<T>(); }
+  static void add(state &s, T x, std::size_t) { s = x < s ? x : s; }
+  static void merge(state &s, const state &t) { s = t < s ? t : s; }
+  template <class V> static void vadd(V &a, const V &x) { a = stdx::min(a, x); }
+  template <class V> static state fold(const V &a) { return stdx::hmin(a); }
+  template <class Out> static Out result(const state &s) { return static_cast<Out>(s); }
+};
+
+template <class T> struct reducer<reduce_max_t, T> {
+  using state = T;
+  static constexpr bool indexed = false;
+  static constexpr bool summation = false;
+  static state init() { return reduce_lowest<T>(); }
+  static void add(state &s, T x, std::size_t) { s = s < x ? x : s; }
+  static void merge(state &s, const state &t) { s = s < t ? t : s; }
+  template <class V> static void vadd(V &a, const V &x) { a = stdx::max(a, x); }
+  template <class V> static state fold(const V &a) { return stdx::hmax(a); }
+  template <class Out> static Out result(const state &s) { return static_cast<Out>(s); }
+};
+
+template <class T> struct reducer<reduce_argmax_t, T> {
+  struct state {
+    T value;
+    std::size_t index;
+  };
+  static constexpr bool indexed = true;
+  static constexpr bool summation = false;
+  static state init() { return {reduce_lowest<T>(), std::numeric_limits<std::size_t>::max()}; }
+  static void add(state &s, T x, std::size_t i) {
+    if (s.value < x || (x == s.value && i < s.index))
+      s = {x, i};
+  }
+  static void merge(state &s, const state &t) { add(s, t.value, t.index); }
+  template <class Out> static Out result(const state &s) { return static_cast<Out>(s.index); }
+};
+
+template <class Op, class T>
+inline constexpr bool reduce_simd_v = std::is_arithmetic_v<T> && !reducer<Op, T>::indexed;
+
+// s op= p[i stride] for i < len, the linear index of element i being
+// lin + i lin_step.
+template <class Op, class T>
+void reduce_run(typename reducer<Op, T>::state &s, const T *p, std::ptrdiff_t stride, std::size_t len,
+                std::size_t lin, std::size_t lin_step) {
+  using R = reducer<Op, T>;
+  std::size_t i = 0;
+  if constexpr (std::is_arithmetic_v<T>) {
+    using V = stdx::native_simd<T>;
+    constexpr std::size_t W = V::size();
+    if (stride == 1 && len >= 4 * W) {
+      if constexpr (R::indexed) {
+        // The largest value with simd, then its first position.
+        V m(p, stdx::element_aligned);
+        for (i = W; i + W <= len; i += W)
+          m = stdx::max(m, V(p + i, stdx::element_aligned));
+        T best = stdx::hmax(m);
+        for (; i < len; ++i)
+          best = best < p[i] ? p[i] : best;
+        if (best < s.value)
+          return;
+        for (i = 0; i < len && !(p[i] == best); ++i)
+          ;
+        if (i < len) {
+          R::add(s, best, lin + i * lin_step);
+          return;
+        }
+        i = 0; // NaNs: element by element.
+      } else {
+        V a0(R::init()), a1 = a0, a2 = a0, a3 = a0;
+        for (; i + 4 * W <= len; i += 4 * W) {
+          R::vadd(a0, V(p + i, stdx::element_aligned));
+          R::vadd(a1, V(p + i + W, stdx::element_aligned));
+          R::vadd(a2, V(p + i + 2 * W, stdx::element_aligned));
+          R::vadd(a3, V(p + i + 3 * W, stdx::element_aligned));
+        }
+        for (; i + W <= len; i += W)
+          R::vadd(a0, V(p + i, stdx::element_aligned));
+        R::merge(s, R::fold(a0));
+        R::merge(s, R::fold(a1));
+        R::merge(s, R::fold(a2));
+        R::merge(s, R::fold(a3));
+      }
+    }
+  }
+  for (; i < len; ++i)
+    R::add(s, p[static_cast<std::ptrdiff_t>(i) * stride], lin + i * lin_step);
+}
+
+template <class Op, class T>
+typename reducer<Op, T>::state reduce_run_pairwise(const T *p, std::ptrdiff_t stride, std::size_t len,
+                                                   std::size_t lin, std::size_t lin_step) {
+  using R = reducer<Op, T>;
+  if (len <= reduce_pairwise_block) {
+    typename R::state s = R::init();
+    reduce_run<Op>(s, p, stride, len, lin, lin_step);
+    return s;
+  }
+  const std::size_t h = len / 2;
+  typename R::state s = reduce_run_pairwise<Op>(p, stride, h, lin, lin_step);
+  R::merge(s, reduce_run_pairwise<Op>(p + static_cast<std::ptrdiff_t>(h) * stride, stride, len - h,
+                                      lin + h * lin_step, lin_step));
+  return s;
+}
+
+// acc[j] op= q[j stride] for j < len, all with the linear index lin.
+template <class Op, class T>
+void reduce_lanes(typename reducer<Op, T>::state *acc, const T *q, std::ptrdiff_t stride, std::size_t len,
+                  std::size_t lin) {
+  using R = reducer<Op, T>;
+  std::size_t j = 0;
+  if constexpr (reduce_simd_v<Op, T>) {
+    using V = stdx::native_simd<T>;
+    constexpr std::size_t W = V::size();
+    if (stride == 1) {
+      for (; j + W <= len; j += W) {
+        V a(acc + j, stdx::element_aligned);
+        R::vadd(a, V(q + j, stdx::element_aligned));
+        a.copy_to(acc + j, stdx::element_aligned);
+      }
+    }
+  }
+  for (; j < len; ++j)
+    R::add(acc[j], q[static_cast<std::ptrdiff_t>(j) * stride], lin);
+}
+
+template <class Op, class T>
+void reduce_merge_lanes(typename reducer<Op, T>::state *acc, const typename reducer<Op, T>::state *t,
+                        std::size_t len) {
+  for (std::size_t j = 0; j < len; ++j)
+    reducer<Op, T>::merge(acc[j], t[j]);
+}
+
+// The reduced axes of in, by decreasing stride, adjacent ones collapsed
+// when contiguous in memory (and in linear index for argmax).
+template <std::size_t R> struct reduce_nest {
+  std::size_t rank = 0;
+  std::array<std::size_t, R> ext{};
+  std::array<std::ptrdiff_t, R> str{};
+  std::array<std::size_t, R> lin{};
+  std::size_t size = 1;
+
+  // Offset and linear index of the reduced position o over the axes [0, n).
+  std::pair<std::ptrdiff_t, std::size_t> at(std::size_t o, std::size_t n) const {
+    std::ptrdiff_t off = 0;
+    std::size_t l = 0;
+    for (std::size_t k = n; k-- > 0;) {
+      const std::size_t i = o % ext[k];
+      o /= ext[k];
+      off += static_cast<std::ptrdiff_t>(i) * str[k];
+      l += i * lin[k];
+    }
+    return {off, l};
+  }
+};
+
+template <bool Indexed, std::size_t R, std::size_t N>
+reduce_nest<R> make_reduce_nest(const std::array<std::size_t, R> &ext,
+                                const std::array<std::ptrdiff_t, R> &str,
+                                const std::array<std::size_t, N> &axes) {
+  std::array<std::size_t, R> lin{};
+  for (std::size_t a : axes) {
+    lin[a] = 1;
+    for (std::size_t b : axes)
+      if (b > a)
+        lin[a] *= ext[b];
+  }
+  std::array<std::size_t, N> order = axes;
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b) { return std::abs(str[a]) > std::abs(str[b]); });
+
+  reduce_nest<R> nest;
+  for (std::size_t a : order) {
+    nest.size *= ext[a];
+    if (ext[a] == 1)
+      continue;
+    if (nest.rank > 0) {
+      const std::size_t last = nest.rank - 1;
+      if (nest.str[last] == str[a] * std::ptrdiff_t(ext[a]) &&
+          (!Indexed || nest.lin[last] == lin[a] * ext[a])) {
+        nest.ext[last] *= ext[a];
+        nest.str[last] = str[a];
+        nest.lin[last] = lin[a];
+        continue;
+      }
+    }
+    nest.ext[nest.rank] = ext[a];
+    nest.str[nest.rank] = str[a];
+    nest.lin[nest.rank] = lin[a];
+    ++nest.rank;
+  }
+  return nest;
+}
+
+template <class ExecutionPolicy, class Op, class IT, class IE, class IL, class IA, class OT, class OE,
+          class OL, class OA, std::size_t N>
+void reduce_strided(ExecutionPolicy &&policy, std::mdspan<IT, IE, IL, IA> in,
+                    std::mdspan<OT, OE, OL, OA> out, const std::array<std::size_t, N> &axes,
+                    const reduce_options &opt) {
+  using T = std::remove_const_t<IT>;
+  using Red = reducer<Op, T>;
+  using state = typename Red::state;
+  constexpr std::size_t RI = IE::rank();
+  constexpr std::size_t RO = OE::rank();
+  const bool pairwise = Red::summation && opt.pairwise;
+
+  const auto ext = extents_of(in);
+  const auto str = strides_of(in);
+  const reduce_nest<RI> nest = make_reduce_nest<Red::indexed>(ext, str, axes);
+
+  // The kept axes, in the order of out.
+  std::array<std::size_t, RO> kext{};
+  std::array<std::ptrdiff_t, RO> kin{}, kout{};
+  std::size_t n_out = 1;
+  for (std::size_t k = 0, o = 0; k < RI; ++k) {
+    if (std::find(axes.begin(), axes.end(), k) != axes.end())
+      continue;
+    kext[o] = ext[k];
+    kin[o] = str[k];
+    kout[o] = out.stride(o);
+    n_out *= ext[k];
+    ++o;
+  }
+  if (n_out == 0)
+    return;
+
+  // The kept axis along which in is fastest, if faster than the reduced ones.
+  std::size_t a = RO;
+  for (std::size_t k = 0; k < RO; ++k)
+    if (kext[k] > 1 && (a == RO || std::abs(kin[k]) < std::abs(kin[a])))
+      a = k;
+  const bool across = a < RO && (nest.rank == 0 || std::abs(kin[a]) < std::abs(nest.str[nest.rank - 1]));
+
+  const IT *p = in.data_handle();
+  OT *q = out.data_handle();
+  auto out_offsets = [&](std::size_t e, std::size_t skip) {
+    std::pair<std::ptrdiff_t, std::ptrdiff_t> off{0, 0};
+    for (std::size_t k = RO; k-- > 0;) {
+      if (k == skip)
+        continue;
+      const auto i = static_cast<std::ptrdiff_t>(e % kext[k]);
+      e /= kext[k];
+      off.first += i * kin[k];
+      off.second += i * kout[k];
+    }
+    return off;
+  };
+
+  if (!across) {
+    // Each output element reduces runs along the innermost reduced axis, over
+    // a range of the reduced positions: all of them, or a part when there are
+    // few outputs.
+    const std::size_t inner = nest.rank ? nest.ext[nest.rank - 1] : 1;
+    const std::ptrdiff_t inner_str = nest.rank ? nest.str[nest.rank - 1] : 0;
+    const std::size_t inner_lin = nest.rank ? nest.lin[nest.rank - 1] : 0;
+    const std::size_t outer_axes = nest.rank ? nest.rank - 1 : 0;
+    const std::size_t n_split =
+        n_out >= 64 ? 1 : std::clamp<std::size_t>(nest.size / reduce_grain, 1, std::max<std::size_t>(nest.size, 1));
+    std::vector<state> partial(n_split > 1 ? n_out * n_split : 0);
+
+    auto linear = [&](state &s, const IT *base, std::size_t lo, std::size_t hi) {
+      for (std::size_t r = lo; r < hi;) {
+        const std::size_t i0 = r % inner, len = std::min(inner - i0, hi - r);
+        const auto [off, l] = nest.at(r / inner, outer_axes);
+        reduce_run<Op>(s, base + off + static_cast<std::ptrdiff_t>(i0) * inner_str, inner_str, len,
+                       l + i0 * inner_lin, inner_lin);
+        r += len;
+      }
+    };
+    auto range = [&](auto &self, const IT *base, std::size_t lo, std::size_t hi) -> state {
+      state s = Red::init();
+      if (!pairwise || hi - lo <= reduce_pairwise_block) {
+        linear(s, base, lo, hi);
+        return s;
+      }
+      const std::size_t mid = lo + (hi - lo) / 2;
+      s = self(self, base, lo, mid);
+      Red::merge(s, self(self, base, mid, hi));
+      return s;
+    };
+
+    // Output elements grouped so that items hold about reduce_grain elements.
+    const std::size_t per_item =
+        n_split > 1 ? 1 : std::max<std::size_t>(1, reduce_grain / std::max<std::size_t>(nest.size, 1));
+    const std::size_t n_groups = (n_out + per_item - 1) / per_item;
+    std::vector<std::size_t> ids(n_groups * n_split);
+    std::iota(ids.begin(), ids.end(), std::size_t{0});
+    std::for_each(std::forward<ExecutionPolicy>(policy), ids.begin(), ids.end(), [&](std::size_t id) {
+      const std::size_t split = id % n_split;
+      const std::size_t group = id / n_split;
+      const std::size_t lo = nest.size * split / n_split, hi = nest.size * (split + 1) / n_split;
+      for (std::size_t e = group * per_item; e < std::min(n_out, (group + 1) * per_item); ++e) {
+        const auto [ioff, ooff] = out_offsets(e, RO);
+        const state s = range(range, p + ioff, lo, hi);
+        if (n_split > 1)
+          partial[e * n_split + split] = s;
+        else
+          q[ooff] = Red::template result<OT>(s);
+      }
+    });
+    // The partial results are merged pairwise too.
+    for (std::size_t e = 0; n_split > 1 && e < n_out; ++e) {
+      state *part = partial.data() + e * n_split;
+      for (std::size_t w = 1; w < n_split; w *= 2)
+        for (std::size_t t = 0; t + w < n_split; t += 2 * w)
+          Red::merge(part[t], part[t + w]);
+      q[out_offsets(e, RO).second] = Red::template result<OT>(part[0]);
+    }
+    return;
+  }
+
+  // Tiles of outputs along axis a, accumulated over the reduced positions in
+  // memory order. Split along the reduced positions when there are few tiles.
+  const std::size_t n_tiles = (kext[a] + reduce_tile - 1) / reduce_tile;
+  const std::size_t n_rest = n_out / kext[a];
+  const std::size_t n_items = n_tiles * n_rest;
+  const std::size_t n_split =
+      n_items >= 64 ? 1
+                    : std::clamp<std::size_t>(nest.size * std::min(kext[a], reduce_tile) / reduce_grain, 1,
+                                              std::max<std::size_t>(nest.size, 1));
+  std::vector<state> partial(n_split > 1 ? n_items * n_split * reduce_tile : 0);
+
+  std::vector<std::size_t> ids(n_items * n_split);
+  std::iota(ids.begin(), ids.end(), std::size_t{0});
+  std::for_each(std::forward<ExecutionPolicy>(policy), ids.begin(), ids.end(), [&](std::size_t id) {
+    const std::size_t split = id % n_split;
+    const std::size_t item = id / n_split;
+    const std::size_t tile = item % n_tiles;
+    const auto [ioff0, ooff0] = out_offsets(item / n_tiles, a);
+    const std::size_t j0 = tile * reduce_tile, len = std::min(reduce_tile, kext[a] - j0);
+    const IT *base = p + ioff0 + static_cast<std::ptrdiff_t>(j0) * kin[a];
+    const std::size_t lo = nest.size * split / n_split, hi = nest.size * (split + 1) / n_split;
+
+    // One buffer per level of the pairwise recursion.
+    thread_local std::vector<state> buffers;
+    auto buffer = [&](std::size_t level) {
+      if (buffers.size() < (level + 1) * reduce_tile)
+        buffers.resize((level + 1) * reduce_tile);
+      return buffers.data() + level * reduce_tile;
+    };
+    auto rows = [&](auto &self, std::size_t level, std::size_t rlo, std::size_t rhi) -> void {
+      state *acc = buffer(level);
+      if (!pairwise || rhi - rlo <= reduce_pairwise_rows) {
+        std::fill(acc, acc + len, Red::init());
+        for (std::size_t r = rlo; r < rhi; ++r) {
+          const auto [off, l] = nest.at(r, nest.rank);
+          reduce_lanes<Op>(acc, base + off, kin[a], len, l);
+        }
+        return;
+      }
+      const std::size_t mid = rlo + (rhi - rlo) / 2;
+      // The right half only uses the buffers below this level.
+      self(self, level, rlo, mid);
+      self(self, level + 1, mid, rhi);
+      reduce_merge_lanes<Op, T>(buffer(level), buffer(level + 1), len);
+    };
+    rows(rows, 0, lo, hi);
+
+    const state *acc = buffer(0);
+    if (n_split > 1) {
+      std::copy(acc, acc + len, partial.data() + id * reduce_tile);
+    } else {
+      for (std::size_t j = 0; j < len; ++j)
+        q[ooff0 + static_cast<std::ptrdiff_t>(j0 + j) * kout[a]] = Red::template result<OT>(acc[j]);
+    }
+  });
+  if (n_split > 1)
+    for (std::size_t item = 0; item < n_items; ++item) {
+      const std::size_t tile = item % n_tiles;
+      const auto ooff0 = out_offsets(item / n_tiles, a).second;
+      const std::size_t j0 = tile * reduce_tile, len = std::min(reduce_tile, kext[a] - j0);
+      state *acc = partial.data() + item * n_split * reduce_tile;
+      for (std::size_t w = 1; w < n_split; w *= 2)
+        for (std::size_t t = 0; t + w < n_split; t += 2 * w)
+          reduce_merge_lanes<Op, T>(acc + t * reduce_tile, acc + (t + w) * reduce_tile, len);
+      for (std::size_t j = 0; j < len; ++j)
+        q[ooff0 + static_cast<std::ptrdiff_t>(j0 + j) * kout[a]] = Red::template result<OT>(acc[j]);
+    }
+}
+
+} // namespace impl
+
+template <class ExecutionPolicy, class IT, class IE, class IL, class IA, class OT, class OE, class OL,
+          class OA, class Op>
+  requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void reduce_axes(ExecutionPolicy &&policy, std::mdspan<IT, IE, IL, IA> in, std::mdspan<OT, OE, OL, OA> out,
+                 const std::array<std::size_t, IE::rank() - OE::rank()> &axes, Op,
+                 const reduce_options &opt = {}) {
+  constexpr std::size_t RI = IE::rank();
+  constexpr std::size_t RO = OE::rank();
+  using T = typename std::mdspan<IT, IE, IL, IA>::value_type;
+  using Red = impl::reducer<Op, T>;
+  static_assert(!Red::indexed || std::is_integral_v<OT>, "reduce_argmax needs an integral output");
+
+  std::array<bool, RI> reduced{};
+  for (std::size_t a : axes) {
+    if (a >= RI || reduced[a])
+      std::terminate();
+    reduced[a] = true;
+  }
+  for (std::size_t k = 0, o = 0; k < RI; ++k)
+    if (!reduced[k] && static_cast<std::size_t>(out.extent(o++)) != static_cast<std::size_t>(in.extent(k)))
+      std::terminate();
+
+  if constexpr (impl::is_strided_default_v<IL, IE, IA> && impl::is_strided_default_v<OL, OE, OA>) {
+    impl::reduce_strided<ExecutionPolicy, Op>(std::forward<ExecutionPolicy>(policy), in, out, axes, opt);
+  } else {
+    // Index order: each output element reduces its slice, row-major over the
+    // reduced axes.
+    using index_type = typename IE::index_type;
+    using out_index = typename OE::index_type;
+    std::array<std::size_t, RI - RO> sorted = axes;
+    std::sort(sorted.begin(), sorted.end());
+    std::array<std::size_t, RO> kept{};
+    for (std::size_t k = 0, o = 0; k < RI; ++k)
+      if (!reduced[k])
+        kept[o++] = k;
+    std::size_t n_red = 1;
+    for (std::size_t a : sorted)
+      n_red *= in.extent(a);
+    const bool pairwise = Red::summation && opt.pairwise;
+
+    auto slice = [&](auto &self, std::array<index_type, RI> &idx, std::size_t lo,
+                     std::size_t hi) -> typename Red::state {
+      if (pairwise && hi - lo > impl::reduce_pairwise_block) {
+        const std::size_t mid = lo + (hi - lo) / 2;
+        typename Red::state s = self(self, idx, lo, mid);
+        Red::merge(s, self(self, idx, mid, hi));
+        return s;
+      }
+      typename Red::state s = Red::init();
+      for (std::size_t r = lo; r < hi; ++r) {
+        for (std::size_t f = r, t = sorted.size(); t-- > 0;) {
+          idx[sorted[t]] = static_cast<index_type>(f % in.extent(sorted[t]));
+          f /= in.extent(sorted[t]);
+        }
+        Red::add(s, T(in[idx]), r);
+      }
+      return s;
+    };
+
+    const std::size_t n_out = out.size();
+    const std::size_t per_item = std::max<std::size_t>(1, impl::reduce_grain / std::max<std::size_t>(n_red, 1));
+    std::vector<std::size_t> ids((n_out + per_item - 1) / per_item);
+    std::iota(ids.begin(), ids.end(), std::size_t{0});
+    std::for_each(std::forward<ExecutionPolicy>(policy), ids.begin(), ids.end(), [&](std::size_t id) {
+      for (std::size_t e = id * per_item; e < std::min(n_out, (id + 1) * per_item); ++e) {
+        std::array<index_type, RI> idx{};
+        std::array<out_index, RO> oidx{};
+        for (std::size_t f = e, k = RO; k-- > 0;) {
+          oidx[k] = static_cast<out_index>(f % out.extent(k));
+          f /= out.extent(k);
+          idx[kept[k]] = static_cast<index_type>(oidx[k]);
+        }
+        out[oidx] = Red::template result<OT>(slice(slice, idx, 0, n_red));
+      }
+    });
+  }
+}
+
+template <class IT, class IE, class IL, class IA, class OT, class OE, class OL, class OA, class Op>
+void reduce_axes(std::mdspan<IT, IE, IL, IA> in, std::mdspan<OT, OE, OL, OA> out,
+                 const std::array<std::size_t, IE::rank() - OE::rank()> &axes, Op op,
+                 const reduce_options &opt = {}) {
+  reduce_axes(std::execution::seq, in, out, axes, op, opt);
+}
@@ -0,0 +1,117 @@
+#include "scatter.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+void test_scatter() {
+  // Histogram of k % 10 in a 2 x 5 matrix.
+  for (auto s : {scatter_strategy::atomic, scatter_strategy::privatize}) {
+    std::vector<int> h(10, 1);
+    auto H = std::mdspan(h.data(), std::dextents<int, 2>{2, 5});
+    const auto used = scatter_add(
+        std::execution::par, H, 1000,
+        [](std::size_t k, auto add) { add(1, int(k % 10) / 5, int(k % 10) % 5); },
+        {.strategy = s, .chunks = 7});
+    assert(used == s);
+    for (int x : h)
+      assert(x == 101);
+  }
+
+  // Floating point, several contributions per call.
+  for (auto s : {scatter_strategy::atomic, scatter_strategy::privatize}) {
+    std::vector<double> v(8, 0.);
+    auto V = std::mdspan(v.data(), std::dextents<int, 1>{8});
+    scatter_add(V, 64, [](std::size_t k, auto add) {
+      add(0.5, int(k % 8));
+      add(0.25, int((k + 1) % 8));
+    }, {.strategy = s});
+    for (double x : v)
+      assert(x == 6.);
+  }
+
+  // Gaps in the output: always atomic.
+  std::vector<int> g(12, 0);
+  auto G = std::submdspan(std::mdspan(g.data(), std::dextents<int, 2>{3, 4}), std::full_extent,
+                          std::pair{1, 3});
+  const auto used = scatter_add(G, 30, [](std::size_t k, auto add) { add(1, int(k % 3), 1); },
+                                {.strategy = scatter_strategy::privatize});
+  assert(used == scatter_strategy::atomic);
+  assert(g[2] == 10 && g[6] == 10 && g[10] == 10 && g[1] == 0);
+
+  // Automatic: the same number of contributions and the same output, the
+  // choice follows whether the chunks hit the same elements.
+  const std::size_t n = 1 << 16;
+  std::vector<double> big(n, 0.);
+  auto B = std::mdspan(big.data(), std::dextents<std::size_t, 1>{n});
+  auto hot = [](std::size_t k, auto add) { add(1., k % 3); };
+  auto spread = [](std::size_t k, auto add) { add(1., k); };
+  const scatter_options four{.chunks = 4};
+  assert(scatter_add(std::execution::par, B, n, hot, four) == scatter_strategy::privatize);
+  assert(scatter_add(std::execution::par, B, n, spread, four) == scatter_strategy::atomic);
+  // Without a policy, one chunk: nothing to contend with.
+  assert(scatter_add(B, n, hot) == scatter_strategy::atomic);
+  assert(big[0] == 1. + 2 * ((n + 2) / 3) && big[1] == 1. + 2 * ((n + 1) / 3) && big[3] == 1.);
+
+  float f = 1.f;
+  atomic_accumulate(std::atomic_ref<float>(f), 2.f);
+  assert(f == 3.f);
+}
+
+std::string name(scatter_strategy s) {
+  return s == scatter_strategy::atomic ? "atomic" : "privatize";
+}
+
+// count contributions into n elements, all of them falling on `targets`
+// elements spread over the output: the fewer targets, the more collisions.
+void bench(std::size_t n, std::size_t count, std::size_t targets, std::size_t chunks) {
+  std::vector<std::uint32_t> idx(count);
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<std::size_t> dist(0, targets - 1);
+  for (auto &i : idx)
+    i = static_cast<std::uint32_t>(dist(gen) * (n / targets));
+
+  std::vector<double> out(n);
+  auto O = std::mdspan(out.data(), std::dextents<std::size_t, 1>{n});
+  auto f = [&](std::size_t k, auto add) { add(1., idx[k]); };
+
+  std::cout << n << ", " << count << ", " << targets;
+  for (auto s : {scatter_strategy::atomic, scatter_strategy::privatize,
+                 scatter_strategy::automatic}) {
+    std::fill(out.begin(), out.end(), 0.);
+    Timer t;
+    const auto used = scatter_add(std::execution::par, O, count, f, {.strategy = s, .chunks = chunks});
+    const double elapsed = t.elapsed();
+    assert(out[0] > 0);
+    std::cout << ", " << elapsed;
+    if (s == scatter_strategy::automatic)
+      std::cout << ", " << name(used);
+  }
+  std::cout << std::endl;
+}
+
+// Usage: scatter_example [<n> [<count>]]
+int main(int argc, char **argv) {
+  test_scatter();
+
+  const std::size_t n = argc > 1 ? std::atoi(argv[1]) : 1 << 20;
+  const std::size_t count = argc > 2 ? std::atoi(argv[2]) : 1 << 24;
+
+  // At least 4 chunks, for contention to estimate on small machines too.
+  const std::size_t chunks = std::max(4u, std::thread::hardware_concurrency());
+
+  std::cout << "n, contributions, targets, atomic [s], privatize [s], automatic [s], chosen"
+            << std::endl;
+  // Same n and count on every row: the automatic choice follows the
+  // collisions between chunks, privatize on few targets, atomic on
+  // targets = n.
+  for (std::size_t targets = 1; targets < n; targets *= 32)
+    bench(n, count, targets, chunks);
+  bench(n, count, n, chunks);
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <experimental/mdspan>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Accumulation of contributions scattered into a shared output, e.g. the
+// assembly of a finite element matrix or a histogram.
+//
+// atomic_accessor<T> is an accessor whose reference is std::atomic_ref<T>:
+// atomic_accumulate(m[i, j], v) adds v with a relaxed fetch_add for integers
+// and a relaxed compare-exchange loop for floating point types. The elements
+// must be aligned to std::atomic_ref<T>::required_alignment.
+//
+// scatter_add(policy, out, count, f) calls f(k, add) for k in [0, count),
+// f calling add(v, i...) to accumulate v into out[i...], either atomically
+// or into private copies of out reduced at the end:
+//  - atomics cost nothing up front but each contribution is slower, the
+//    more so the more often different threads hit the same element,
+//  - private copies make contributions plain additions but cost a zeroing
+//    and a reduction of one copy of out per chunk of work.
+// scatter_strategy::automatic estimates the contention first, from a
+// sample of the calls of each chunk (see scatter_options): the fraction of
+// the contributions falling on elements that other chunks also hit. It
+// privatizes when the copies fit in max_private_bytes and the expected
+// collisions, count times that fraction, cost more than the copies, a
+// colliding atomic costing collision_cost times the zeroing and reduction
+// of one element of a copy. Many contributions to a few hot elements then
+// privatize however large out is; contributions of different chunks to
+// different elements stay atomic however many there are, and so does a
+// single chunk.
+
+template <class T> struct atomic_accessor {
+  using element_type = T;
+  using reference = std::atomic_ref<T>;
+  using data_handle_type = T *;
+  using offset_policy = atomic_accessor;
+
+  constexpr atomic_accessor() noexcept = default;
+  template <class U>
+    requires std::is_convertible_v<U (*)[], T (*)[]>
+  constexpr atomic_accessor(std::default_accessor<U>) noexcept {}
+
+  constexpr data_handle_type offset(data_handle_type p, std::size_t i) const noexcept {
+    return p + i;
+  }
+
+  reference access(data_handle_type p, std::size_t i) const noexcept {
+    return reference(p[i]);
+  }
+};
+
+template <class T>
+void atomic_accumulate(std::atomic_ref<T> r, T v) noexcept {
+  if constexpr (std::is_integral_v<T>) {
+    r.fetch_add(v, std::memory_order_relaxed);
+  } else {
+    T old = r.load(std::memory_order_relaxed);
+    while (!r.compare_exchange_weak(old, old + v, std::memory_order_relaxed))
+      ;
+  }
+}
+
+// View of m whose elements are accessed atomically.
+template <class T, class E, class L>
+std::mdspan<T, E, L, atomic_accessor<T>> atomic_view(std::mdspan<T, E, L> m) {
+  return {m.data_handle(), m.mapping(), atomic_accessor<T>{}};
+}
+
+enum class scatter_strategy { automatic, atomic, privatize };
+
+struct scatter_options {
+  scatter_strategy strategy = scatter_strategy::automatic;
+  // Number of chunks of [0, count), 0 for the number of hardware threads
+  // (one without an execution policy).
+  std::size_t chunks = 0;
+  std::size_t max_private_bytes = std::size_t{256} << 20;
+  // Calls of f sampled by the automatic strategy, spread over the chunks.
+  // The sampled calls are made a second time with an add that only records
+  // the indices: with automatic, f(k, add) must make the same calls of add
+  // each time and have no other side effects; otherwise give the strategy.
+  std::size_t contention_sample = 4096;
+  double collision_cost = 16;
+};
+
+namespace impl {
+
+// Fraction of the contributions of a sample of the calls f(k, add) of each
+// chunk [first(c), first(c + 1)) falling on elements of out that the
+// sample of another chunk hits too.
+template <class T, class E, class L, class F, class R>
+double scatter_contention(const std::mdspan<T, E, L> &out, std::size_t chunks, R range,
+                          std::size_t sample, F &f) {
+  if (chunks < 2)
+    return 0.;
+  struct use {
+    std::size_t chunk, contributions;
+    bool shared;
+  };
+  std::unordered_map<std::size_t, use> hit;
+  const std::size_t per_chunk = std::max<std::size_t>(1, sample / chunks);
+  for (std::size_t c = 0; c < chunks; ++c) {
+    auto record = [&](T, auto... i) {
+      use &u = hit.try_emplace(static_cast<std::size_t>(out.mapping()(i...)), use{c, 0, false})
+                   .first->second;
+      ++u.contributions;
+      u.shared |= u.chunk != c;
+    };
+    // Evenly spaced over the chunk, what it touches in the whole run.
+    const auto [first, last] = range(c);
+    const std::size_t step = std::max<std::size_t>(1, (last - first) / per_chunk);
+    for (std::size_t k = first; k < last; k += step)
+      f(k, record);
+  }
+  std::size_t contributions = 0, shared = 0;
+  for (const auto &[e, u] : hit) {
+    contributions += u.contributions;
+    shared += u.shared ? u.contributions : 0;
+  }
+  return contributions > 0 ? static_cast<double>(shared) / contributions : 0.;
+}
+
+} // namespace impl
+
+// Returns the strategy used, atomic or privatize.
+template <class ExecutionPolicy, class T, class E, class L, class F>
+  requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+scatter_strategy scatter_add(ExecutionPolicy &&policy, std::mdspan<T, E, L> out,
+                             std::size_t count, F f, scatter_options opt = {}) {
+  const std::size_t chunks =
+      opt.chunks > 0 ? opt.chunks : std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t span = out.mapping().required_span_size();
+
+  scatter_strategy strategy = opt.strategy;
+  // The reduction goes over the whole span of out, i.e. requires no gaps.
+  if (!out.is_exhaustive())
+    strategy = scatter_strategy::atomic;
+  auto range = [&](std::size_t c) {
+    return std::pair{count * c / chunks, count * (c + 1) / chunks};
+  };
+  if (strategy == scatter_strategy::automatic) {
+    const double copies = static_cast<double>(chunks) * span;
+    const double collisions =
+        static_cast<double>(count) *
+        impl::scatter_contention(out, chunks, range, opt.contention_sample, f);
+    strategy = copies * sizeof(T) <= opt.max_private_bytes &&
+                       collisions * opt.collision_cost >= copies
+                   ? scatter_strategy::privatize
+                   : scatter_strategy::atomic;
+  }
+
+  std::vector<std::size_t> ids(chunks);
+  std::iota(ids.begin(), ids.end(), std::size_t{0});
+
+  if (strategy == scatter_strategy::atomic) {
+    auto a = atomic_view(out);
+    std::for_each(policy, ids.begin(), ids.end(), [&](std::size_t c) {
+      auto add = [&](T v, auto... i) { atomic_accumulate(a[i...], v); };
+      for (auto [k, last] = range(c); k < last; ++k)
+        f(k, add);
+    });
+    return strategy;
+  }
+
+  // Not initialized here: zeroed by the thread that uses it, for first
+  // touch placement.
+  const auto priv = std::make_unique_for_overwrite<T[]>(chunks * span);
+  std::for_each(policy, ids.begin(), ids.end(), [&](std::size_t c) {
+    T *p = priv.get() + c * span;
+    std::fill(p, p + span, T{});
+    std::mdspan<T, E, L> m(p, out.mapping());
+    auto add = [&](T v, auto... i) { m[i...] += v; };
+    for (auto [k, last] = range(c); k < last; ++k)
+      f(k, add);
+  });
+
+  // Reduction in blocks of the span of out.
+  constexpr std::size_t block = 4096;
+  std::vector<std::size_t> blocks((span + block - 1) / block);
+  std::iota(blocks.begin(), blocks.end(), std::size_t{0});
+  T *o = out.data_handle();
+  std::for_each(policy, blocks.begin(), blocks.end(), [&](std::size_t b) {
+    const std::size_t first = b * block;
+    const std::size_t last = std::min(span, first + block);
+    for (std::size_t c = 0; c < chunks; ++c) {
+      const T *p = priv.get() + c * span;
+      for (std::size_t i = first; i < last; ++i)
+        o[i] += p[i];
+    }
+  });
+  return strategy;
+}
+
+template <class T, class E, class L, class F>
+scatter_strategy scatter_add(std::mdspan<T, E, L> out, std::size_t count, F f,
+                             scatter_options opt = {}) {
+  if (opt.chunks == 0)
+    opt.chunks = 1;
+  return scatter_add(std::execution::seq, out, count, f, opt);
+}
@@ -0,0 +1,169 @@
+#include "simd_access.hpp"
+#include "tiled_layouts.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+template <class M> void test_view(M m, std::size_t axis, bool contiguous) {
+  using T = typename M::value_type;
+  simd_view sv(m);
+  using V = typename decltype(sv)::simd_type;
+  constexpr int W = V::size();
+  assert(sv.axis() == axis && sv.contiguous() == contiguous);
+
+  // m[i, j] = 100 i + j.
+  for (int i = 0; i < m.extent(0); ++i)
+    for (int j = 0; j < m.extent(1); ++j)
+      m[i, j] = T(100 * i + j);
+
+  const int i = 2;
+  const int row = m.extent(axis);
+  auto at = [&](int k) { return axis == 1 ? std::array{i, k} : std::array{k, i}; };
+  auto value = [&](int k) { return axis == 1 ? T(100 * i + k) : T(100 * k + i); };
+
+  const V v = sv.load(at(1));
+  for (int k = 0; k < W; ++k)
+    assert(v[k] == value(1 + k));
+
+  sv.store(at(0), V(T(-1)));
+  for (int k = 0; k < W; ++k)
+    assert(m[at(k)] == T(-1));
+  // Neighbours are untouched.
+  assert((m[at(W)] == value(W)));
+
+  // The last chunk of the row, partial.
+  const int first = row / W * W;
+  const int n = row - first;
+  assert(n > 0 && first >= W);
+  const V t = sv.load(at(first), std::size_t(n));
+  for (int k = 0; k < W; ++k)
+    assert(t[k] == (k < n ? value(first + k) : T{}));
+
+  sv.store(at(first), t + T(1), std::size_t(n));
+  for (int k = first; k < row; ++k)
+    assert(m[at(k)] == value(k) + T(1));
+  assert((m[at(first - 1)] == (first - 1 < W ? T(-1) : value(first - 1))));
+}
+
+void test_simd_access() {
+  const int m = 5, n = 21;
+  std::vector<float> f(4 * m * n);
+  using ext = std::dextents<int, 2>;
+
+  test_view(std::mdspan(f.data(), ext{m, n}), 1, true);
+  test_view(std::mdspan<float, ext, std::layout_left>(f.data(), n, m), 0, true);
+  // Every other column: gather and scatter.
+  test_view(std::submdspan(std::mdspan(f.data(), ext{m, 2 * n}), std::full_extent,
+                           std::strided_slice{0, 2 * n, 2}),
+            1, false);
+  // A tiled layout, element by element.
+  using tiled = layout_tiled<4, 4>;
+  std::vector<double> d(tiled::mapping<ext>(ext{m, n}).required_span_size());
+  test_view(std::mdspan(d.data(), tiled::mapping<ext>(ext{m, n})), 1, false);
+
+  // Rows padded to the simd width start aligned.
+  using V = stdx::native_simd<float>;
+  alignas(stdx::memory_alignment_v<V>) float buf[4 * 64];
+  using padded = std::experimental::layout_right_padded<std::dynamic_extent>;
+  std::mdspan P(buf, padded::mapping<ext>(ext{3, 13}, V::size()));
+  simd_view sp(P);
+  for (int i = 0; i < 3; ++i) {
+    assert(sp.is_aligned({i, 0}));
+    sp.store({i, 0}, V(float(i)), stdx::vector_aligned);
+    assert(sp.load({i, 0}, stdx::vector_aligned)[0] == float(i));
+  }
+
+  int chunks = 0, tail = 0;
+  simd_chunks<V>(3, 3 + 2 * int(V::size()) + 1, [&](int, auto k) {
+    (k == V::size() ? chunks : tail) += 1;
+  });
+  assert(chunks == 2 && tail == 1);
+}
+
+// The i, l, j loop order of gemm_3 in stdBLAS/examples/gemm.cpp.
+template <class MA, class MB, class MC> void gemm_3(MA A, MB B, MC C) {
+  for (int i = 0; i < C.extent(0); ++i)
+    for (int l = 0; l < A.extent(1); ++l) {
+      const auto ail = A[i, l];
+      for (int j = 0; j < C.extent(1); ++j)
+        C[i, j] += ail * B[l, j];
+    }
+}
+
+template <class MA, class MB, class MC> void gemm_3_simd(MA A, MB B, MC C) {
+  const simd_view b(B), c(C);
+  using V = typename decltype(c)::simd_type;
+  for (int i = 0; i < C.extent(0); ++i)
+    for (int l = 0; l < A.extent(1); ++l) {
+      const V ail(A[i, l]);
+      simd_chunks<V>(0, C.extent(1), [&](int j, auto n) {
+        c.store({i, j}, c.load({i, j}, n) + ail * b.load({l, j}, n), n);
+      });
+    }
+}
+
+// y = a x + y over all the elements, one row at a time.
+template <class M> void axpy(double a, M x, M y) {
+  for (int i = 0; i < x.extent(0); ++i)
+    for (int j = 0; j < x.extent(1); ++j)
+      y[i, j] += a * x[i, j];
+}
+
+template <class M> void axpy_simd(double a, M x, M y) {
+  const simd_view sx(x), sy(y);
+  using V = typename decltype(sx)::simd_type;
+  for (int i = 0; i < x.extent(0); ++i)
+    simd_chunks<V>(0, x.extent(1), [&](int j, auto n) {
+      sy.store({i, j}, sy.load({i, j}, n) + a * sx.load({i, j}, n), n);
+    });
+}
+
+void bench(int n, int reps) {
+  using ext = std::dextents<int, 2>;
+  std::vector<double> a(n * n), b(n * n), c1(n * n, 0.), c2(n * n, 0.);
+  std::iota(a.begin(), a.end(), 0.);
+  std::iota(b.begin(), b.end(), 1.);
+  for (auto &x : a)
+    x = std::fmod(x, 7.);
+  for (auto &x : b)
+    x = std::fmod(x, 5.);
+  std::mdspan A(a.data(), ext{n, n}), B(b.data(), ext{n, n});
+  std::mdspan C1(c1.data(), ext{n, n}), C2(c2.data(), ext{n, n});
+
+  Timer t1;
+  gemm_3(A, B, C1);
+  const double t_gemm = t1.elapsed();
+  Timer t2;
+  gemm_3_simd(A, B, C2);
+  const double t_gemm_simd = t2.elapsed();
+  assert(c1 == c2);
+
+  double t_axpy = 1e30, t_axpy_simd = 1e30;
+  for (int r = 0; r < reps; ++r) {
+    Timer t3;
+    axpy(0.5, A, C1);
+    t_axpy = std::min(t_axpy, t3.elapsed());
+    Timer t4;
+    axpy_simd(0.5, A, C2);
+    t_axpy_simd = std::min(t_axpy_simd, t4.elapsed());
+  }
+  assert(c1 == c2);
+
+  std::cout << n << ", " << t_gemm << ", " << t_gemm_simd << ", " << t_axpy << ", "
+            << t_axpy_simd << std::endl;
+}
+
+// Usage: simd_access_example [<n> [<reps>]]
+int main(int argc, char **argv) {
+  test_simd_access();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 511;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  std::cout << "n, gemm_3 [s], gemm_3 simd [s], axpy [s], axpy simd [s]" << std::endl;
+  bench(n, reps);
+}
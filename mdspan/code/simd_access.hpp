@@ -0,0 +1,205 @@
+#pragma once
+
+#include <experimental/mdspan>
+#include <experimental/simd>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+// simd loads and stores at a multi-index of an mdspan, for kernels that
+// vectorize explicitly rather than through the auto-vectorizer.
+//
+// simd_view<M, V>(m) loads and stores V::size() consecutive elements along
+// the innermost axis of m, the one with unit stride (the last one for
+// layout_right and layout_right_padded, the first one for layout_left and
+// layout_left_padded), starting at a multi-index i:
+//
+//   load(i), store(i, v)            whole chunks, element_aligned by default
+//                                   or vector_aligned if i is known to be,
+//   load(i, n), store(i, v, n)      the first n lanes only, for the tail of
+//                                   a row; the other lanes load as zero and
+//                                   are not stored. With n a
+//                                   std::integral_constant of V::size(), as
+//                                   given by simd_chunks, whole chunks.
+//
+// Depending on m:
+//  - strided layout, default accessor, unit stride: copy_from / copy_to,
+//    lane by lane for partial chunks (a masked store with where() becomes
+//    maskmovdqu on x86 without AVX, a non-temporal store slower than the
+//    scalar loop),
+//  - strided layout, default accessor, no unit stride axis: gather and
+//    scatter with the stride of the last axis,
+//  - other layouts or accessors (tiled layouts, fp16 or quantized
+//    accessors...): element by element through m, along the last axis.
+//
+// simd_chunks<V>(first, last, f) calls f(j, n) over [first, last) in chunks
+// of n = V::size() elements, then once for the tail with n < V::size(). For
+// the whole chunks n is a std::integral_constant, so that a generic f is
+// instantiated separately for them, without the tail handling:
+//
+//   simd_chunks<V>(0, n, [&](int j, auto n) {
+//     y.store({i, j}, y.load({i, j}, n) + a * x.load({i, j}, n), n);
+//   });
+
+namespace stdx = std::experimental;
+
+namespace impl {
+
+template <class F> inline constexpr bool is_simd_flag_v = false;
+template <> inline constexpr bool is_simd_flag_v<stdx::element_aligned_tag> = true;
+template <> inline constexpr bool is_simd_flag_v<stdx::vector_aligned_tag> = true;
+template <std::size_t N>
+inline constexpr bool is_simd_flag_v<stdx::overaligned_tag<N>> = true;
+
+
+// Layouts whose innermost axis always has unit stride, so that the
+// contiguous case needs no test at run time.
+template <class L> inline constexpr bool is_unit_stride_layout_v = false;
+template <> inline constexpr bool is_unit_stride_layout_v<std::layout_right> = true;
+template <> inline constexpr bool is_unit_stride_layout_v<std::layout_left> = true;
+template <std::size_t P>
+inline constexpr bool is_unit_stride_layout_v<std::experimental::layout_right_padded<P>> = true;
+template <std::size_t P>
+inline constexpr bool is_unit_stride_layout_v<std::experimental::layout_left_padded<P>> = true;
+
+} // namespace impl
+
+template <class M>
+using simd_for_t = stdx::native_simd<std::remove_const_t<typename M::element_type>>;
+
+template <class M, class V = simd_for_t<M>> class simd_view {
+public:
+  using mdspan_type = M;
+  using simd_type = V;
+  using mask_type = typename V::mask_type;
+  using value_type = typename V::value_type;
+  using index_type = typename M::index_type;
+  using index_array = std::array<index_type, M::rank()>;
+  static constexpr std::size_t width = V::size();
+  using full_chunk = std::integral_constant<std::size_t, width>;
+
+  static_assert(std::is_same_v<std::remove_const_t<typename M::value_type>, value_type>,
+                "the simd type must hold the value type of the mdspan");
+
+  explicit simd_view(M m) : m_(m), axis_(M::rank() - 1) {
+    if constexpr (direct) {
+      // The innermost axis: unit stride, the last one if several.
+      stride_ = m.stride(axis_);
+      for (std::size_t k = M::rank(); k-- > 0;) {
+        if (m.stride(k) == 1) {
+          axis_ = k;
+          stride_ = 1;
+          break;
+        }
+      }
+    }
+  }
+
+  const M &mdspan() const { return m_; }
+  std::size_t axis() const { return axis_; }
+  index_type extent() const { return m_.extent(axis_); }
+  bool contiguous() const { return direct && (unit_stride || stride_ == 1); }
+
+  bool is_aligned(const index_array &i) const {
+    if constexpr (direct) {
+      return reinterpret_cast<std::uintptr_t>(pointer(i)) % stdx::memory_alignment_v<V> == 0;
+    } else {
+      return false;
+    }
+  }
+
+  template <class Flags = stdx::element_aligned_tag>
+    requires impl::is_simd_flag_v<Flags>
+  V load(const index_array &i, Flags flags = {}) const {
+    if constexpr (direct) {
+      const auto *p = pointer(i);
+      if (unit_stride || stride_ == 1)
+        return V(p, flags);
+      return V([&](auto k) { return p[static_cast<std::ptrdiff_t>(k) * stride_]; });
+    } else {
+      return V([&](auto k) { return value_type(m_[shifted(i, k)]); });
+    }
+  }
+
+  V load(const index_array &i, full_chunk) const { return load(i); }
+
+  V load(const index_array &i, std::size_t n) const {
+    if constexpr (direct) {
+      const auto *p = pointer(i);
+      return V([&](auto k) {
+        return k < n ? p[static_cast<std::ptrdiff_t>(k) * stride_] : value_type{};
+      });
+    } else {
+      return V([&](auto k) { return k < n ? value_type(m_[shifted(i, k)]) : value_type{}; });
+    }
+  }
+
+  template <class Flags = stdx::element_aligned_tag>
+    requires(impl::is_simd_flag_v<Flags> && !std::is_const_v<typename M::element_type>)
+  void store(const index_array &i, const V &v, Flags flags = {}) const {
+    if constexpr (direct) {
+      auto *p = pointer(i);
+      if (unit_stride || stride_ == 1) {
+        v.copy_to(p, flags);
+      } else {
+        for (std::size_t k = 0; k < width; ++k)
+          p[static_cast<std::ptrdiff_t>(k) * stride_] = v[k];
+      }
+    } else {
+      for (std::size_t k = 0; k < width; ++k)
+        m_[shifted(i, k)] = v[k];
+    }
+  }
+
+  void store(const index_array &i, const V &v, full_chunk) const
+    requires(!std::is_const_v<typename M::element_type>)
+  {
+    store(i, v);
+  }
+
+  void store(const index_array &i, const V &v, std::size_t n) const
+    requires(!std::is_const_v<typename M::element_type>)
+  {
+    if constexpr (direct) {
+      auto *p = pointer(i);
+      for (std::size_t k = 0; k < n; ++k)
+        p[static_cast<std::ptrdiff_t>(k) * stride_] = v[k];
+    } else {
+      for (std::size_t k = 0; k < n; ++k)
+        m_[shifted(i, k)] = v[k];
+    }
+  }
+
+private:
+  static constexpr bool direct =
+      M::is_always_strided() &&
+      std::is_same_v<typename M::accessor_type, std::default_accessor<typename M::element_type>>;
+
+  static constexpr bool unit_stride =
+      direct && impl::is_unit_stride_layout_v<typename M::layout_type>;
+
+  M m_;
+  std::size_t axis_;
+  std::ptrdiff_t stride_ = 1;
+
+  auto pointer(const index_array &i) const {
+    return m_.data_handle() + std::apply(m_.mapping(), i);
+  }
+
+  index_array shifted(index_array i, std::size_t k) const {
+    i[axis_] += static_cast<index_type>(k);
+    return i;
+  }
+};
+
+template <class V, class I, class F> void simd_chunks(I first, I last, F &&f) {
+  constexpr I w = static_cast<I>(V::size());
+  I j = first;
+  for (; j + w <= last; j += w)
+    f(j, std::integral_constant<std::size_t, V::size()>{});
+  if (j < last)
+    f(j, static_cast<std::size_t>(last - j));
+}
@@ -0,0 +1,253 @@
+#include "sparse.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using ext1 = std::dextents<std::size_t, 1>;
+using ext2 = std::dextents<std::size_t, 2>;
+
+// A dense m x n matrix with about one nonzero in density, small integers, so
+// that the sums are exact in any order.
+std::vector<double> random_dense(std::size_t m, std::size_t n, int density, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::vector<double> a(m * n, 0.);
+  for (auto &x : a)
+    if (gen() % density == 0)
+      x = double(int(gen() % 9) - 4);
+  return a;
+}
+
+// The 7 point Laplacian on an n x n x n grid, with dofs unknowns per node
+// coupled by dense dofs x dofs blocks.
+csr_matrix<double> laplacian(std::size_t n, std::size_t dofs = 1) {
+  std::vector<std::int32_t> r, c;
+  std::vector<double> v;
+  auto node = [n](std::size_t i, std::size_t j, std::size_t k) { return (i * n + j) * n + k; };
+  auto couple = [&](std::size_t p, std::size_t q, double x) {
+    for (std::size_t a = 0; a < dofs; ++a)
+      for (std::size_t b = 0; b < dofs; ++b) {
+        r.push_back(std::int32_t(p * dofs + a));
+        c.push_back(std::int32_t(q * dofs + b));
+        v.push_back(a == b ? x : 0.125 * x);
+      }
+  };
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      for (std::size_t k = 0; k < n; ++k) {
+        const std::size_t p = node(i, j, k);
+        couple(p, p, 6.);
+        if (i > 0)
+          couple(p, node(i - 1, j, k), -1.);
+        if (i + 1 < n)
+          couple(p, node(i + 1, j, k), -1.);
+        if (j > 0)
+          couple(p, node(i, j - 1, k), -1.);
+        if (j + 1 < n)
+          couple(p, node(i, j + 1, k), -1.);
+        if (k > 0)
+          couple(p, node(i, j, k - 1), -1.);
+        if (k + 1 < n)
+          couple(p, node(i, j, k + 1), -1.);
+      }
+  const std::size_t rows = n * n * n * dofs;
+  return csr_from_coo(rows, rows, r, c, v);
+}
+
+// A random permutation, to destroy the locality of the natural ordering.
+std::vector<std::int32_t> shuffled(std::size_t n) {
+  std::vector<std::int32_t> p(n);
+  std::iota(p.begin(), p.end(), 0);
+  std::shuffle(p.begin(), p.end(), std::mt19937(7));
+  return p;
+}
+
+void test_sparse() {
+  // Duplicates summed, empty rows, columns sorted.
+  const auto C = csr_from_coo<double>(4, 5, {2, 0, 2, 2, 0}, {3, 4, 1, 3, 0}, {1., 2., 3., 4., 5.});
+  assert(C.nnz() == 4);
+  const auto rp = C.row_pointers();
+  const auto ci = C.col_indices();
+  const auto cv = C.values();
+  assert(rp[0] == 0 && rp[1] == 2 && rp[2] == 2 && rp[3] == 4 && rp[4] == 4);
+  assert(ci[0] == 0 && ci[1] == 4 && ci[2] == 1 && ci[3] == 3);
+  assert(cv[0] == 5. && cv[1] == 2. && cv[2] == 3. && cv[3] == 5.);
+
+  bool thrown = false;
+  try {
+    csr_matrix<double>(2, 2, {0, 1, 2}, {1, 0}, {1.});
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // Products against the dense ones, dimensions that are not multiples of
+  // the block size or of the simd width.
+  const std::size_t m = 203, k = 157, n = 13;
+  const auto a = random_dense(m, k, 5, 1);
+  const auto A = std::mdspan(a.data(), ext2{m, k});
+  const auto S = csr_from_dense(A);
+  const auto S3 = bsr_from_csr<3>(S);
+  assert(S3.block_rows() == 68 && S3.block_cols() == 53);
+  for (std::size_t i = 0; i < m; ++i)
+    for (std::size_t j = 0; j < k; ++j)
+      if (a[i * k + j] != 0.) {
+        const std::size_t br = i / 3;
+        std::size_t b = S3.row_pointers()[br];
+        while (std::size_t(S3.col_indices()[b]) != j / 3)
+          ++b;
+        assert((S3.values()[b, i % 3, j % 3] == a[i * k + j]));
+      }
+
+  std::vector<double> x(2 * k);
+  for (std::size_t j = 0; j < x.size(); ++j)
+    x[j] = double(j % 7) - 3;
+  std::vector<double> ref(m, 0.);
+  for (std::size_t i = 0; i < m; ++i)
+    for (std::size_t j = 0; j < k; ++j)
+      ref[i] += a[i * k + j] * x[j];
+  const auto X = std::mdspan(x.data(), ext1{k});
+  for (int par = 0; par < 2; ++par) {
+    std::vector<double> y(m, -1.), y3(m, -1.);
+    const auto Y = std::mdspan(y.data(), ext1{m});
+    const auto Y3 = std::mdspan(y3.data(), ext1{m});
+    if (par) {
+      spmv(std::execution::par, S, X, Y);
+      spmv(std::execution::par, S3, X, Y3);
+    } else {
+      spmv(S, X, Y);
+      spmv(S3, X, Y3);
+    }
+    assert(y == ref && y3 == ref);
+  }
+  // x with a stride: the elements 0, 2, 4... of x.
+  std::vector<double> ys(m, 0.), refs(m, 0.);
+  const auto Xs = std::mdspan(x.data(), std::layout_stride::mapping(ext1{k}, std::array{2}));
+  spmv(S, Xs, std::mdspan(ys.data(), ext1{m}));
+  for (std::size_t i = 0; i < m; ++i)
+    for (std::size_t j = 0; j < k; ++j)
+      refs[i] += a[i * k + j] * x[2 * j];
+  assert(ys == refs);
+
+  // C += A B, C row-major and column-major.
+  const auto b = random_dense(k, n, 2, 3);
+  const auto B = std::mdspan(b.data(), ext2{k, n});
+  std::vector<double> cref(m * n, 1.);
+  for (std::size_t i = 0; i < m; ++i)
+    for (std::size_t l = 0; l < k; ++l)
+      for (std::size_t j = 0; j < n; ++j)
+        cref[i * n + j] += a[i * k + l] * b[l * n + j];
+  for (int par = 0; par < 2; ++par) {
+    std::vector<double> c(m * n, 1.), c3(m * n, 1.), cl(m * n, 1.);
+    const auto Cr = std::mdspan(c.data(), ext2{m, n});
+    const auto C3 = std::mdspan(c3.data(), ext2{m, n});
+    const auto Cl = std::mdspan<double, ext2, std::layout_left>(cl.data(), ext2{m, n});
+    if (par) {
+      spmm(std::execution::par, S, B, Cr);
+      spmm(std::execution::par, S3, B, C3);
+      spmm(std::execution::par, S, B, Cl);
+    } else {
+      spmm(S, B, Cr);
+      spmm(S3, B, C3);
+      spmm(S, B, Cl);
+    }
+    assert(c == cref && c3 == cref);
+    for (std::size_t i = 0; i < m; ++i)
+      for (std::size_t j = 0; j < n; ++j)
+        assert((Cl[i, j] == cref[i * n + j]));
+  }
+
+  // RCM on a scrambled Laplacian: a permutation, the same products up to
+  // the renumbering, a bandwidth back to about that of the grid.
+  const std::size_t g = 9;
+  const auto L = laplacian(g);
+  const auto Ls = permute(L, shuffled(L.rows()));
+  const auto perm = rcm_ordering(Ls);
+  std::vector<std::int32_t> sorted = perm;
+  std::sort(sorted.begin(), sorted.end());
+  for (std::size_t i = 0; i < sorted.size(); ++i)
+    assert(sorted[i] == std::int32_t(i));
+  const auto Lr = permute(Ls, perm);
+  assert(Lr.nnz() == L.nnz() && bandwidth(Ls) > 4 * g * g && bandwidth(Lr) <= 2 * g * g);
+
+  std::vector<double> u(Ls.rows()), us(Ls.rows()), ur(Ls.rows());
+  for (std::size_t i = 0; i < u.size(); ++i)
+    u[i] = double(i % 11);
+  std::vector<double> up(u.size());
+  for (std::size_t i = 0; i < u.size(); ++i)
+    up[i] = u[perm[i]];
+  spmv(Ls, std::mdspan(u.data(), ext1{u.size()}), std::mdspan(us.data(), ext1{u.size()}));
+  spmv(Lr, std::mdspan(up.data(), ext1{u.size()}), std::mdspan(ur.data(), ext1{u.size()}));
+  for (std::size_t i = 0; i < u.size(); ++i)
+    assert(ur[i] == us[perm[i]]);
+
+  // Several components, isolated nodes.
+  const auto D = csr_from_coo<double>(5, 5, {0, 3, 3, 1}, {3, 0, 3, 1}, {1., 1., 1., 1.});
+  auto dp = rcm_ordering(D);
+  std::sort(dp.begin(), dp.end());
+  assert((dp == std::vector<std::int32_t>{0, 1, 2, 3, 4}));
+}
+
+// The bound: a stream reading and writing as many bytes as an SpMV moves,
+// x[i] = a[i] + s * b[i] over arrays of bytes / 3 in total each.
+double stream_bound(std::size_t bytes, int reps) {
+  const std::size_t n = std::max<std::size_t>(1, bytes / (3 * sizeof(double)));
+  std::vector<double> a(n, 1.), b(n, 2.), c(n, 0.);
+  const double t = best_of(reps, [&] {
+    for (std::size_t i = 0; i < n; ++i)
+      c[i] = a[i] + 3. * b[i];
+  });
+  assert(c[n / 2] == 7.);
+  return 3 * n * sizeof(double) * 1e-9 / t;
+}
+
+template <class M> void bench_spmv(const char *name, const M &A, int reps) {
+  std::vector<double> x(A.cols(), 1.), y(A.rows());
+  const auto X = std::mdspan(x.data(), ext1{x.size()});
+  const auto Y = std::mdspan(y.data(), ext1{y.size()});
+  const double seq = best_of(reps, [&] { spmv(A, X, Y); });
+  const double par = best_of(reps, [&] { spmv(std::execution::par, A, X, Y); });
+  // Bytes moved: the arrays of A, x and y once each.
+  const std::size_t bytes = A.bytes() + (x.size() + y.size()) * sizeof(double);
+  std::cout << name << ", " << A.rows() << ", " << bytes * 1e-9 / seq << ", "
+            << bytes * 1e-9 / par << ", " << stream_bound(bytes, reps) << std::endl;
+}
+
+void bench_spmm(const csr_matrix<double> &A, std::size_t n, int reps) {
+  std::vector<double> b(A.cols() * n, 1.), c(A.rows() * n, 0.);
+  const auto B = std::mdspan(b.data(), ext2{A.cols(), n});
+  const auto C = std::mdspan(c.data(), ext2{A.rows(), n});
+  const double seq = best_of(reps, [&] { spmm(A, B, C); });
+  const double par = best_of(reps, [&] { spmm(std::execution::par, A, B, C); });
+  // C is read and written.
+  const std::size_t bytes = A.bytes() + (b.size() + 2 * c.size()) * sizeof(double);
+  std::cout << "csr spmm " << n << " rhs, " << A.rows() << ", " << bytes * 1e-9 / seq << ", "
+            << bytes * 1e-9 / par << ", " << stream_bound(bytes, reps) << std::endl;
+}
+
+// Usage: sparse_example [<grid points per axis> [<reps>]]
+int main(int argc, char **argv) {
+  test_sparse();
+
+  const std::size_t n = argc > 1 ? std::atoi(argv[1]) : 64;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  std::cout << "kernel, rows, seq [GB/s], par, bound" << std::endl;
+  const auto L = laplacian(n);
+  const auto Ls = permute(L, shuffled(L.rows()));
+  bench_spmv("csr natural", L, reps);
+  bench_spmv("csr scrambled", Ls, reps);
+  bench_spmv("csr rcm", permute(Ls, rcm_ordering(Ls)), reps);
+
+  const auto L4 = laplacian(n / 2, 4);
+  bench_spmv("csr 4 dofs", L4, reps);
+  bench_spmv("bsr<4> 4 dofs", bsr_from_csr<4>(L4), reps);
+
+  bench_spmm(L, 8, reps);
+}
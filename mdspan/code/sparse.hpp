@@ -0,0 +1,612 @@
+#pragma once
+
+#include <experimental/mdspan>
+#include <experimental/simd>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Compressed sparse matrices:
+//
+// csr_matrix<T, I>: compressed sparse rows. The nonzeros of row r are
+// values()[k], in column col_indices()[k], for k in
+// [row_pointers()[r], row_pointers()[r + 1]), columns increasing.
+//
+// bsr_matrix<T, B, I>: the same over B x B dense blocks: block row br has
+// the blocks values()[k, :, :] (row-major within the block), in block column
+// col_indices()[k]. Matrices whose extents are not multiples of B have
+// zero padded blocks on the last block row and column. Matrices with small
+// dense couplings (several unknowns per mesh node) store one index per
+// block instead of one per nonzero, and their products use simd along the
+// rows of the blocks.
+//
+// The arrays are exposed as mdspans, values mutable, indices read-only.
+// Built with csr_from_coo (triplets in any order, duplicates summed),
+// csr_from_dense, or bsr_from_csr; the constructors take the arrays and
+// check them, throwing std::invalid_argument.
+//
+// spmv([policy,] A, x, y): y = A x, x and y rank 1 mdspans.
+// spmm([policy,] A, B, C): C += A B, B and C dense k x n and m x n
+// mdspans, the convention of the gemm kernels in stdBLAS/examples.
+// The rows are split into items of about sparse_grain nonzeros, distributed
+// with the execution policy; each row of a csr_matrix is a simd dot product
+// with gathered elements of x. Operands with strided layouts and default
+// accessors are accessed through pointers, other ones through their
+// mappings.
+//
+// rcm_ordering(A) is the reverse Cuthill-McKee ordering of the structure of
+// A + A^t, perm[i] the old index of the new row i, and permute(A, perm) is
+// P A P^t: rows and columns renumbered so that the nonzeros get closer to
+// the diagonal (see bandwidth), and the elements of x a row reads closer to
+// each other.
+
+namespace impl {
+
+namespace stdx = std::experimental;
+
+// Nonzeros per parallel item.
+inline constexpr std::size_t sparse_grain = 16384;
+
+template <class M>
+inline constexpr bool is_direct_v =
+    M::is_always_strided() &&
+    std::is_same_v<typename M::accessor_type, std::default_accessor<typename M::element_type>>;
+
+// Row ranges [split[t], split[t + 1]) of about grain nonzeros each.
+template <class I>
+std::vector<std::size_t> sparse_split(const std::vector<I> &ptr, std::size_t grain) {
+  const std::size_t rows = ptr.size() - 1;
+  const std::size_t nnz = static_cast<std::size_t>(ptr.back());
+  std::vector<std::size_t> split{0};
+  for (std::size_t t = grain; t < nnz; t += grain) {
+    const std::size_t r = std::upper_bound(ptr.begin(), ptr.end(), static_cast<I>(t)) - ptr.begin();
+    if (r < rows && r > split.back())
+      split.push_back(r);
+  }
+  split.push_back(rows);
+  return split;
+}
+
+template <class P, class F> void sparse_for_items(P &&policy, const std::vector<std::size_t> &split, F &&f) {
+  std::vector<std::size_t> ids(split.size() - 1);
+  std::iota(ids.begin(), ids.end(), std::size_t{0});
+  std::for_each(policy, ids.begin(), ids.end(), [&](std::size_t t) { f(split[t], split[t + 1]); });
+}
+
+// x[c] for a rank 1 mdspan, through a pointer when possible.
+template <class X> auto sparse_reader(const X &x) {
+  if constexpr (is_direct_v<X>) {
+    const auto *p = x.data_handle();
+    const std::ptrdiff_t s = x.stride(0);
+    return [p, s](std::size_t c) { return p[static_cast<std::ptrdiff_t>(c) * s]; };
+  } else {
+    return [&x](std::size_t c) { return x[c]; };
+  }
+}
+
+// Checks the row pointers and column indices of a compressed matrix with
+// rows x cols (blocks).
+template <class I>
+void check_compressed(std::size_t rows, std::size_t cols, const std::vector<I> &ptr,
+                      const std::vector<I> &idx, const char *what) {
+  auto fail = [&](const std::string &why) {
+    throw std::invalid_argument(std::string(what) + ": " + why);
+  };
+  if (ptr.size() != rows + 1 || ptr.front() != 0 || std::size_t(ptr.back()) != idx.size())
+    fail("row pointers must have rows + 1 entries, from 0 to the number of nonzeros");
+  if (cols > std::size_t(std::numeric_limits<I>::max()) || idx.size() > std::size_t(std::numeric_limits<I>::max()))
+    fail("the index type is too small");
+  for (std::size_t r = 0; r < rows; ++r) {
+    if (ptr[r + 1] < ptr[r])
+      fail("row pointers must not decrease");
+    for (I k = ptr[r]; k < ptr[r + 1]; ++k)
+      if (idx[k] < 0 || std::size_t(idx[k]) >= cols || (k > ptr[r] && idx[k] <= idx[k - 1]))
+        fail("column indices must be in range and increasing in each row");
+  }
+}
+
+} // namespace impl
+
+template <class T, class I = std::int32_t> class csr_matrix {
+public:
+  using value_type = T;
+  using index_type = I;
+  using vector_extents = std::dextents<std::size_t, 1>;
+
+  csr_matrix() : row_ptr_(1, 0) {}
+
+  csr_matrix(std::size_t rows, std::size_t cols, std::vector<I> row_ptr, std::vector<I> col_idx,
+             std::vector<T> values)
+      : rows_(rows), cols_(cols), row_ptr_(std::move(row_ptr)), col_idx_(std::move(col_idx)),
+        values_(std::move(values)) {
+    impl::check_compressed(rows_, cols_, row_ptr_, col_idx_, "csr_matrix");
+    if (values_.size() != col_idx_.size())
+      throw std::invalid_argument("csr_matrix: one value per column index");
+  }
+
+  std::size_t rows() const { return rows_; }
+  std::size_t cols() const { return cols_; }
+  std::size_t nnz() const { return values_.size(); }
+  // Bytes of the arrays.
+  std::size_t bytes() const {
+    return values_.size() * sizeof(T) + (col_idx_.size() + row_ptr_.size()) * sizeof(I);
+  }
+
+  std::mdspan<T, vector_extents> values() { return {values_.data(), vector_extents{nnz()}}; }
+  std::mdspan<const T, vector_extents> values() const {
+    return {values_.data(), vector_extents{nnz()}};
+  }
+  std::mdspan<const I, vector_extents> col_indices() const {
+    return {col_idx_.data(), vector_extents{nnz()}};
+  }
+  std::mdspan<const I, vector_extents> row_pointers() const {
+    return {row_ptr_.data(), vector_extents{rows_ + 1}};
+  }
+
+  const std::vector<I> &row_pointer_vector() const { return row_ptr_; }
+
+private:
+  std::size_t rows_ = 0, cols_ = 0;
+  std::vector<I> row_ptr_, col_idx_;
+  std::vector<T> values_;
+};
+
+template <class T, std::size_t B, class I = std::int32_t> class bsr_matrix {
+  static_assert(B > 0);
+
+public:
+  using value_type = T;
+  using index_type = I;
+  static constexpr std::size_t block_size = B;
+  using vector_extents = std::dextents<std::size_t, 1>;
+  using block_extents = std::extents<std::size_t, std::dynamic_extent, B, B>;
+
+  bsr_matrix() : row_ptr_(1, 0) {}
+
+  // rows x cols, with (rows + B - 1) / B block rows; values holds B * B
+  // elements per block.
+  bsr_matrix(std::size_t rows, std::size_t cols, std::vector<I> row_ptr, std::vector<I> col_idx,
+             std::vector<T> values)
+      : rows_(rows), cols_(cols), row_ptr_(std::move(row_ptr)), col_idx_(std::move(col_idx)),
+        values_(std::move(values)) {
+    impl::check_compressed(block_rows(), block_cols(), row_ptr_, col_idx_, "bsr_matrix");
+    if (values_.size() != col_idx_.size() * B * B)
+      throw std::invalid_argument("bsr_matrix: B * B values per block");
+  }
+
+  std::size_t rows() const { return rows_; }
+  std::size_t cols() const { return cols_; }
+  std::size_t block_rows() const { return (rows_ + B - 1) / B; }
+  std::size_t block_cols() const { return (cols_ + B - 1) / B; }
+  std::size_t blocks() const { return col_idx_.size(); }
+  std::size_t bytes() const {
+    return values_.size() * sizeof(T) + (col_idx_.size() + row_ptr_.size()) * sizeof(I);
+  }
+
+  std::mdspan<T, block_extents> values() { return {values_.data(), block_extents{blocks()}}; }
+  std::mdspan<const T, block_extents> values() const {
+    return {values_.data(), block_extents{blocks()}};
+  }
+  std::mdspan<const I, vector_extents> col_indices() const {
+    return {col_idx_.data(), vector_extents{blocks()}};
+  }
+  std::mdspan<const I, vector_extents> row_pointers() const {
+    return {row_ptr_.data(), vector_extents{block_rows() + 1}};
+  }
+
+  const std::vector<I> &row_pointer_vector() const { return row_ptr_; }
+
+private:
+  std::size_t rows_ = 0, cols_ = 0;
+  std::vector<I> row_ptr_, col_idx_;
+  std::vector<T> values_;
+};
+
+// Triplets (row[k], col[k], val[k]), in any order, duplicates summed.
+template <class T, class I = std::int32_t>
+csr_matrix<T, I> csr_from_coo(std::size_t rows, std::size_t cols, const std::vector<I> &row,
+                              const std::vector<I> &col, const std::vector<T> &val) {
+  if (row.size() != col.size() || row.size() != val.size())
+    throw std::invalid_argument("csr_from_coo: as many rows, columns and values");
+  std::vector<I> ptr(rows + 1, 0);
+  for (std::size_t k = 0; k < row.size(); ++k) {
+    if (row[k] < 0 || std::size_t(row[k]) >= rows || col[k] < 0 || std::size_t(col[k]) >= cols)
+      throw std::invalid_argument("csr_from_coo: index out of range");
+    ++ptr[row[k] + 1];
+  }
+  std::partial_sum(ptr.begin(), ptr.end(), ptr.begin());
+  std::vector<std::size_t> order(row.size());
+  std::vector<I> next(ptr.begin(), ptr.end() - 1);
+  for (std::size_t k = 0; k < row.size(); ++k)
+    order[next[row[k]]++] = k;
+
+  std::vector<I> out_ptr(rows + 1, 0), out_col;
+  std::vector<T> out_val;
+  out_col.reserve(row.size());
+  out_val.reserve(row.size());
+  for (std::size_t r = 0; r < rows; ++r) {
+    std::sort(order.begin() + ptr[r], order.begin() + ptr[r + 1],
+              [&](std::size_t a, std::size_t b) { return col[a] < col[b]; });
+    for (I k = ptr[r]; k < ptr[r + 1]; ++k) {
+      const std::size_t e = order[k];
+      if (std::size_t(out_col.size()) > std::size_t(out_ptr[r]) && out_col.back() == col[e]) {
+        out_val.back() += val[e];
+      } else {
+        out_col.push_back(col[e]);
+        out_val.push_back(val[e]);
+      }
+    }
+    out_ptr[r + 1] = static_cast<I>(out_col.size());
+  }
+  return {rows, cols, std::move(out_ptr), std::move(out_col), std::move(out_val)};
+}
+
+// The nonzeros of a rank 2 mdspan.
+template <class I = std::int32_t, class T, class E, class L, class A>
+csr_matrix<std::remove_const_t<T>, I> csr_from_dense(std::mdspan<T, E, L, A> m) {
+  static_assert(E::rank() == 2);
+  std::vector<I> ptr{0}, col;
+  std::vector<std::remove_const_t<T>> val;
+  for (std::size_t i = 0; i < std::size_t(m.extent(0)); ++i) {
+    for (std::size_t j = 0; j < std::size_t(m.extent(1)); ++j) {
+      const std::remove_const_t<T> x = m[i, j];
+      if (x != std::remove_const_t<T>{}) {
+        col.push_back(static_cast<I>(j));
+        val.push_back(x);
+      }
+    }
+    ptr.push_back(static_cast<I>(col.size()));
+  }
+  return {std::size_t(m.extent(0)), std::size_t(m.extent(1)), std::move(ptr), std::move(col),
+          std::move(val)};
+}
+
+// Groups the nonzeros of A into B x B blocks.
+template <std::size_t B, class T, class I> bsr_matrix<T, B, I> bsr_from_csr(const csr_matrix<T, I> &A) {
+  const std::size_t brows = (A.rows() + B - 1) / B, bcols = (A.cols() + B - 1) / B;
+  const auto ptr = A.row_pointers();
+  const auto col = A.col_indices();
+  const auto val = A.values();
+  std::vector<I> bptr{0}, bcol;
+  std::vector<T> bval;
+  // Position of block column bc in the current block row, or -1.
+  std::vector<std::ptrdiff_t> slot(bcols, -1);
+  for (std::size_t br = 0; br < brows; ++br) {
+    const std::size_t r0 = br * B, r1 = std::min(A.rows(), r0 + B);
+    const std::size_t first = bcol.size();
+    for (std::size_t r = r0; r < r1; ++r)
+      for (I k = ptr[r]; k < ptr[r + 1]; ++k)
+        if (slot[col[k] / B] < 0) {
+          slot[col[k] / B] = 0;
+          bcol.push_back(static_cast<I>(col[k] / B));
+        }
+    std::sort(bcol.begin() + first, bcol.end());
+    for (std::size_t b = first; b < bcol.size(); ++b)
+      slot[bcol[b]] = std::ptrdiff_t(b);
+    bval.resize(bcol.size() * B * B, T{});
+    for (std::size_t r = r0; r < r1; ++r)
+      for (I k = ptr[r]; k < ptr[r + 1]; ++k)
+        bval[(slot[col[k] / B] * B + (r - r0)) * B + col[k] % B] = val[k];
+    for (std::size_t b = first; b < bcol.size(); ++b)
+      slot[bcol[b]] = -1;
+    bptr.push_back(static_cast<I>(bcol.size()));
+  }
+  return {A.rows(), A.cols(), std::move(bptr), std::move(bcol), std::move(bval)};
+}
+
+namespace impl {
+
+template <class T, class I, class X>
+T csr_row_dot(const T *v, const I *ci, std::size_t lo, std::size_t hi, const X &x) {
+  using V = stdx::native_simd<T>;
+  constexpr std::size_t W = V::size();
+  std::size_t k = lo;
+  T s{};
+  if (hi - lo >= W) {
+    V acc = 0;
+    for (; k + W <= hi; k += W)
+      acc += V(v + k, stdx::element_aligned) * V([&](auto l) { return x(std::size_t(ci[k + l])); });
+    s = stdx::reduce(acc);
+  }
+  for (; k < hi; ++k)
+    s += v[k] * x(std::size_t(ci[k]));
+  return s;
+}
+
+// c[j] += a * b[j] for j in [0, n).
+template <class T> void sparse_axpy(T a, const T *b, T *c, std::size_t n) {
+  using V = stdx::native_simd<T>;
+  constexpr std::size_t W = V::size();
+  std::size_t j = 0;
+  for (; j + W <= n; j += W) {
+    V cj(c + j, stdx::element_aligned);
+    cj += a * V(b + j, stdx::element_aligned);
+    cj.copy_to(c + j, stdx::element_aligned);
+  }
+  for (; j < n; ++j)
+    c[j] += a * b[j];
+}
+
+// C[r, :] += a * B[l, :] for the pairs (r, l, a) given by each(f), over
+// column panels of C that stay in L1 while the row is updated.
+template <class MB, class MC, class Each>
+void sparse_rows_update(const MB &B, const MC &C, Each &&each) {
+  using T = typename MC::value_type;
+  const std::size_t n = C.extent(1);
+  if constexpr (is_direct_v<MB> && is_direct_v<MC>) {
+    if (B.stride(1) == 1 && C.stride(1) == 1) {
+      constexpr std::size_t panel = 512;
+      for (std::size_t j0 = 0; j0 < n; j0 += panel) {
+        const std::size_t nj = std::min(panel, n - j0);
+        each([&](std::size_t r, std::size_t l, T a) {
+          sparse_axpy(a, B.data_handle() + l * B.stride(0) + j0,
+                      C.data_handle() + r * C.stride(0) + j0, nj);
+        });
+      }
+      return;
+    }
+  }
+  each([&](std::size_t r, std::size_t l, T a) {
+    for (std::size_t j = 0; j < n; ++j)
+      C[r, j] += a * B[l, j];
+  });
+}
+
+} // namespace impl
+
+template <class P, class T, class I, class X, class EX, class LX, class AX, class Y, class EY,
+          class LY, class AY>
+  requires std::is_execution_policy_v<std::remove_cvref_t<P>>
+void spmv(P &&policy, const csr_matrix<T, I> &A, std::mdspan<X, EX, LX, AX> x,
+          std::mdspan<Y, EY, LY, AY> y) {
+  static_assert(EX::rank() == 1 && EY::rank() == 1);
+  if (std::size_t(x.extent(0)) != A.cols() || std::size_t(y.extent(0)) != A.rows())
+    std::terminate();
+  const T *v = A.values().data_handle();
+  const I *ci = A.col_indices().data_handle();
+  const I *rp = A.row_pointers().data_handle();
+  const auto xr = impl::sparse_reader(x);
+  impl::sparse_for_items(policy, impl::sparse_split(A.row_pointer_vector(), impl::sparse_grain),
+                         [&](std::size_t r0, std::size_t r1) {
+                           for (std::size_t r = r0; r < r1; ++r)
+                             y[r] = impl::csr_row_dot(v, ci, rp[r], rp[r + 1], xr);
+                         });
+}
+
+template <class P, class T, std::size_t B, class I, class X, class EX, class LX, class AX, class Y,
+          class EY, class LY, class AY>
+  requires std::is_execution_policy_v<std::remove_cvref_t<P>>
+void spmv(P &&policy, const bsr_matrix<T, B, I> &A, std::mdspan<X, EX, LX, AX> x,
+          std::mdspan<Y, EY, LY, AY> y) {
+  static_assert(EX::rank() == 1 && EY::rank() == 1);
+  if (std::size_t(x.extent(0)) != A.cols() || std::size_t(y.extent(0)) != A.rows())
+    std::terminate();
+  using V = impl::stdx::fixed_size_simd<T, B>;
+  const T *v = A.values().data_handle();
+  const I *ci = A.col_indices().data_handle();
+  const I *rp = A.row_pointers().data_handle();
+  const std::size_t cols = A.cols(), rows = A.rows();
+  const auto xr = impl::sparse_reader(x);
+  impl::sparse_for_items(
+      policy, impl::sparse_split(A.row_pointer_vector(), impl::sparse_grain / (B * B)),
+      [&](std::size_t b0, std::size_t b1) {
+        for (std::size_t br = b0; br < b1; ++br) {
+          std::array<V, B> acc;
+          acc.fill(V(T{}));
+          for (I k = rp[br]; k < rp[br + 1]; ++k) {
+            const std::size_t c0 = std::size_t(ci[k]) * B;
+            const V xs = c0 + B <= cols
+                             ? V([&](auto c) { return xr(c0 + c); })
+                             : V([&](auto c) { return c0 + c < cols ? xr(c0 + c) : T{}; });
+            const T *blk = v + std::size_t(k) * B * B;
+            for (std::size_t r = 0; r < B; ++r)
+              acc[r] += V(blk + r * B, impl::stdx::element_aligned) * xs;
+          }
+          for (std::size_t r = 0; r < B && br * B + r < rows; ++r)
+            y[br * B + r] = impl::stdx::reduce(acc[r]);
+        }
+      });
+}
+
+template <class P, class T, class I, class MB, class EB, class LB, class AB, class MC, class EC,
+          class LC, class AC>
+  requires std::is_execution_policy_v<std::remove_cvref_t<P>>
+void spmm(P &&policy, const csr_matrix<T, I> &A, std::mdspan<MB, EB, LB, AB> B,
+          std::mdspan<MC, EC, LC, AC> C) {
+  static_assert(EB::rank() == 2 && EC::rank() == 2);
+  if (A.cols() != std::size_t(B.extent(0)) || A.rows() != std::size_t(C.extent(0)) ||
+      B.extent(1) != C.extent(1))
+    std::terminate();
+  const T *v = A.values().data_handle();
+  const I *ci = A.col_indices().data_handle();
+  const I *rp = A.row_pointers().data_handle();
+  const std::size_t grain = std::max<std::size_t>(1, impl::sparse_grain / std::max<std::size_t>(1, C.extent(1)));
+  impl::sparse_for_items(policy, impl::sparse_split(A.row_pointer_vector(), grain),
+                         [&](std::size_t r0, std::size_t r1) {
+                           impl::sparse_rows_update(B, C, [&](auto &&update) {
+                             for (std::size_t r = r0; r < r1; ++r)
+                               for (I k = rp[r]; k < rp[r + 1]; ++k)
+                                 update(r, std::size_t(ci[k]), v[k]);
+                           });
+                         });
+}
+
+template <class P, class T, std::size_t BS, class I, class MB, class EB, class LB, class AB,
+          class MC, class EC, class LC, class AC>
+  requires std::is_execution_policy_v<std::remove_cvref_t<P>>
+void spmm(P &&policy, const bsr_matrix<T, BS, I> &A, std::mdspan<MB, EB, LB, AB> B,
+          std::mdspan<MC, EC, LC, AC> C) {
+  static_assert(EB::rank() == 2 && EC::rank() == 2);
+  if (A.cols() != std::size_t(B.extent(0)) || A.rows() != std::size_t(C.extent(0)) ||
+      B.extent(1) != C.extent(1))
+    std::terminate();
+  const T *v = A.values().data_handle();
+  const I *ci = A.col_indices().data_handle();
+  const I *rp = A.row_pointers().data_handle();
+  const std::size_t rows = A.rows(), cols = A.cols();
+  const std::size_t grain =
+      std::max<std::size_t>(1, impl::sparse_grain / (BS * BS * std::max<std::size_t>(1, C.extent(1))));
+  impl::sparse_for_items(policy, impl::sparse_split(A.row_pointer_vector(), grain),
+                         [&](std::size_t b0, std::size_t b1) {
+                           impl::sparse_rows_update(B, C, [&](auto &&update) {
+                             for (std::size_t br = b0; br < b1; ++br)
+                               for (I k = rp[br]; k < rp[br + 1]; ++k)
+                                 for (std::size_t r = 0; r < BS && br * BS + r < rows; ++r)
+                                   for (std::size_t c = 0; c < BS && ci[k] * BS + c < cols; ++c)
+                                     if (const T a = v[(std::size_t(k) * BS + r) * BS + c]; a != T{})
+                                       update(br * BS + r, std::size_t(ci[k]) * BS + c, a);
+                           });
+                         });
+}
+
+template <class M, class X, class Y> void spmv(const M &A, X x, Y y) {
+  spmv(std::execution::seq, A, x, y);
+}
+
+template <class M, class MB, class MC> void spmm(const M &A, MB B, MC C) {
+  spmm(std::execution::seq, A, B, C);
+}
+
+// Largest |i - j| over the nonzeros.
+template <class T, class I> std::size_t bandwidth(const csr_matrix<T, I> &A) {
+  const auto ptr = A.row_pointers();
+  const auto col = A.col_indices();
+  std::size_t b = 0;
+  for (std::size_t r = 0; r < A.rows(); ++r)
+    for (I k = ptr[r]; k < ptr[r + 1]; ++k)
+      b = std::max(b, r > std::size_t(col[k]) ? r - col[k] : col[k] - r);
+  return b;
+}
+
+template <class T, class I> std::vector<I> rcm_ordering(const csr_matrix<T, I> &A) {
+  if (A.rows() != A.cols())
+    throw std::invalid_argument("rcm_ordering: the matrix must be square");
+  const std::size_t n = A.rows();
+  const auto ptr = A.row_pointers();
+  const auto col = A.col_indices();
+
+  // The graph of A + A^t, without the diagonal.
+  std::vector<I> gptr(n + 1, 0);
+  for (std::size_t r = 0; r < n; ++r)
+    for (I k = ptr[r]; k < ptr[r + 1]; ++k)
+      if (std::size_t(col[k]) != r) {
+        ++gptr[r + 1];
+        ++gptr[col[k] + 1];
+      }
+  std::partial_sum(gptr.begin(), gptr.end(), gptr.begin());
+  std::vector<I> adj(gptr[n]), next(gptr.begin(), gptr.end() - 1);
+  for (std::size_t r = 0; r < n; ++r)
+    for (I k = ptr[r]; k < ptr[r + 1]; ++k)
+      if (std::size_t(col[k]) != r) {
+        adj[next[r]++] = col[k];
+        adj[next[col[k]]++] = static_cast<I>(r);
+      }
+  std::vector<I> degree(n);
+  for (std::size_t r = 0; r < n; ++r) {
+    std::sort(adj.begin() + gptr[r], adj.begin() + gptr[r + 1]);
+    const auto end = std::unique(adj.begin() + gptr[r], adj.begin() + gptr[r + 1]);
+    degree[r] = static_cast<I>(end - (adj.begin() + gptr[r]));
+  }
+
+  std::vector<I> order, scratch;
+  order.reserve(n);
+  std::vector<char> visited(n, 0);
+  std::vector<I> level(n, -1);
+  // Breadth first search from s over the unvisited nodes, the neighbours of
+  // a node by increasing degree, appended to out. Returns the depth and the
+  // lowest degree node of the last level.
+  auto bfs = [&](I s, std::vector<I> &out) {
+    const std::size_t first = out.size();
+    out.push_back(s);
+    level[s] = 0;
+    for (std::size_t q = first; q < out.size(); ++q) {
+      const I u = out[q];
+      const std::size_t begin = out.size();
+      for (I k = gptr[u]; k < gptr[u] + degree[u]; ++k)
+        if (!visited[adj[k]] && level[adj[k]] < 0) {
+          level[adj[k]] = level[u] + 1;
+          out.push_back(adj[k]);
+        }
+      std::stable_sort(out.begin() + begin, out.end(),
+                       [&](I a, I b) { return degree[a] < degree[b]; });
+    }
+    const I depth = level[out.back()];
+    I end = out.back();
+    for (std::size_t q = out.size(); q-- > first && level[out[q]] == depth;)
+      if (degree[out[q]] < degree[end])
+        end = out[q];
+    for (std::size_t q = first; q < out.size(); ++q)
+      level[out[q]] = -1;
+    return std::pair{depth, end};
+  };
+
+  for (std::size_t s0 = 0; s0 < n; ++s0) {
+    if (visited[s0])
+      continue;
+    // A pseudo-peripheral start node: restart from the end of the deepest
+    // search while the depth increases.
+    I s = static_cast<I>(s0);
+    scratch.clear();
+    auto [depth, end] = bfs(s, scratch);
+    for (;;) {
+      scratch.clear();
+      const auto [d, e] = bfs(end, scratch);
+      if (d <= depth)
+        break;
+      s = end;
+      depth = d;
+      end = e;
+    }
+    const std::size_t first = order.size();
+    bfs(s, order);
+    for (std::size_t q = first; q < order.size(); ++q)
+      visited[order[q]] = 1;
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+// P A P^t: row and column perm[i] of A become row and column i.
+template <class T, class I>
+csr_matrix<T, I> permute(const csr_matrix<T, I> &A, const std::vector<I> &perm) {
+  const std::size_t n = A.rows();
+  if (A.cols() != n || perm.size() != n)
+    throw std::invalid_argument("permute: a square matrix and a permutation of its rows");
+  std::vector<I> inv(n, -1);
+  for (std::size_t i = 0; i < n; ++i) {
+    if (perm[i] < 0 || std::size_t(perm[i]) >= n || inv[perm[i]] >= 0)
+      throw std::invalid_argument("permute: not a permutation");
+    inv[perm[i]] = static_cast<I>(i);
+  }
+  const auto ptr = A.row_pointers();
+  const auto col = A.col_indices();
+  const auto val = A.values();
+  std::vector<I> out_ptr{0}, out_col;
+  std::vector<T> out_val;
+  out_col.reserve(A.nnz());
+  out_val.reserve(A.nnz());
+  std::vector<std::pair<I, T>> row;
+  for (std::size_t i = 0; i < n; ++i) {
+    row.clear();
+    for (I k = ptr[perm[i]]; k < ptr[perm[i] + 1]; ++k)
+      row.emplace_back(inv[col[k]], val[k]);
+    std::sort(row.begin(), row.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    for (const auto &[c, x] : row) {
+      out_col.push_back(c);
+      out_val.push_back(x);
+    }
+    out_ptr.push_back(static_cast<I>(out_col.size()));
+  }
+  return {n, n, std::move(out_ptr), std::move(out_col), std::move(out_val)};
+}
@@ -0,0 +1,153 @@
+#include "stencil.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// One sweep of st over the interior, element by element.
+template <class T, std::size_t R, class M>
+void reference_sweep(const stencil<T, R> &st, M in, M out) {
+  const int r = st.radius();
+  std::array<int, R> i;
+  auto sweep = [&](auto &self, std::size_t d) -> void {
+    if (d == R) {
+      T acc{};
+      for (const auto &p : st.points) {
+        std::array<int, R> k;
+        for (std::size_t e = 0; e < R; ++e)
+          k[e] = i[e] + p.offset[e];
+        acc += p.coefficient * in[k];
+      }
+      out[i] = acc;
+      return;
+    }
+    for (i[d] = r; i[d] < static_cast<int>(in.extent(d)) - r; ++i[d])
+      self(self, d + 1);
+  };
+  sweep(sweep, 0);
+}
+
+template <class M> void fill(M m, int seed) {
+  for (int i = 0; i < m.extent(0); ++i)
+    for (int j = 0; j < m.extent(1); ++j)
+      m[i, j] = std::sin(0.1 * i + 0.37 * j + seed);
+}
+
+template <class M1, class M2> double max_diff(M1 a, M2 b) {
+  double d = 0;
+  for (int i = 0; i < a.extent(0); ++i)
+    for (int j = 0; j < a.extent(1); ++j)
+      d = std::max(d, std::abs(a[i, j] - b[i, j]));
+  return d;
+}
+
+template <class Layout, class... Args> void test_2d(Args... pad) {
+  const int m = 37, n = 53;
+  using ext = std::dextents<int, 2>;
+  std::vector<double> a(4 * m * n), b(4 * m * n), c(4 * m * n);
+  typename Layout::template mapping<ext> map(ext{m, n}, pad...);
+  std::mdspan A(a.data(), map), B(b.data(), map), C(c.data(), map);
+  fill(A, 0);
+
+  // Radius 2, asymmetric coefficients.
+  stencil<double, 2> st{{{{0, 0}, 0.5}, {{-2, 0}, 0.1}, {{1, 0}, 0.2}, {{0, 2}, -0.3},
+                         {{0, -1}, 0.4}, {{1, 1}, 0.05}}};
+  assert(st.radius() == 2);
+
+  reference_sweep(st, A, C);
+  apply_stencil(std::execution::par, st, A, B, {.tile = 5});
+  assert(max_diff(B, C) < 1e-14);
+
+  // The same stencil as a functor.
+  std::fill(b.begin(), b.end(), 0.);
+  auto f = make_stencil<2>(2, [](auto in, int i, int j) {
+    return 0.5 * in[i, j] + 0.1 * in[i - 2, j] + 0.2 * in[i + 1, j] - 0.3 * in[i, j + 2] +
+           0.4 * in[i, j - 1] + 0.05 * in[i + 1, j + 1];
+  });
+  apply_stencil(f, A, B);
+  assert(max_diff(B, C) < 1e-14);
+  assert((B[0, 0] == 0. && B[m - 1, n - 2] == 0.));
+}
+
+void test_steps_3d(int levels, int tile) {
+  const int n0 = 23, n1 = 31, n2 = 19, steps = 7;
+  std::vector<double> a(n0 * n1 * n2), b(a.size()), x(a.size()), y(a.size());
+  using ext = std::dextents<int, 3>;
+  std::mdspan A(a.data(), ext{n0, n1, n2}), B(b.data(), ext{n0, n1, n2});
+  std::mdspan X(x.data(), ext{n0, n1, n2}), Y(y.data(), ext{n0, n1, n2});
+  for (std::size_t k = 0; k < a.size(); ++k)
+    a[k] = b[k] = x[k] = y[k] = std::cos(0.01 * k * k);
+
+  const auto st = star_stencil<double, 3>(0.4, 0.1);
+  for (int s = 0; s < steps; ++s) {
+    reference_sweep(st, X, Y);
+    std::swap(X, Y);
+  }
+
+  auto res = stencil_steps(std::execution::par, st, A, B, steps,
+                           {.time_block = levels, .tile = tile});
+  assert(res.data_handle() == (steps % 2 ? b.data() : a.data()));
+  for (int i = 0; i < n0; ++i)
+    for (int j = 0; j < n1; ++j)
+      for (int k = 0; k < n2; ++k)
+        assert(std::abs(res[i, j, k] - X[i, j, k]) < 1e-14);
+}
+
+// 7-point Jacobi in an n^3 cube: plain loop, apply_stencil, and stencil_steps
+// with increasing time blocks. Reports giga lattice updates per second.
+void bench(int n, int steps) {
+  using ext = std::dextents<int, 3>;
+  std::vector<double> a(std::size_t(n) * n * n), b(a.size());
+  std::mdspan A(a.data(), ext{n, n, n}), B(b.data(), ext{n, n, n});
+  const double updates = double(n - 2) * (n - 2) * (n - 2) * steps * 1e-9;
+  const auto st = star_stencil<double, 3>(0., 1. / 6.);
+  auto reset = [&] {
+    for (std::size_t k = 0; k < a.size(); ++k)
+      a[k] = b[k] = double(k % 7);
+  };
+
+  reset();
+  Timer t;
+  auto x = A, y = B;
+  for (int s = 0; s < steps; ++s) {
+    for (int i = 1; i < n - 1; ++i)
+      for (int j = 1; j < n - 1; ++j)
+        for (int k = 1; k < n - 1; ++k)
+          y[i, j, k] = (x[i - 1, j, k] + x[i + 1, j, k] + x[i, j - 1, k] + x[i, j + 1, k] +
+                        x[i, j, k - 1] + x[i, j, k + 1]) /
+                       6.;
+    std::swap(x, y);
+  }
+  const double t_loop = t.elapsed();
+  const double check = x[n / 2, n / 2, n / 2];
+  std::cout << n << ", loop, 1, " << updates / t_loop << std::endl;
+
+  for (int levels : {1, 2, 4, 8}) {
+    reset();
+    Timer tb;
+    auto res = stencil_steps(std::execution::par, st, A, B, steps, {.time_block = levels});
+    const double elapsed = tb.elapsed();
+    assert(std::abs(res[n / 2, n / 2, n / 2] - check) < 1e-12);
+    std::cout << n << ", stencil_steps, " << levels << ", " << updates / elapsed << std::endl;
+  }
+}
+
+// Usage: stencil_example [<n> [<steps>]]
+int main(int argc, char **argv) {
+  test_2d<std::layout_right>();
+  test_2d<std::layout_left>();
+  test_2d<std::experimental::layout_right_padded<std::dynamic_extent>>(64);
+  test_2d<std::layout_stride>(std::array<int, 2>{1, 40});
+  for (int levels : {2, 3, 4})
+    for (int tile : {0, 6, 9})
+      test_steps_3d(levels, tile);
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 256;
+  const int steps = argc > 2 ? std::atoi(argv[2]) : 16;
+
+  std::cout << "n, kernel, time block, GLUP/s" << std::endl;
+  bench(n, steps);
+}
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <experimental/mdspan>
+#include <experimental/simd>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Stencils over rank-2 and rank-3 mdspans:
+//
+//   stencil<T, R>          out[i] = sum_p coefficient_p * in[i + offset_p],
+//   functor_stencil<R, F>  out[i] = f(in, i...), f reading in[i + o] for
+//                          |o[d]| <= radius only.
+//
+// apply_stencil(policy, st, in, out) computes out over the interior of in,
+// the points at least st.radius() away from the boundary; the others are
+// left alone. stencil_steps(policy, st, a, b, steps) does steps Jacobi
+// sweeps ping-ponging between a and b, and returns the one holding the
+// result. The boundary of a and b must hold the same values.
+//
+// The axes are ordered by the strides of the output: the slowest axis is
+// swept, the second one cut into tiles sized for the L2 cache, and the
+// fastest one computed in runs. For strided layouts with the default
+// accessor, including the padded layouts, the runs of a coefficient
+// stencil are simd loops over contiguous elements; other layouts, accessors
+// and functor stencils go through mdspan indexing.
+//
+// With time_block = k > 1 stencil_steps does k sweeps per pass over memory.
+// Every tile of the second axis is a trapezoid in time, level t covering the
+// tile shrunk by (t - 1) * radius on the sides with a neighbour, and the
+// levels are computed as a wavefront along the slowest axis, level t lagging
+// radius planes behind level t - 1, so that only the planes of the wavefront
+// are in cache. The tiles are independent and run in parallel; the inverted
+// trapezoids left between them are filled in a second parallel phase. Two
+// buffers suffice since a plane is overwritten only once every level that
+// reads its older value has passed it.
+
+template <class T, std::size_t R> struct stencil {
+  static_assert(R == 2 || R == 3, "stencils are supported in rank 2 and 3");
+
+  struct point {
+    std::array<int, R> offset;
+    T coefficient;
+  };
+  std::vector<point> points;
+
+  int radius() const {
+    int r = 0;
+    for (const point &p : points)
+      for (int o : p.offset)
+        r = std::max(r, std::abs(o));
+    return r;
+  }
+};
+
+// center * in[i] + neighbours * (sum of the 2 R nearest neighbours of i),
+// e.g. the 7-point Jacobi sweep for the Laplace equation in rank 3 with
+// center = 0, neighbours = 1 / 6.
+template <class T, std::size_t R> stencil<T, R> star_stencil(T center, T neighbours) {
+  stencil<T, R> st;
+  st.points.push_back({{}, center});
+  for (std::size_t d = 0; d < R; ++d) {
+    for (int s : {-1, 1}) {
+      std::array<int, R> o{};
+      o[d] = s;
+      st.points.push_back({o, neighbours});
+    }
+  }
+  return st;
+}
+
+template <std::size_t R, class F> struct functor_stencil {
+  static_assert(R == 2 || R == 3, "stencils are supported in rank 2 and 3");
+
+  int r;
+  F f;
+
+  int radius() const { return r; }
+};
+
+template <std::size_t R, class F> functor_stencil<R, F> make_stencil(int radius, F f) {
+  return {radius, std::move(f)};
+}
+
+struct stencil_options {
+  // Sweeps per pass over memory in stencil_steps.
+  int time_block = 1;
+  // Width of the tiles along the second slowest axis, 0 to fit the planes
+  // of a wavefront in cache_bytes.
+  int tile = 0;
+  std::size_t cache_bytes = std::size_t{1} << 20;
+};
+
+namespace impl {
+
+namespace stdx = std::experimental;
+
+template <class St> inline constexpr bool is_coefficient_stencil_v = false;
+template <class T, std::size_t R>
+inline constexpr bool is_coefficient_stencil_v<stencil<T, R>> = true;
+
+template <class M>
+inline constexpr bool stencil_strided_v =
+    M::is_always_strided() &&
+    std::is_same_v<typename M::accessor_type,
+                   std::default_accessor<typename M::element_type>>;
+
+// Axes of m from the slowest to the fastest.
+template <class M> std::array<std::size_t, M::rank()> stencil_axes(const M &m) {
+  std::array<std::size_t, M::rank()> axes;
+  std::iota(axes.begin(), axes.end(), std::size_t{0});
+  if constexpr (M::is_always_strided()) {
+    std::stable_sort(axes.begin(), axes.end(),
+                     [&](std::size_t a, std::size_t b) { return m.stride(a) > m.stride(b); });
+  }
+  return axes;
+}
+
+// Computes runs of out from in along one axis, the per-point offsets of a
+// coefficient stencil precomputed.
+template <class St, class In, class Out> class stencil_kernel {
+  static constexpr std::size_t R = Out::rank();
+  using T = typename Out::value_type;
+  static constexpr bool fast =
+      is_coefficient_stencil_v<St> && stencil_strided_v<In> && stencil_strided_v<Out> &&
+      std::is_same_v<std::remove_const_t<typename In::element_type>, T> &&
+      std::is_arithmetic_v<T>;
+
+public:
+  stencil_kernel(const St &st, In in, Out out) : st_(st), in_(in), out_(out) {
+    if constexpr (fast) {
+      for (const auto &p : st.points) {
+        std::ptrdiff_t d = 0;
+        for (std::size_t k = 0; k < R; ++k)
+          d += p.offset[k] * static_cast<std::ptrdiff_t>(in.stride(k));
+        delta_.push_back(d);
+        coef_.push_back(p.coefficient);
+      }
+    }
+  }
+
+  // out at idx + j along axis, for j in [0, len).
+  void run(const std::array<int, R> &idx, std::size_t axis, int len) const {
+    if constexpr (fast) {
+      const T *pin = in_.data_handle() + std::apply(in_.mapping(), idx);
+      T *pout = out_.data_handle() + std::apply(out_.mapping(), idx);
+      const std::ptrdiff_t si = in_.stride(axis), so = out_.stride(axis);
+      const std::size_t np = delta_.size();
+      int j = 0;
+
+      if (si == 1 && so == 1) {
+        using simd_t = stdx::native_simd<T>;
+        constexpr int W = simd_t::size();
+        // Four independent accumulators hide the latency of the additions.
+        for (; j + 4 * W <= len; j += 4 * W) {
+          std::array<simd_t, 4> acc{};
+          for (std::size_t p = 0; p < np; ++p) {
+            const T *src = pin + j + delta_[p];
+            for (int u = 0; u < 4; ++u)
+              acc[u] += coef_[p] * simd_t(src + u * W, stdx::element_aligned);
+          }
+          for (int u = 0; u < 4; ++u)
+            acc[u].copy_to(pout + j + u * W, stdx::element_aligned);
+        }
+        for (; j + W <= len; j += W) {
+          simd_t acc(T{});
+          for (std::size_t p = 0; p < np; ++p)
+            acc += coef_[p] * simd_t(pin + j + delta_[p], stdx::element_aligned);
+          acc.copy_to(pout + j, stdx::element_aligned);
+        }
+      }
+      for (; j < len; ++j) {
+        T acc{};
+        for (std::size_t p = 0; p < np; ++p)
+          acc += coef_[p] * pin[j * si + delta_[p]];
+        pout[j * so] = acc;
+      }
+    } else {
+      std::array<int, R> i = idx;
+      for (int j = 0; j < len; ++j, ++i[axis]) {
+        if constexpr (is_coefficient_stencil_v<St>) {
+          T acc{};
+          for (const auto &p : st_.points) {
+            std::array<int, R> k;
+            for (std::size_t d = 0; d < R; ++d)
+              k[d] = i[d] + p.offset[d];
+            acc += p.coefficient * in_[k];
+          }
+          out_[i] = acc;
+        } else {
+          out_[i] = std::apply([&](auto... x) { return st_.f(in_, x...); }, i);
+        }
+      }
+    }
+  }
+
+  // out over [lo, hi), in runs along axes[R - 1], the other axes nested in
+  // the order of axes.
+  void box(const std::array<int, R> &lo, const std::array<int, R> &hi,
+           const std::array<std::size_t, R> &axes) const {
+    for (std::size_t d = 0; d < R; ++d)
+      if (lo[d] >= hi[d])
+        return;
+    const std::size_t inner = axes[R - 1];
+    const int len = hi[inner] - lo[inner];
+    std::array<int, R> idx = lo;
+    while (true) {
+      run(idx, inner, len);
+      std::size_t k = R - 1;
+      while (k-- > 0) {
+        const std::size_t d = axes[k];
+        if (++idx[d] < hi[d])
+          break;
+        idx[d] = lo[d];
+      }
+      if (k > R)
+        return;
+    }
+  }
+
+private:
+  const St &st_;
+  In in_;
+  Out out_;
+  std::vector<std::ptrdiff_t> delta_;
+  std::vector<T> coef_;
+};
+
+// Tile width along the second slowest axis: the planes touched by a
+// wavefront of `levels` levels in both buffers fit in cache_bytes, and
+// there are enough tiles for the hardware threads when possible.
+template <class T, std::size_t R>
+int stencil_tile(const std::array<int, R> &n, const std::array<std::size_t, R> &axes, int r,
+                 int levels, const stencil_options &opt) {
+  const int n1 = n[axes[1]] - 2 * r;
+  const int min_width = std::max(1, 2 * levels * r);
+  if (opt.tile > 0)
+    return std::clamp(opt.tile, min_width, std::max(min_width, n1));
+
+  std::size_t plane = sizeof(T);
+  for (std::size_t k = 2; k < R; ++k)
+    plane *= n[axes[k]];
+  const std::size_t planes = 2 * (static_cast<std::size_t>(levels) * r + 2 * r + 1);
+  int w = static_cast<int>(std::min<std::size_t>(opt.cache_bytes / (planes * plane), n1));
+  const int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  w = std::min(w, n1 / threads);
+  return std::max(w, min_width);
+}
+
+} // namespace impl
+
+template <class ExecutionPolicy, class St, class In, class Out>
+  requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void apply_stencil(ExecutionPolicy &&policy, const St &st, In in, Out out,
+                   stencil_options opt = {}) {
+  constexpr std::size_t R = Out::rank();
+  static_assert(R == 2 || R == 3, "stencils are supported in rank 2 and 3");
+  const int r = st.radius();
+  std::array<int, R> n;
+  for (std::size_t d = 0; d < R; ++d) {
+    n[d] = static_cast<int>(out.extent(d));
+    if (in.extent(d) != out.extent(d))
+      std::terminate();
+    if (n[d] <= 2 * r)
+      return;
+  }
+
+  const auto axes = impl::stencil_axes(out);
+  const std::size_t a0 = axes[0], a1 = axes[1];
+  const int w = impl::stencil_tile<typename Out::value_type>(n, axes, r, 1, opt);
+  const int n0 = n[a0] - 2 * r, n1 = n[a1] - 2 * r;
+  const int tiles = std::max(1, n1 / w);
+  // Without temporal dependencies the slowest axis can be split as well.
+  const int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  const int chunks = std::clamp(4 * threads / tiles, 1, n0);
+
+  const impl::stencil_kernel<St, In, Out> kernel(st, in, out);
+  std::vector<int> ids(tiles * chunks);
+  std::iota(ids.begin(), ids.end(), 0);
+  std::for_each(policy, ids.begin(), ids.end(), [&](int id) {
+    const int t = id % tiles, c = id / tiles;
+    std::array<int, R> lo, hi;
+    for (std::size_t d = 0; d < R; ++d) {
+      lo[d] = r;
+      hi[d] = n[d] - r;
+    }
+    lo[a1] = r + static_cast<int>(static_cast<long long>(n1) * t / tiles);
+    hi[a1] = r + static_cast<int>(static_cast<long long>(n1) * (t + 1) / tiles);
+    lo[a0] = r + static_cast<int>(static_cast<long long>(n0) * c / chunks);
+    hi[a0] = r + static_cast<int>(static_cast<long long>(n0) * (c + 1) / chunks);
+    kernel.box(lo, hi, axes);
+  });
+}
+
+template <class St, class In, class Out>
+void apply_stencil(const St &st, In in, Out out, stencil_options opt = {}) {
+  apply_stencil(std::execution::seq, st, in, out, opt);
+}
+
+template <class ExecutionPolicy, class St, class M>
+  requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+M stencil_steps(ExecutionPolicy &&policy, const St &st, M a, M b, int steps,
+                stencil_options opt = {}) {
+  constexpr std::size_t R = M::rank();
+  static_assert(R == 2 || R == 3, "stencils are supported in rank 2 and 3");
+  const int r = st.radius();
+  std::array<int, R> n;
+  for (std::size_t d = 0; d < R; ++d) {
+    n[d] = static_cast<int>(a.extent(d));
+    if (b.extent(d) != a.extent(d))
+      std::terminate();
+    if (n[d] <= 2 * r)
+      return a;
+  }
+  if (opt.time_block <= 1 || r == 0) {
+    for (int s = 0; s < steps; ++s) {
+      apply_stencil(policy, st, a, b, opt);
+      std::swap(a, b);
+    }
+    return a;
+  }
+
+  const auto axes = impl::stencil_axes(a);
+  const std::size_t a0 = axes[0], a1 = axes[1];
+  const int n1 = n[a1] - 2 * r;
+
+  while (steps > 0) {
+    const int levels = std::min(opt.time_block, steps);
+    const int w = impl::stencil_tile<typename M::value_type>(n, axes, r, levels, opt);
+    const int tiles = std::max(1, n1 / w);
+    auto bound = [&](int t) {
+      return r + static_cast<int>(static_cast<long long>(n1) * t / tiles);
+    };
+
+    // Level t reads the buffer of level t - 1: a for odd t, b for even t.
+    const impl::stencil_kernel<St, M, M> odd(st, a, b), even(st, b, a);
+
+    // Levels 1..levels of the range [lo(t), hi(t)) of the second axis,
+    // as a wavefront over the slowest axis.
+    auto wavefront = [&](auto range) {
+      std::array<int, R> lo, hi;
+      for (std::size_t d = 0; d < R; ++d) {
+        lo[d] = r;
+        hi[d] = n[d] - r;
+      }
+      for (int p = r; p < n[a0] - r + (levels - 1) * r; ++p) {
+        for (int t = 1; t <= levels; ++t) {
+          const int q = p - (t - 1) * r;
+          if (q < r || q >= n[a0] - r)
+            continue;
+          lo[a0] = q;
+          hi[a0] = q + 1;
+          std::tie(lo[a1], hi[a1]) = range(t);
+          (t % 2 == 1 ? odd : even).box(lo, hi, axes);
+        }
+      }
+    };
+
+    std::vector<int> ids(tiles);
+    std::iota(ids.begin(), ids.end(), 0);
+    std::for_each(policy, ids.begin(), ids.end(), [&](int k) {
+      wavefront([&](int t) {
+        const int shrink = (t - 1) * r;
+        return std::pair{bound(k) + (k > 0 ? shrink : 0),
+                         bound(k + 1) - (k < tiles - 1 ? shrink : 0)};
+      });
+    });
+    std::for_each(policy, ids.begin() + 1, ids.end(), [&](int k) {
+      wavefront([&](int t) {
+        const int grow = (t - 1) * r;
+        return std::pair{bound(k) - grow, bound(k) + grow};
+      });
+    });
+
+    if (levels % 2 == 1)
+      std::swap(a, b);
+    steps -= levels;
+  }
+  return a;
+}
+
+template <class St, class M>
+M stencil_steps(const St &st, M a, M b, int steps, stencil_options opt = {}) {
+  return stencil_steps(std::execution::seq, st, a, b, steps, opt);
+}
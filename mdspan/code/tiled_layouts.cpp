@@ -0,0 +1,201 @@
+#include "tiled_layouts.hpp"
+#include "timer.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Counts hardware cache misses (last level) with perf_event_open, where
+// available. value() is -1 if the counter could not be opened, e.g. because
+// of /proc/sys/kernel/perf_event_paranoid.
+class CacheMissCounter {
+  int fd_ = -1;
+
+public:
+  CacheMissCounter() {
+#ifdef __linux__
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    if (fd_ >= 0) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+  CacheMissCounter(const CacheMissCounter &) = delete;
+  CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+  ~CacheMissCounter() {
+#ifdef __linux__
+    if (fd_ >= 0)
+      close(fd_);
+#endif
+  }
+
+  long long value() const {
+#ifdef __linux__
+    long long count = 0;
+    if (fd_ >= 0 && read(fd_, &count, sizeof(count)) == sizeof(count))
+      return count;
+#endif
+    return -1;
+  }
+};
+
+// Every element maps to a distinct offset in [0, required_span_size()).
+template <class Layout> void test_mapping(int m, int n) {
+  using ext_t = std::dextents<int, 2>;
+  typename Layout::template mapping<ext_t> map(ext_t{m, n});
+  std::set<int> offsets;
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      const int o = map(i, j);
+      assert(o >= 0 && o < map.required_span_size());
+      offsets.insert(o);
+    }
+  }
+  assert(offsets.size() == std::size_t(m) * n);
+}
+
+template <class Layout> void test_submdspan() {
+  using ext_t = std::dextents<int, 2>;
+  typename Layout::template mapping<ext_t> map(ext_t{13, 21});
+  std::vector<float> v(map.required_span_size());
+  auto A = std::mdspan<float, ext_t, Layout>(v.data(), map);
+
+  for (int i = 0; i < 13; ++i)
+    for (int j = 0; j < 21; ++j)
+      A[i, j] = i * 100 + j;
+
+  auto S = std::submdspan(A, std::pair{3, 11}, std::tuple{5, 20});
+  assert(S.extent(0) == 8);
+  assert(S.extent(1) == 15);
+  assert((S[0, 0] == 305));
+  assert((S[7, 14] == 1019));
+
+  auto SS = std::submdspan(S, std::full_extent, std::pair{2, 4});
+  assert((SS[1, 1] == 408));
+
+  auto T = std::submdspan(A, std::strided_slice{.offset = 2, .extent = 9, .stride = 1},
+                          std::full_extent);
+  assert(T.extent(0) == 9 && T.extent(1) == 21);
+  assert((T[8, 20] == 1020));
+}
+
+// Keeps the sweeps from being optimized away.
+volatile float sink;
+
+template <class Mat> float row_sweep(Mat A) {
+  float s = 0;
+  for (int i = 0; i < A.extent(0); ++i)
+    for (int j = 0; j < A.extent(1); ++j)
+      s += A[i, j];
+  return s;
+}
+
+template <class Mat> float col_sweep(Mat A) {
+  float s = 0;
+  for (int j = 0; j < A.extent(1); ++j)
+    for (int i = 0; i < A.extent(0); ++i)
+      s += A[i, j];
+  return s;
+}
+
+// 5-point stencil over 32 x 32 blocks, B = A + neighbours.
+template <class Mat> void blocked_stencil(Mat A, Mat B) {
+  constexpr int bs = 32;
+  const int m = A.extent(0);
+  const int n = A.extent(1);
+  for (int ib = 1; ib < m - 1; ib += bs) {
+    for (int jb = 1; jb < n - 1; jb += bs) {
+      for (int i = ib; i < std::min(ib + bs, m - 1); ++i) {
+        for (int j = jb; j < std::min(jb + bs, n - 1); ++j) {
+          B[i, j] = A[i, j] + A[i - 1, j] + A[i + 1, j] + A[i, j - 1] + A[i, j + 1];
+        }
+      }
+    }
+  }
+}
+
+template <class Layout> void bench(std::string name, int n, int reps) {
+  using ext_t = std::dextents<int, 2>;
+  typename Layout::template mapping<ext_t> map(ext_t{n, n});
+  std::vector<float> a(map.required_span_size(), 1.f);
+  std::vector<float> b(map.required_span_size(), 0.f);
+  auto A = std::mdspan<float, ext_t, Layout>(a.data(), map);
+  auto B = std::mdspan<float, ext_t, Layout>(b.data(), map);
+
+  double t_row = 1e30, t_col = 1e30, t_blk = 1e30;
+  long long m_row = 0, m_col = 0, m_blk = 0;
+  float sum = 0;
+  for (int r = 0; r < reps; ++r) {
+    {
+      CacheMissCounter c;
+      Timer t;
+      sum += row_sweep(A);
+      t_row = std::min(t_row, t.elapsed());
+      m_row = c.value();
+    }
+    {
+      CacheMissCounter c;
+      Timer t;
+      sum += col_sweep(A);
+      t_col = std::min(t_col, t.elapsed());
+      m_col = c.value();
+    }
+    {
+      CacheMissCounter c;
+      Timer t;
+      blocked_stencil(A, B);
+      t_blk = std::min(t_blk, t.elapsed());
+      m_blk = c.value();
+    }
+  }
+
+  sink = sum + b[0];
+
+  std::cout << name << ", " << n << ", " << t_row << ", " << m_row << ", "
+            << t_col << ", " << m_col << ", " << t_blk << ", " << m_blk << std::endl;
+}
+
+// Usage: tiled_layouts_example [<n> [<reps>]]
+// The cache misses are those of the last repetition, -1 if not available.
+int main(int argc, char **argv) {
+  test_mapping<layout_tiled<8, 8>>(37, 53);
+  test_mapping<layout_tiled<4, 16>>(64, 64);
+  test_mapping<layout_morton>(37, 53);
+  test_mapping<layout_morton>(64, 64);
+  test_mapping<layout_morton>(5, 300);
+  test_mapping<layout_morton>(300, 3);
+  // Non-square: each extent padded to its own power of two.
+  using morton_map = layout_morton::mapping<std::dextents<int, 2>>;
+  assert(morton_map(std::dextents<int, 2>{16, 65536}).required_span_size() == 1 << 20);
+  test_submdspan<layout_tiled<8, 8>>();
+  test_submdspan<layout_tiled<3, 5>>();
+  test_submdspan<layout_morton>();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 2048;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  std::cout << "layout, n, row sweep [s], misses, column sweep [s], misses, blocked stencil [s], misses" << std::endl;
+  bench<std::layout_right>("layout_right", n, reps);
+  bench<std::layout_left>("layout_left", n, reps);
+  bench<layout_tiled<8, 8>>("layout_tiled<8, 8>", n, reps);
+  bench<layout_tiled<32, 32>>("layout_tiled<32, 32>", n, reps);
+  bench<layout_morton>("layout_morton", n, reps);
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <experimental/mdspan>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Rank-2 layouts with good locality in both dimensions.
+//
+// layout_tiled<TM, TN>: the matrix is split into TM x TN tiles. Tiles are
+// stored contiguously, row-major inside a tile, and the tiles are ordered
+// row-major. Partial tiles at the borders are padded.
+//
+// layout_morton: Z-order (Morton) curve, the offset interleaves the bits of
+// the column index (even bits) and of the row index (odd bits). Each extent
+// is padded to its own power of two; on non-square shapes only the low bits
+// the two indices share are interleaved, the extra high bits of the longer
+// axis are appended, so a 16 x 65536 matrix spans 2^20 elements. Shapes
+// whose padded span does not fit in index_type terminate.
+//
+// Both mappings support submdspan with pair, tuple, full_extent and unit
+// stride strided_slice slices: a submatrix keeps the geometry of the whole
+// matrix plus the offset of its first row and column. Integer slices (a row
+// or a column) and strides other than 1 are not supported, the offsets of
+// such a slice are neither strided nor a submatrix: they are a compile time
+// error and a std::terminate respectively.
+
+namespace impl {
+
+template <class T> inline constexpr bool is_strided_slice_v = false;
+template <class O, class E, class S>
+inline constexpr bool is_strided_slice_v<std::strided_slice<O, E, S>> = true;
+
+template <class Slice, class IndexType>
+constexpr std::pair<IndexType, IndexType> slice_bounds(Slice s, IndexType ext) {
+  if constexpr (std::is_same_v<Slice, std::full_extent_t>) {
+    return {0, ext};
+  } else if constexpr (is_strided_slice_v<Slice>) {
+    const auto first = static_cast<IndexType>(s.offset);
+    const auto n = static_cast<IndexType>(s.extent);
+    if (n > 1 && static_cast<IndexType>(s.stride) != 1)
+      std::terminate();
+    return {first, static_cast<IndexType>(first + n)};
+  } else {
+    static_assert(!std::is_convertible_v<Slice, IndexType>,
+                  "integer slices are not supported, the result is not a submatrix");
+    static_assert(std::tuple_size_v<Slice> == 2,
+                  "only pair, tuple and full_extent slices are supported");
+    return {static_cast<IndexType>(std::get<0>(s)),
+            static_cast<IndexType>(std::get<1>(s))};
+  }
+}
+
+// Number of bits of the indices of an extent n, padded to a power of two.
+constexpr int index_bits(std::size_t n) noexcept {
+  return n <= 1 ? 0 : std::bit_width(n - 1);
+}
+
+// Spreads the lower 32 bits of x to the even bits of the result.
+constexpr std::uint64_t spread_bits(std::uint64_t x) noexcept {
+  x &= 0xffffffffull;
+  x = (x | (x << 16)) & 0x0000ffff0000ffffull;
+  x = (x | (x << 8)) & 0x00ff00ff00ff00ffull;
+  x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0full;
+  x = (x | (x << 2)) & 0x3333333333333333ull;
+  x = (x | (x << 1)) & 0x5555555555555555ull;
+  return x;
+}
+
+} // namespace impl
+
+template <std::size_t TM, std::size_t TN> struct layout_tiled {
+  static_assert(TM > 0 && TN > 0);
+
+  template <class Extents> class mapping {
+  public:
+    using extents_type = Extents;
+    using index_type = typename extents_type::index_type;
+    using size_type = typename extents_type::size_type;
+    using rank_type = typename extents_type::rank_type;
+    using layout_type = layout_tiled;
+
+    static_assert(extents_type::rank() == 2);
+
+  private:
+    static constexpr index_type tm = TM;
+    static constexpr index_type tn = TN;
+
+    extents_type extents_{};
+    // Tiles per row and per column of the whole matrix.
+    index_type ntr_ = 0;
+    index_type ntc_ = 0;
+    index_type row_offset_ = 0;
+    index_type col_offset_ = 0;
+
+  public:
+    constexpr mapping() noexcept = default;
+    constexpr mapping(const mapping &) noexcept = default;
+    constexpr mapping &operator=(const mapping &) noexcept = default;
+
+    constexpr mapping(const extents_type &e) noexcept
+        : mapping(e, (e.extent(0) + tm - 1) / tm, (e.extent(1) + tn - 1) / tn, 0, 0) {}
+
+    // Submatrix of extents e starting at (row_offset, col_offset) of a
+    // matrix with ntr x ntc tiles.
+    constexpr mapping(const extents_type &e, index_type ntr, index_type ntc,
+                      index_type row_offset, index_type col_offset) noexcept
+        : extents_(e), ntr_(ntr), ntc_(ntc), row_offset_(row_offset),
+          col_offset_(col_offset) {}
+
+    template <class OtherExtents>
+      requires std::is_constructible_v<extents_type, OtherExtents>
+    constexpr explicit(!std::is_convertible_v<OtherExtents, extents_type>)
+        mapping(const mapping<OtherExtents> &other) noexcept
+        : extents_(other.extents()), ntr_(other.tile_rows()), ntc_(other.tile_cols()),
+          row_offset_(other.row_offset()), col_offset_(other.col_offset()) {}
+
+    constexpr const extents_type &extents() const noexcept { return extents_; }
+
+    constexpr index_type tile_rows() const noexcept { return ntr_; }
+    constexpr index_type tile_cols() const noexcept { return ntc_; }
+    constexpr index_type row_offset() const noexcept { return row_offset_; }
+    constexpr index_type col_offset() const noexcept { return col_offset_; }
+
+    constexpr index_type required_span_size() const noexcept {
+      return ntr_ * ntc_ * tm * tn;
+    }
+
+    template <class I0, class I1>
+    constexpr index_type operator()(I0 i0, I1 i1) const noexcept {
+      const index_type i = static_cast<index_type>(i0) + row_offset_;
+      const index_type j = static_cast<index_type>(i1) + col_offset_;
+      return ((i / tm) * ntc_ + j / tn) * (tm * tn) + (i % tm) * tn + j % tn;
+    }
+
+    static constexpr bool is_always_unique() noexcept { return true; }
+    static constexpr bool is_always_exhaustive() noexcept { return false; }
+    static constexpr bool is_always_strided() noexcept { return false; }
+
+    static constexpr bool is_unique() noexcept { return true; }
+    constexpr bool is_exhaustive() const noexcept {
+      return row_offset_ == 0 && col_offset_ == 0 &&
+             extents_.extent(0) == ntr_ * tm && extents_.extent(1) == ntc_ * tn;
+    }
+    static constexpr bool is_strided() noexcept { return false; }
+
+    template <class OtherExtents>
+    friend constexpr bool operator==(const mapping &lhs,
+                                     const mapping<OtherExtents> &rhs) noexcept {
+      return lhs.extents() == rhs.extents() && lhs.tile_rows() == rhs.tile_rows() &&
+             lhs.tile_cols() == rhs.tile_cols() &&
+             lhs.row_offset() == rhs.row_offset() && lhs.col_offset() == rhs.col_offset();
+    }
+
+    template <class S0, class S1>
+    friend constexpr auto submdspan_mapping(const mapping &src, S0 s0, S1 s1) {
+      using sub_extents_t = std::dextents<index_type, 2>;
+      using sub_mapping_t = mapping<sub_extents_t>;
+      const auto [r0, r1] = impl::slice_bounds(s0, src.extents().extent(0));
+      const auto [c0, c1] = impl::slice_bounds(s1, src.extents().extent(1));
+
+      return std::submdspan_mapping_result<sub_mapping_t>{
+          sub_mapping_t(sub_extents_t(r1 - r0, c1 - c0), src.ntr_, src.ntc_,
+                        src.row_offset_ + r0, src.col_offset_ + c0),
+          0};
+    }
+  };
+};
+
+struct layout_morton {
+  template <class Extents> class mapping {
+  public:
+    using extents_type = Extents;
+    using index_type = typename extents_type::index_type;
+    using size_type = typename extents_type::size_type;
+    using rank_type = typename extents_type::rank_type;
+    using layout_type = layout_morton;
+
+    static_assert(extents_type::rank() == 2);
+
+  private:
+    extents_type extents_{};
+    // Bits of the row and column indices of the whole matrix, its extents
+    // padded to 2^row_bits x 2^col_bits.
+    int row_bits_ = 0;
+    int col_bits_ = 0;
+    index_type row_offset_ = 0;
+    index_type col_offset_ = 0;
+
+  public:
+    constexpr mapping() noexcept = default;
+    constexpr mapping(const mapping &) noexcept = default;
+    constexpr mapping &operator=(const mapping &) noexcept = default;
+
+    constexpr mapping(const extents_type &e) noexcept
+        : mapping(e, impl::index_bits(static_cast<std::size_t>(e.extent(0))),
+                  impl::index_bits(static_cast<std::size_t>(e.extent(1))), 0, 0) {}
+
+    constexpr mapping(const extents_type &e, int row_bits, int col_bits,
+                      index_type row_offset, index_type col_offset) noexcept
+        : extents_(e), row_bits_(row_bits), col_bits_(col_bits), row_offset_(row_offset),
+          col_offset_(col_offset) {
+      if (row_bits + col_bits >= std::numeric_limits<index_type>::digits)
+        std::terminate();
+    }
+
+    template <class OtherExtents>
+      requires std::is_constructible_v<extents_type, OtherExtents>
+    constexpr explicit(!std::is_convertible_v<OtherExtents, extents_type>)
+        mapping(const mapping<OtherExtents> &other) noexcept
+        : mapping(extents_type(other.extents()), other.row_bits(), other.col_bits(),
+                  static_cast<index_type>(other.row_offset()),
+                  static_cast<index_type>(other.col_offset())) {}
+
+    constexpr const extents_type &extents() const noexcept { return extents_; }
+
+    constexpr int row_bits() const noexcept { return row_bits_; }
+    constexpr int col_bits() const noexcept { return col_bits_; }
+    constexpr index_type row_offset() const noexcept { return row_offset_; }
+    constexpr index_type col_offset() const noexcept { return col_offset_; }
+
+    constexpr index_type required_span_size() const noexcept {
+      return index_type(1) << (row_bits_ + col_bits_);
+    }
+
+    template <class I0, class I1>
+    constexpr index_type operator()(I0 i0, I1 i1) const noexcept {
+      const auto i = static_cast<std::uint64_t>(static_cast<index_type>(i0) + row_offset_);
+      const auto j = static_cast<std::uint64_t>(static_cast<index_type>(i1) + col_offset_);
+      const int shared = std::min(row_bits_, col_bits_);
+      const std::uint64_t low = (std::uint64_t(1) << shared) - 1;
+      const std::uint64_t high = (row_bits_ > col_bits_ ? i : j) >> shared;
+      return static_cast<index_type>(impl::spread_bits(j & low) |
+                                     (impl::spread_bits(i & low) << 1) | (high << (2 * shared)));
+    }
+
+    static constexpr bool is_always_unique() noexcept { return true; }
+    static constexpr bool is_always_exhaustive() noexcept { return false; }
+    static constexpr bool is_always_strided() noexcept { return false; }
+
+    static constexpr bool is_unique() noexcept { return true; }
+    constexpr bool is_exhaustive() const noexcept {
+      return row_offset_ == 0 && col_offset_ == 0 &&
+             extents_.extent(0) == index_type(1) << row_bits_ &&
+             extents_.extent(1) == index_type(1) << col_bits_;
+    }
+    static constexpr bool is_strided() noexcept { return false; }
+
+    template <class OtherExtents>
+    friend constexpr bool operator==(const mapping &lhs,
+                                     const mapping<OtherExtents> &rhs) noexcept {
+      return lhs.extents() == rhs.extents() && lhs.row_bits() == rhs.row_bits() &&
+             lhs.col_bits() == rhs.col_bits() && lhs.row_offset() == rhs.row_offset() &&
+             lhs.col_offset() == rhs.col_offset();
+    }
+
+    template <class S0, class S1>
+    friend constexpr auto submdspan_mapping(const mapping &src, S0 s0, S1 s1) {
+      using sub_extents_t = std::dextents<index_type, 2>;
+      using sub_mapping_t = mapping<sub_extents_t>;
+      const auto [r0, r1] = impl::slice_bounds(s0, src.extents().extent(0));
+      const auto [c0, c1] = impl::slice_bounds(s1, src.extents().extent(1));
+
+      return std::submdspan_mapping_result<sub_mapping_t>{
+          sub_mapping_t(sub_extents_t(r1 - r0, c1 - c0), src.row_bits_, src.col_bits_,
+                        src.row_offset_ + r0, src.col_offset_ + c0),
+          0};
+    }
+  };
+};
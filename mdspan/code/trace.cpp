@@ -0,0 +1,165 @@
+#include "tiled_layouts.hpp"
+#include "timer.hpp"
+#include "trace.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+void test_trace() {
+  // Two sequential passes over 1024 doubles, 128 lines of 64 bytes.
+  std::vector<double> v(1024 + 8);
+  // Start on a line boundary.
+  double *p = v.data();
+  while (reinterpret_cast<std::uintptr_t>(p) % 64 != 0)
+    ++p;
+  access_trace trace;
+  auto V = trace.view(std::mdspan(p, std::dextents<int, 1>{1024}), "v");
+  double s = 0;
+  for (int pass = 0; pass < 2; ++pass)
+    for (int i = 0; i < 1024; ++i)
+      s += V[i];
+  assert(s == 0);
+
+  const trace_report r = trace.analyze();
+  assert(r.accesses == 2048 && r.sampled == 2048);
+  assert(r.cold == 128);
+  // 7 of every 8 accesses hit the line just accessed.
+  assert(r.reuse[0] == 2 * 896);
+  // The second pass reuses each line after the 127 others: [64, 128).
+  assert(r.reuse.size() == 8 && r.reuse[7] == 128);
+  assert(r.l1_misses == 128 && r.l2_misses == 128);
+  assert(r.miss_rate_at(64) == 256. / 2048);
+  assert(r.miss_rate_at(512) == 128. / 2048);
+  // Stride +1 except the jump back to the start.
+  assert((r.sites[0].strides[0] == std::pair<std::ptrdiff_t, std::uint64_t>(1, 2046)));
+  assert((r.sites[0].strides[1] == std::pair<std::ptrdiff_t, std::uint64_t>(-1023, 1)));
+
+  // A 1 KiB direct mapped L1 thrashes on a 2 KiB stride.
+  trace.clear();
+  for (int k = 0; k < 4; ++k)
+    for (int i : {0, 256, 512})
+      s += V[i];
+  const trace_report t = trace.analyze({.l1 = {1024, 1}});
+  assert(t.sampled == 12 && t.l1_misses == 12 && t.l2_misses == 3);
+
+  // Sampling keeps about the given fraction of the lines, and all the
+  // accesses to them.
+  std::vector<float> big((1 << 20) + 16);
+  float *q = big.data();
+  while (reinterpret_cast<std::uintptr_t>(q) % 64 != 0)
+    ++q;
+  access_trace sampled({.sample_rate = 0.125});
+  auto B = sampled.view(std::mdspan(q, std::dextents<int, 1>{1 << 20}), "big");
+  for (int i = 0; i < (1 << 20); ++i)
+    s += B[i];
+  const trace_report b = sampled.analyze();
+  assert(b.accesses == (1u << 20));
+  assert(b.sampled > (1u << 17) * 0.9 && b.sampled < (1u << 17) * 1.1);
+  assert(b.sampled % 16 == 0 && b.cold * 16 == b.sampled);
+}
+
+// C += A * B with the loop orders of gemm_1 (j, l, i) and gemm_3 (i, l, j)
+// in stdBLAS/examples/gemm.cpp.
+template <class MA, class MB, class MC> void gemm_1(MA A, MB B, MC C) {
+  for (int j = 0; j < C.extent(1); ++j)
+    for (int l = 0; l < A.extent(1); ++l) {
+      const auto blj = B[l, j];
+      for (int i = 0; i < C.extent(0); ++i)
+        C[i, j] += A[i, l] * blj;
+    }
+}
+
+template <class MA, class MB, class MC> void gemm_3(MA A, MB B, MC C) {
+  for (int i = 0; i < C.extent(0); ++i)
+    for (int l = 0; l < A.extent(1); ++l) {
+      const auto ail = A[i, l];
+      for (int j = 0; j < C.extent(1); ++j)
+        C[i, j] += ail * B[l, j];
+    }
+}
+
+template <class Layout> auto matrix(std::vector<double> &v, int n) {
+  using ext = std::dextents<int, 2>;
+  typename Layout::template mapping<ext> map(ext{n, n});
+  v.assign(map.required_span_size(), 1.);
+  return std::mdspan(v.data(), map);
+}
+
+template <class Layout> void report_gemm(const char *name, int n, double rate) {
+  std::vector<double> a, b, c;
+  auto A = matrix<Layout>(a, n), B = matrix<Layout>(b, n), C = matrix<Layout>(c, n);
+  const cache_model model;
+
+  for (int kernel : {1, 3}) {
+    access_trace trace({.sample_rate = rate});
+    auto tA = trace.view(A, "A"), tB = trace.view(B, "B"), tC = trace.view(C, "C");
+    if (kernel == 1)
+      gemm_1(tA, tB, tC);
+    else
+      gemm_3(tA, tB, tC);
+    std::cout << "gemm_" << kernel << ", " << name << ", n " << n << "\n"
+              << trace.analyze(model) << std::endl;
+  }
+}
+
+// Column sweeps: every access touches a new line, reused by the next column
+// n lines later. With a power of two n the lines of a column also fall into
+// few cache sets.
+template <class Layout> void report_columns(const char *name, int n) {
+  std::vector<double> v;
+  auto M = matrix<Layout>(v, n);
+  access_trace trace;
+  auto T = trace.view(M, "M");
+  double s = 0;
+  for (int j = 0; j < n; ++j)
+    for (int i = 0; i < n; ++i)
+      s += T[i, j];
+  assert(s == double(n) * n);
+  const trace_report r = trace.analyze();
+  std::cout << name << " column sweep, n " << n << ": L1 miss rate " << r.l1_miss_rate()
+            << ", L2 miss rate " << r.l2_miss_rate() << std::endl;
+}
+
+// Cost of the recording for a sum, against the plain mdspan.
+void bench_overhead(int n) {
+  std::vector<double> v(std::size_t(n) * n, 1.);
+  auto M = std::mdspan(v.data(), std::dextents<int, 2>{n, n});
+  auto sum = [&](auto m) {
+    double s = 0;
+    for (int i = 0; i < n; ++i)
+      for (int j = 0; j < n; ++j)
+        s += m[i, j];
+    return s;
+  };
+
+  Timer t;
+  const double s0 = sum(M);
+  const double t0 = t.elapsed();
+  std::cout << "overhead, plain: " << t0 << " s";
+  for (double rate : {1., 0.01}) {
+    access_trace trace({.sample_rate = rate});
+    Timer tt;
+    const double s1 = sum(trace.view(M, "M"));
+    const double t1 = tt.elapsed();
+    assert(s1 == s0);
+    std::cout << ", rate " << rate << ": " << t1 << " s (x" << t1 / t0 << ")";
+  }
+  std::cout << std::endl;
+}
+
+// Usage: trace_example [<n>]
+int main(int argc, char **argv) {
+  test_trace();
+
+  const int n = argc > 1 ? std::atoi(argv[1]) : 256;
+
+  report_gemm<std::layout_right>("layout_right", n, 0.1);
+  report_gemm<layout_tiled<8, 8>>("layout_tiled<8, 8>", n, 0.1);
+  for (int m : {8 * n, 8 * n - 48}) {
+    report_columns<std::layout_right>("layout_right", m);
+    report_columns<layout_tiled<8, 8>>("layout_tiled<8, 8>", m);
+  }
+  bench_overhead(4 * n);
+}
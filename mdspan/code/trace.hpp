@@ -0,0 +1,349 @@
+#pragma once
+
+#include <experimental/mdspan>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Address traces of mdspan kernels and a cache model to analyse them,
+// without hardware counters.
+//
+// access_trace::view(m, name) returns m with a trace_accessor, every access
+// through which is recorded under the site `name`: give each operand of a
+// kernel (or each access expression, with several views of the same data)
+// its own view. Recording costs a hash and a few compares per access; only
+// the accesses to a sample of the cache lines are stored:
+//
+//  - the lines are sampled by a hash of their address, at sample_rate, so
+//    all the accesses to a sampled line are kept (as in SHARDS),
+//  - reuse distances, the number of distinct lines touched between two
+//    accesses to a line, are computed on the sample and scaled by
+//    1 / sample_rate,
+//  - the caches are simulated with their number of sets scaled by
+//    sample_rate, which is exact for sample_rate = 1 and an estimate
+//    otherwise.
+//
+// Strides, the distance in elements between consecutive accesses of a site,
+// are counted on every access. The recording is not thread safe: trace
+// sequential kernels.
+
+struct cache_level {
+  std::size_t bytes;
+  std::size_t ways;
+};
+
+struct cache_model {
+  std::size_t line_bytes = 64;
+  cache_level l1{std::size_t{32} << 10, 8};
+  cache_level l2{std::size_t{1} << 20, 16};
+};
+
+struct trace_options {
+  double sample_rate = 1;
+  std::size_t line_bytes = 64;
+  // Sampled accesses beyond this are dropped.
+  std::size_t max_records = std::size_t{1} << 26;
+};
+
+struct trace_site_report {
+  std::string name;
+  std::uint64_t accesses = 0;
+  std::uint64_t sampled = 0;
+  std::uint64_t l1_misses = 0;
+  std::uint64_t l2_misses = 0;
+  // The most frequent strides in elements and their counts, then the count
+  // of the other ones.
+  std::vector<std::pair<std::ptrdiff_t, std::uint64_t>> strides;
+  std::uint64_t other_strides = 0;
+
+  double l1_miss_rate() const { return sampled ? double(l1_misses) / sampled : 0; }
+  double l2_miss_rate() const { return sampled ? double(l2_misses) / sampled : 0; }
+};
+
+struct trace_report {
+  std::uint64_t accesses = 0;
+  std::uint64_t sampled = 0;
+  std::uint64_t dropped = 0;
+  double sample_rate = 1;
+  // reuse[0]: distance 0, reuse[b]: distance in [2^(b-1), 2^b) lines, in
+  // sampled accesses; cold: first accesses to a line.
+  std::vector<std::uint64_t> reuse;
+  std::uint64_t cold = 0;
+  std::uint64_t l1_misses = 0;
+  std::uint64_t l2_misses = 0;
+  std::vector<trace_site_report> sites;
+
+  double l1_miss_rate() const { return sampled ? double(l1_misses) / sampled : 0; }
+  double l2_miss_rate() const { return sampled ? double(l2_misses) / sampled : 0; }
+
+  // Fraction of the sampled accesses with a reuse distance of at least
+  // `lines`, cold ones included: the miss rate of a fully associative LRU
+  // cache of that many lines, at the resolution of the histogram.
+  double miss_rate_at(std::uint64_t lines) const {
+    if (sampled == 0)
+      return 0;
+    std::uint64_t misses = cold;
+    for (std::size_t b = 0; b < reuse.size(); ++b)
+      if (b > 0 && (std::uint64_t{1} << (b - 1)) >= lines)
+        misses += reuse[b];
+    return double(misses) / sampled;
+  }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const trace_report &r) {
+  os << "accesses " << r.accesses << ", sampled " << r.sampled << " (rate " << r.sample_rate
+     << (r.dropped ? ", dropped " + std::to_string(r.dropped) : std::string()) << ")\n"
+     << "L1 miss rate " << r.l1_miss_rate() << ", L2 miss rate " << r.l2_miss_rate() << "\n"
+     << "reuse distance [lines]: cold " << r.cold;
+  for (std::size_t b = 0; b < r.reuse.size(); ++b) {
+    if (r.reuse[b] == 0)
+      continue;
+    os << ", ";
+    if (b == 0)
+      os << "0";
+    else
+      os << "<" << (std::uint64_t{1} << b);
+    os << ": " << r.reuse[b];
+  }
+  os << "\n";
+  for (const trace_site_report &s : r.sites) {
+    os << "  " << s.name << ": accesses " << s.accesses << ", L1 miss rate " << s.l1_miss_rate()
+       << ", L2 miss rate " << s.l2_miss_rate() << ", strides";
+    for (auto [stride, count] : s.strides)
+      os << " " << stride << " x" << count;
+    if (s.other_strides)
+      os << " other x" << s.other_strides;
+    os << "\n";
+  }
+  return os;
+}
+
+class access_trace;
+
+template <class T> struct trace_accessor {
+  using element_type = T;
+  using reference = T &;
+  using data_handle_type = T *;
+  using offset_policy = trace_accessor;
+
+  access_trace *trace = nullptr;
+  std::uint32_t site = 0;
+
+  constexpr data_handle_type offset(data_handle_type p, std::size_t i) const noexcept {
+    return p + i;
+  }
+
+  inline reference access(data_handle_type p, std::size_t i) const;
+};
+
+class access_trace {
+public:
+  explicit access_trace(trace_options opt = {})
+      : opt_(opt), line_shift_(std::countr_zero(opt.line_bytes)),
+        threshold_(opt.sample_rate >= 1 ? std::uint64_t{1} << 32
+                                        : static_cast<std::uint64_t>(opt.sample_rate *
+                                                                     4294967296.0)) {}
+
+  template <class T, class E, class L>
+  std::mdspan<T, E, L, trace_accessor<T>> view(std::mdspan<T, E, L> m, std::string name) {
+    sites_.push_back({std::move(name), sizeof(T)});
+    return {m.data_handle(), m.mapping(),
+            trace_accessor<T>{this, static_cast<std::uint32_t>(sites_.size() - 1)}};
+  }
+
+  void record(const void *p, std::uint32_t site) {
+    const auto a = reinterpret_cast<std::uintptr_t>(p);
+    ++accesses_;
+
+    site_state &s = sites_[site];
+    ++s.accesses;
+    if (s.accesses > 1)
+      s.count_stride((static_cast<std::ptrdiff_t>(a) - static_cast<std::ptrdiff_t>(s.last)) /
+                     static_cast<std::ptrdiff_t>(s.element_size));
+    s.last = a;
+
+    if (sampled(a >> line_shift_)) {
+      if (records_.size() < opt_.max_records)
+        records_.push_back({a >> line_shift_, site});
+      else
+        ++dropped_;
+    }
+  }
+
+  void clear() {
+    records_.clear();
+    accesses_ = dropped_ = 0;
+    for (site_state &s : sites_)
+      s = site_state{std::move(s.name), s.element_size};
+  }
+
+  trace_report analyze(const cache_model &model = {}) const {
+    trace_report r;
+    r.accesses = accesses_;
+    r.sampled = records_.size();
+    r.dropped = dropped_;
+    r.sample_rate = std::min(1., opt_.sample_rate);
+
+    for (const site_state &s : sites_) {
+      trace_site_report sr;
+      sr.name = s.name;
+      sr.accesses = s.accesses;
+      for (const auto &[stride, count] : s.strides)
+        if (count > 0)
+          sr.strides.push_back({stride, count});
+      std::sort(sr.strides.begin(), sr.strides.end(),
+                [](const auto &a, const auto &b) { return a.second > b.second; });
+      sr.other_strides = s.other_strides;
+      r.sites.push_back(std::move(sr));
+    }
+
+    reuse_distances(r);
+
+    // The model is given in lines of model.line_bytes, the trace in lines
+    // of opt_.line_bytes.
+    const int shift = std::countr_zero(model.line_bytes) - line_shift_;
+    lru_cache l1(model.l1, model.line_bytes, r.sample_rate);
+    lru_cache l2(model.l2, model.line_bytes, r.sample_rate);
+    for (const record_t &rec : records_) {
+      const std::uint64_t line = shift >= 0 ? rec.line >> shift : rec.line << -shift;
+      trace_site_report &sr = r.sites[rec.site];
+      ++sr.sampled;
+      if (!l1.access(line)) {
+        ++r.l1_misses;
+        ++sr.l1_misses;
+        if (!l2.access(line)) {
+          ++r.l2_misses;
+          ++sr.l2_misses;
+        }
+      }
+    }
+    return r;
+  }
+
+private:
+  static constexpr std::size_t tracked_strides = 6;
+
+  struct site_state {
+    std::string name;
+    std::size_t element_size = 1;
+    std::uint64_t accesses = 0;
+    std::uintptr_t last = 0;
+    std::array<std::pair<std::ptrdiff_t, std::uint64_t>, tracked_strides> strides{};
+    std::uint64_t other_strides = 0;
+
+    void count_stride(std::ptrdiff_t d) {
+      for (auto &[stride, count] : strides) {
+        if (count > 0 && stride == d) {
+          ++count;
+          return;
+        }
+        if (count == 0) {
+          stride = d;
+          count = 1;
+          return;
+        }
+      }
+      ++other_strides;
+    }
+  };
+
+  struct record_t {
+    std::uint64_t line;
+    std::uint32_t site;
+  };
+
+  // Set associative LRU cache, the number of sets scaled by the sample rate.
+  class lru_cache {
+  public:
+    lru_cache(const cache_level &c, std::size_t line_bytes, double rate)
+        : ways_(std::max<std::size_t>(1, c.ways)),
+          sets_(std::max<std::size_t>(
+              1, static_cast<std::size_t>(
+                     std::llround(double(c.bytes / line_bytes / ways_) * rate)))),
+          tags_(sets_ * ways_, empty) {}
+
+    // True on a hit.
+    bool access(std::uint64_t line) {
+      std::uint64_t *set = tags_.data() + (line % sets_) * ways_;
+      std::size_t w = 0;
+      while (w < ways_ && set[w] != line)
+        ++w;
+      const bool hit = w < ways_;
+      // Move to the front, evicting the last way on a miss.
+      std::copy_backward(set, set + std::min(w, ways_ - 1), set + std::min(w, ways_ - 1) + 1);
+      set[0] = line;
+      return hit;
+    }
+
+  private:
+    static constexpr std::uint64_t empty = ~std::uint64_t{0};
+    std::size_t ways_;
+    std::size_t sets_;
+    std::vector<std::uint64_t> tags_;
+  };
+
+  trace_options opt_;
+  int line_shift_;
+  std::uint64_t threshold_;
+  std::uint64_t accesses_ = 0;
+  std::uint64_t dropped_ = 0;
+  std::vector<site_state> sites_;
+  std::vector<record_t> records_;
+
+  bool sampled(std::uint64_t line) const {
+    return ((line * 0x9E3779B97F4A7C15ull) >> 32) < threshold_;
+  }
+
+  // Stack distances with a Fenwick tree over the positions of the last
+  // access to every line.
+  void reuse_distances(trace_report &r) const {
+    const std::size_t n = records_.size();
+    std::vector<std::uint32_t> tree(n + 1, 0);
+    auto add = [&](std::size_t i, int v) {
+      for (++i; i <= n; i += i & (~i + 1))
+        tree[i] += v;
+    };
+    auto prefix = [&](std::size_t i) { // marks in [0, i)
+      std::uint64_t s = 0;
+      for (; i > 0; i -= i & (~i + 1))
+        s += tree[i];
+      return s;
+    };
+
+    std::unordered_map<std::uint64_t, std::size_t> last;
+    last.reserve(n / 4);
+    for (std::size_t t = 0; t < n; ++t) {
+      const auto [it, first] = last.try_emplace(records_[t].line, t);
+      if (first) {
+        ++r.cold;
+      } else {
+        const std::size_t p = it->second;
+        const double d = double(prefix(t) - prefix(p + 1)) / r.sample_rate;
+        const std::size_t b = d < 1 ? 0 : static_cast<std::size_t>(std::floor(std::log2(d))) + 1;
+        if (r.reuse.size() <= b)
+          r.reuse.resize(b + 1);
+        ++r.reuse[b];
+        add(p, -1);
+        it->second = t;
+      }
+      add(t, 1);
+    }
+  }
+};
+
+template <class T>
+inline typename trace_accessor<T>::reference
+trace_accessor<T>::access(data_handle_type p, std::size_t i) const {
+  trace->record(p + i, site);
+  return p[i];
+}
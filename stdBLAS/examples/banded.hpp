@@ -0,0 +1,210 @@
+#pragma once
+
+#define MDSPAN_USE_PAREN_OPERATOR 1
+#include <mdspan/mdspan.hpp>
+#include "experimental/__p2630_bits/submdspan.hpp"
+#include <experimental/linalg>
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Band storage of one triangle of a symmetric n x n matrix with half-bandwidth
+// kd, as used by LAPACK ?pbtrf: column j is stored contiguously in a column of
+// ldab >= kd + 1 elements,
+//   upper: A[i, j] at (kd + i - j) + j * ldab for max(0, j - kd) <= i <= j,
+//   lower: A[i, j] at (i - j) + j * ldab      for j <= i <= min(n - 1, j + kd).
+//
+// Accesses to the other triangle are mirrored. Elements outside of the band
+// are not stored and must not be accessed.
+template <class Triangle>
+struct layout_banded {
+  static_assert(std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t> ||
+                std::is_same_v<Triangle, Kokkos::Experimental::linalg::lower_triangle_t>);
+
+  template <class Extents>
+  class mapping {
+  public:
+    using extents_type = Extents;
+    using index_type = typename extents_type::index_type;
+    using size_type = typename extents_type::size_type;
+    using rank_type = typename extents_type::rank_type;
+    using layout_type = layout_banded;
+
+    static_assert(extents_type::rank() == 2);
+
+  private:
+    static constexpr bool upper = std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t>;
+
+    extents_type extents_{};
+    index_type kd_ = 0;
+    index_type ldab_ = 1;
+
+  public:
+    constexpr mapping() noexcept = default;
+    constexpr mapping(const mapping&) noexcept = default;
+    constexpr mapping& operator=(const mapping&) noexcept = default;
+
+    constexpr mapping(const extents_type& e, index_type kd) noexcept
+        : mapping(e, kd, kd + 1) {}
+
+    constexpr mapping(const extents_type& e, index_type kd, index_type ldab) noexcept
+        : extents_(e), kd_(kd), ldab_(ldab) {}
+
+    constexpr const extents_type& extents() const noexcept { return extents_; }
+
+    constexpr index_type bandwidth() const noexcept { return kd_; }
+    constexpr index_type leading_dimension() const noexcept { return ldab_; }
+
+    constexpr index_type required_span_size() const noexcept {
+      return extents_.extent(1) * ldab_;
+    }
+
+    template <class I0, class I1>
+    constexpr index_type operator()(I0 i0, I1 i1) const noexcept {
+      index_type i = static_cast<index_type>(i0);
+      index_type j = static_cast<index_type>(i1);
+
+      if constexpr (upper) {
+        if (i > j)
+          std::swap(i, j);
+        return kd_ + i - j + j * ldab_;
+      }
+      else {
+        if (i < j)
+          std::swap(i, j);
+        return i - j + j * ldab_;
+      }
+    }
+
+    static constexpr bool is_always_unique() noexcept { return false; }
+    static constexpr bool is_always_exhaustive() noexcept { return false; }
+    static constexpr bool is_always_strided() noexcept { return false; }
+
+    static constexpr bool is_unique() noexcept { return false; }
+    static constexpr bool is_exhaustive() noexcept { return false; }
+    static constexpr bool is_strided() noexcept { return false; }
+
+    template <class OtherExtents>
+    friend constexpr bool operator==(const mapping& lhs, const mapping<OtherExtents>& rhs) noexcept {
+      return lhs.extents() == rhs.extents() && lhs.bandwidth() == rhs.bandwidth() &&
+             lhs.leading_dimension() == rhs.leading_dimension();
+    }
+  };
+};
+
+namespace impl {
+
+// Unblocked right-looking factorization of the lower band, as ?pbtf2.
+template<class InOutMat>
+std::optional<typename InOutMat::size_type>
+cholesky_factor_banded_lower(InOutMat L, typename InOutMat::size_type kd)
+{
+  using value_type = typename InOutMat::value_type;
+  using size_type = typename InOutMat::size_type;
+
+  constexpr value_type ZERO {};
+  const size_type n = L.extent(0);
+
+  for (size_type j = 0; j < n; ++j) {
+    const value_type ajj = L[j,j];
+    if (ajj <= ZERO || std::isnan(ajj)) {
+      return {j + 1};
+    }
+    const value_type ljj = std::sqrt(ajj);
+    L[j,j] = ljj;
+
+    const size_type jn = std::min(n - 1, j + kd);
+    for (size_type i = j + 1; i <= jn; ++i) {
+      L[i,j] /= ljj;
+    }
+
+    // Rank-1 update of the trailing kd x kd lower triangle within the band.
+    for (size_type l = j + 1; l <= jn; ++l) {
+      const value_type llj = L[l,j];
+      for (size_type i = l; i <= jn; ++i) {
+        L[i,l] -= L[i,j] * llj;
+      }
+    }
+  }
+
+  return std::nullopt;
+}
+
+// Solves L L^T X = B, overwriting B with X.
+template<class InMat,
+         class InOutMat>
+void cholesky_solve_banded_lower(InMat L, typename InMat::size_type kd, InOutMat B)
+{
+  using size_type = typename InMat::size_type;
+  using value_type = typename InOutMat::value_type;
+
+  const size_type n = L.extent(0);
+
+  for (size_type c = 0; c < B.extent(1); ++c) {
+    // L Y = B
+    for (size_type j = 0; j < n; ++j) {
+      const value_type yj = B[j,c] / L[j,j];
+      B[j,c] = yj;
+      const size_type jn = std::min(n - 1, j + kd);
+      for (size_type i = j + 1; i <= jn; ++i) {
+        B[i,c] -= L[i,j] * yj;
+      }
+    }
+
+    // L^T X = Y
+    for (size_type j = n; j-- > 0;) {
+      value_type xj = B[j,c];
+      const size_type jn = std::min(n - 1, j + kd);
+      for (size_type i = j + 1; i <= jn; ++i) {
+        xj -= L[i,j] * B[i,c];
+      }
+      B[j,c] = xj / L[j,j];
+    }
+  }
+}
+
+} // namespace impl
+
+// Banded counterpart of cholesky_factor, in O(n kd^2).
+// Returns nullopt if no bad pivots,
+// else the index of the first bad pivot.
+// A "bad" pivot is zero or NaN.
+template<class InOutMat,
+         class Triangle>
+std::optional<typename InOutMat::size_type>
+cholesky_factor_banded(InOutMat A, Triangle)
+{
+  static_assert(std::is_same_v<typename InOutMat::layout_type, layout_banded<Triangle>>);
+
+  if (A.extent(0) != A.extent(1))
+    std::terminate();
+
+  const typename InOutMat::size_type kd = A.mapping().bandwidth();
+  if constexpr (std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t>)
+    return impl::cholesky_factor_banded_lower(Kokkos::Experimental::linalg::transposed(A), kd);
+  else
+    return impl::cholesky_factor_banded_lower(A, kd);
+}
+
+// Solves A X = B, overwriting B with X, where A has been factored by
+// cholesky_factor_banded with the same triangle t, in O(n kd) per column.
+template<class InMat,
+         class Triangle,
+         class InOutMat>
+void cholesky_solve_banded(InMat A, Triangle, InOutMat B)
+{
+  static_assert(std::is_same_v<typename InMat::layout_type, layout_banded<Triangle>>);
+
+  if (A.extent(0) != A.extent(1) || A.extent(0) != B.extent(0))
+    std::terminate();
+
+  const typename InMat::size_type kd = A.mapping().bandwidth();
+  if constexpr (std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t>)
+    impl::cholesky_solve_banded_lower(Kokkos::Experimental::linalg::transposed(A), kd, B);
+  else
+    impl::cholesky_solve_banded_lower(A, kd, B);
+}
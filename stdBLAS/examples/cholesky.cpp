@@ -1,8 +1,6 @@
-#define MDSPAN_USE_PAREN_OPERATOR 1
-#include <mdspan/mdspan.hpp>
-#include "experimental/__p2630_bits/submdspan.hpp"
-#include <experimental/linalg>
-#include <iostream>
+#include "cholesky.hpp"
+#include "packed.hpp"
+#include "timer.hpp"
 
 #if (! defined(__GNUC__)) || (__GNUC__ > 9)
 #  define MDSPAN_EXAMPLES_USE_EXECUTION_POLICIES 1
@@ -12,7 +10,10 @@
 #  include <execution>
 #endif
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <string>
 #include <vector>
 
 using Kokkos::mdspan;
@@ -30,125 +31,279 @@ using std::tuple;
 #else
   using Kokkos::dynamic_extent;
 #endif
+using Kokkos::layout_left;
+using Kokkos::layout_right;
+using Kokkos::full_extent;
 
-  // Flip upper to lower, and lower to upper
-lower_triangle_t opposite_triangle(upper_triangle_t) {
-  return {};
-}
-upper_triangle_t opposite_triangle(lower_triangle_t) {
-  return {};
+#ifdef CHOLESKYLAPACK
+constexpr const char* NAME = "cholesky_lapack";
+#else
+constexpr const char* NAME = "cholesky";
+#endif
+
+// Padding value, used to check that the factorization doesn't write out of bounds.
+constexpr double PAD = -99;
+
+// Symmetric and strictly diagonally dominant, hence SPD.
+template<class T>
+T spd_val(int n, int i, int j) {
+  return (i == j ? static_cast<T>(n) : T{}) + T{1} / static_cast<T>(1 + std::abs(i - j));
 }
 
-// Returns nullopt if no bad pivots,
-// else the index of the first bad pivot.
-// A "bad" pivot is zero or NaN.
-template<class InOutMat,
-         class Triangle>
-std::optional<typename InOutMat::size_type>
-cholesky_factor(InOutMat A, Triangle t)
-{
-  using value_type = typename InOutMat::value_type;
-  using size_type = typename InOutMat::size_type;
-
-  constexpr value_type ZERO {};
-  constexpr value_type ONE (1.0);
-  const size_type n = A.extent(0);
-
-  if (n == 0) {
-    return std::nullopt;
-  }
-  else if (n == 1) {
-    if (A[0,0] <= ZERO || std::isnan(A[0,0])) {
-      return {size_type(1)};
+template <class MatA>
+void set_spd(MatA A) {
+  using INT = typename MatA::index_type;
+  using value_type = typename MatA::value_type;
+  const INT n = A.extent(0);
+
+  for (INT i = 0; i < n; ++i) {
+    for (INT j = 0; j < n; ++j) {
+      A[i, j] = spd_val<value_type>(n, i, j);
     }
-    A[0,0] = std::sqrt(A[0,0]);
   }
-  else {
-    // Partition A into [A11, A12,
-    //                   A21, A22],
-    // where A21 is the transpose of A12.
-    const size_type n1 = n / 2;
-    // n2 = n - n1;
-    auto A11 = submdspan(A, pair{0, n1}, pair{0, n1});
-    auto A22 = submdspan(A, pair{n1, n}, pair{n1, n});
-
-    // Factor A11
-    const auto info1 = cholesky_factor(A11, t);
-    if (info1.has_value()) {
-      return info1;
-    }
+}
+
+// Returns ||A - L L^T||_F / ||A||_F (or ||A - U^T U||_F / ||A||_F),
+// where L (or U) is the triangle t of F.
+template <class MatF, class Triangle>
+auto residual(MatF F, Triangle t) {
+  using INT = typename MatF::index_type;
+  using value_type = typename MatF::value_type;
+  const INT n = F.extent(0);
+
+  std::vector<value_type> lvec(n * n);
+  std::vector<value_type> rvec(n * n);
+  mdspan<value_type, extents<INT, dynamic_extent, dynamic_extent>, layout_left> L(lvec.data(), n, n);
+  mdspan<value_type, extents<INT, dynamic_extent, dynamic_extent>, layout_left> R(rvec.data(), n, n);
 
-    using linalg::explicit_diagonal;
-    using linalg::symmetric_matrix_rank_k_update;
-    using linalg::transposed;
-    if constexpr (std::is_same_v<Triangle, upper_triangle_t>) {
-      // Update and scale A12
-      auto A12 = submdspan(A, tuple{0, n1}, tuple{n1, n});
-      using linalg::triangular_matrix_matrix_left_solve;
-      // BLAS would use original triangle; we need to flip it
-      triangular_matrix_matrix_left_solve(transposed(A11), opposite_triangle(t), explicit_diagonal, A12, A12);
-
-      // A22 = A22 - A12^T * A12
-      symmetric_matrix_rank_k_update(-ONE, transposed(A12), A22, t);
+  constexpr bool upper = std::is_same_v<Triangle, upper_triangle_t>;
+  for (INT j = 0; j < n; ++j) {
+    for (INT i = 0; i < n; ++i) {
+      L[i, j] = (upper ? i <= j : i >= j) ? F[i, j] : value_type{};
     }
-    else {
-      // Update and scale A21
-      auto A21 = submdspan(A, tuple{n1, n}, tuple{0, n1});
-      using linalg::triangular_matrix_matrix_right_solve;
-      // BLAS would use original triangle; we need to flip it
-      triangular_matrix_matrix_right_solve(transposed(A11), opposite_triangle(t), explicit_diagonal, A21, A21);
-
-      // A22 = A22 - A21 * A21^T
-      symmetric_matrix_rank_k_update(-ONE, A21, A22, t);
+  }
+  set_spd(R);
+
+  // R = A - L L^T, only the triangle t is updated.
+  if constexpr (upper)
+    linalg::symmetric_matrix_rank_k_update(value_type{-1}, linalg::transposed(L), R, t);
+  else
+    linalg::symmetric_matrix_rank_k_update(value_type{-1}, L, R, t);
+
+  value_type res{}, norm{};
+  for (INT j = 0; j < n; ++j) {
+    for (INT i = 0; i < n; ++i) {
+      if (upper ? i <= j : i >= j) {
+        const value_type f = i == j ? 1 : 2;
+        res += f * R[i, j] * R[i, j];
+        norm += f * spd_val<value_type>(n, i, j) * spd_val<value_type>(n, i, j);
+      }
     }
+  }
+  return std::sqrt(res / norm);
+}
+
+// Solves A x = A 1 with the factor F and returns max |x_i - 1|.
+template <class MatF, class Triangle>
+auto solve_error(MatF F, Triangle t) {
+  using INT = typename MatF::index_type;
+  using value_type = typename MatF::value_type;
+  const INT n = F.extent(0);
+
+  std::vector<value_type> xvec(n);
+  mdspan<value_type, extents<INT, dynamic_extent, dynamic_extent>, layout_left> X(xvec.data(), n, 1);
 
-    // Factor A22
-    const auto info2 = cholesky_factor(A22, t);
-    if (info2.has_value()) {
-      return {info2.value() + n1};
+  for (INT i = 0; i < n; ++i) {
+    X[i, 0] = value_type{};
+    for (INT j = 0; j < n; ++j) {
+      X[i, 0] += spd_val<value_type>(n, i, j);
     }
   }
 
-  return std::nullopt;
+  cholesky_solve(F, t, X);
+
+  value_type err{};
+  for (INT i = 0; i < n; ++i) {
+    err = std::max(err, std::abs(X[i, 0] - value_type{1}));
+  }
+  return err;
 }
 
-int main() {
+// reset() initializes A before each factorization, it is not timed.
+template <class MatA, class Triangle, class Reset>
+void test_cholesky(std::string ts, int reps, MatA A, Triangle t, Reset&& reset, int ld) {
+  using INT = typename MatA::index_type;
+  using value_type = typename MatA::value_type;
+  const INT n = A.extent(0);
 
-  using IT = int;
-  IT N = 4;
-  IT ld = 5;
+  // Warmup
+  reset();
+  cholesky_factor(A, t);
 
-  std::vector<double> vec(ld*N);
+  double min_elapsed = std::numeric_limits<double>::max();
+  double sum_elapsed = 0;
+  std::optional<typename MatA::size_type> info;
 
-  for (IT ii = 0; ii < ld*N; ++ii) {
-    auto j = ii / ld;
-    auto i = ii % ld;
-    if (i >= N)
-      vec[ii] = -99;
-    else if (i == j)
-      vec[ii] = N;
-    else if (i > j)
-      vec[ii] = .5;
-    else
-      vec[ii] = -.5;
+  for (int rep = 0; rep < reps; ++rep) {
+    reset();
+    Timer timer;
+    info = cholesky_factor(A, t);
+    double elapsed = timer.elapsed();
+
+    min_elapsed = std::min(min_elapsed, elapsed);
+    sum_elapsed += elapsed;
   }
 
-  mdspan<double, extents<IT, dynamic_extent,dynamic_extent>, Kokkos::layout_left> A_full(vec.data(), ld, N);
-  auto A = submdspan(A_full, pair{0, N}, pair{0, N});
+  if (info.has_value()) {
+    std::cout << "bad pivot " << info.value() << std::endl;
+  }
 
-  for (IT i = 0; i < A.extent(0); ++i) {
-    for (IT j = 0; j < A.extent(1); ++j) {
-      std::cout << "(" << i << ", " << j << "): " << A[i, j] << " CM:" << vec[i + j * ld] << std::endl;
-    }
+  const auto res = residual(A, t);
+  const auto err = solve_error(A, t);
+  const double flops = static_cast<double>(n) * static_cast<double>(n) * static_cast<double>(n) / 3;
+
+  std::cout << NAME << ", " << ts << ", " << n << ", " << ld << ", " << reps << ", "
+            << min_elapsed << ", " << sum_elapsed / reps << ", "
+            << flops / 1e9 / min_elapsed << ", " << res << ", " << err << std::endl;
+
+  auto eps = std::numeric_limits<value_type>::epsilon();
+  if (res > n * eps) {
+    std::cout << "residual " << res << " is too large" << std::endl;
   }
+}
 
-  //cholesky_factor(A, linalg::lower_triangle);
-  cholesky_factor(A, linalg::upper_triangle);
+template <class MatA, class MatFull, class Triangle>
+void test_cholesky_dense(std::string ts, int reps, MatA A, MatFull A_full, Triangle t) {
+  using INT = typename MatA::index_type;
+  using value_type = typename MatA::value_type;
+  const INT n = A.extent(0);
 
-  for (IT i = 0; i < A.extent(0); ++i) {
-    for (IT j = 0; j < A.extent(1); ++j) {
-      std::cout << "(" << i << ", " << j << "): " << A[i, j] << " CM:" << vec[i + j * ld] << std::endl;
+  auto reset = [&]() {
+    for (INT i = 0; i < A_full.extent(0); ++i) {
+      for (INT j = 0; j < A_full.extent(1); ++j) {
+        A_full[i, j] = static_cast<value_type>(PAD);
+      }
     }
+    set_spd(A);
+  };
+
+  const INT ld = ts[1] == 'C' ? A_full.extent(0) : A_full.extent(1);
+  test_cholesky(ts, reps, A, t, reset, ld);
+
+  // Only the padding may be outside of A.
+  INT pad_errors = 0;
+  for (INT i = 0; i < A_full.extent(0); ++i) {
+    for (INT j = 0; j < A_full.extent(1); ++j) {
+      bool in_A = (ts[1] == 'C') ? i < n : j < n;
+      if (!in_A && A_full[i, j] != static_cast<value_type>(PAD))
+        ++pad_errors;
+    }
+  }
+  if (pad_errors) {
+    std::cout << pad_errors << " padding elements were overwritten" << std::endl;
+  }
+}
+
+// Tile size of the blocked packed layout.
+constexpr std::size_t PACKED_TILE = 64;
+
+template <class T, class Triangle>
+void test_cholesky_layout(std::string ts, int n, int pad, int reps, Triangle t) {
+  const int ld = n + pad;
+
+  if (ts[1] == 'C') { // Col-major
+    std::vector<T> vec(ld * n);
+    mdspan<T, extents<int, dynamic_extent, dynamic_extent>, layout_left> A_full(vec.data(), ld, n);
+    auto A = submdspan(A_full, pair{0, n}, full_extent);
+    test_cholesky_dense(ts, reps, A, A_full, t);
+  }
+  else if (ts[1] == 'R') { // Row-major
+    std::vector<T> vec(ld * n);
+    mdspan<T, extents<int, dynamic_extent, dynamic_extent>, layout_right> A_full(vec.data(), n, ld);
+    auto A = submdspan(A_full, full_extent, pair{0, n});
+    test_cholesky_dense(ts, reps, A, A_full, t);
   }
+  else if (ts[1] == 'P') { // Packed
+    using layout = layout_packed<Triangle>;
+    typename layout::template mapping<extents<int, dynamic_extent, dynamic_extent>> map(extents<int, dynamic_extent, dynamic_extent>(n, n));
+    std::vector<T> vec(map.required_span_size());
+    mdspan<T, extents<int, dynamic_extent, dynamic_extent>, layout> A(vec.data(), map);
+    test_cholesky(ts, reps, A, t, [&]() { set_spd(A); }, 0);
+  }
+  else if (ts[1] == 'B') { // Blocked packed
+    using layout = layout_blocked_packed<Triangle, PACKED_TILE>;
+    typename layout::template mapping<extents<int, dynamic_extent, dynamic_extent>> map(extents<int, dynamic_extent, dynamic_extent>(n, n));
+    std::vector<T> vec(map.required_span_size());
+    mdspan<T, extents<int, dynamic_extent, dynamic_extent>, layout> A(vec.data(), map);
+    test_cholesky(ts, reps, A, t, [&]() { set_spd(A); }, 0);
+  }
+  else {
+    std::terminate();
+  }
+}
+
+template <class T>
+void test_cholesky(std::string ts, int n, int pad, int reps) {
+  if (ts[0] == 'L')
+    test_cholesky_layout<T>(ts, n, pad, reps, linalg::lower_triangle);
+  else if (ts[0] == 'U')
+    test_cholesky_layout<T>(ts, n, pad, reps, linalg::upper_triangle);
+  else
+    std::terminate();
+}
 
+void print_usage_and_terminate() noexcept {
+  std::cout << "Usage: cholesky {sd} [{LU}{CRPB} [<n> [<pad> [<reps>]]]]" << std::endl;
+  std::cout << "  C/R: col/row-major with leading dimension n + pad, P: packed, B: blocked packed." << std::endl;
+  std::cout << "  without <n> (or with n = 0) sweeps n over 64, 128, ..., 2048." << std::endl;
+  std::terminate();
+}
+
+int main(int argc, const char* const* argv) {
+
+  int n = 0;
+  int pad = 0;
+  int reps = 5;
+
+  std::string ts = "LC";
+
+  if (argc < 2)
+    print_usage_and_terminate();
+
+  if (argc >= 3)
+  {
+    if (!(argv[2][0] == 'L' || argv[2][0] == 'U'))
+      print_usage_and_terminate();
+    if (!(argv[2][1] == 'C' || argv[2][1] == 'R' || argv[2][1] == 'P' || argv[2][1] == 'B'))
+      print_usage_and_terminate();
+
+    ts[0] = argv[2][0];
+    ts[1] = argv[2][1];
+  }
+  if (argc >= 4)
+    n = std::atoi(argv[3]);
+  if (argc >= 5)
+    pad = std::atoi(argv[4]);
+  if (argc >= 6)
+    reps = std::atoi(argv[5]);
+
+  if (n < 0 || pad < 0 || reps < 1)
+    print_usage_and_terminate();
+
+  std::vector<int> sizes;
+  if (n > 0)
+    sizes.push_back(n);
+  else
+    sizes = {64, 128, 256, 512, 1024, 2048};
+
+  std::cout << "name, ts, n, ld, reps, min [s], avg [s], GFlop/s, residual, solve error" << std::endl;
+
+  for (int size : sizes) {
+    if (argv[1][0] == 's')
+      test_cholesky<float>(ts, size, pad, reps);
+    else if (argv[1][0] == 'd')
+      test_cholesky<double>(ts, size, pad, reps);
+    else
+      print_usage_and_terminate();
+  }
 }
@@ -0,0 +1,292 @@
+#pragma once
+
+#define MDSPAN_USE_PAREN_OPERATOR 1
+#include <mdspan/mdspan.hpp>
+#include "experimental/__p2630_bits/submdspan.hpp"
+#include <experimental/linalg>
+
+#include "padded.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Flip upper to lower, and lower to upper
+inline Kokkos::Experimental::linalg::lower_triangle_t
+opposite_triangle(Kokkos::Experimental::linalg::upper_triangle_t) {
+  return {};
+}
+inline Kokkos::Experimental::linalg::upper_triangle_t
+opposite_triangle(Kokkos::Experimental::linalg::lower_triangle_t) {
+  return {};
+}
+
+// Returns nullopt if no bad pivots,
+// else the index of the first bad pivot.
+// A "bad" pivot is zero or NaN.
+template<class InOutMat,
+         class Triangle>
+std::optional<typename InOutMat::size_type>
+cholesky_factor_recursive(InOutMat A, Triangle t)
+{
+  using value_type = typename InOutMat::value_type;
+  using size_type = typename InOutMat::size_type;
+
+  constexpr value_type ZERO {};
+  constexpr value_type ONE (1.0);
+  const size_type n = A.extent(0);
+
+  if (n == 0) {
+    return std::nullopt;
+  }
+  else if (n == 1) {
+    if (A[0,0] <= ZERO || std::isnan(A[0,0])) {
+      return {size_type(1)};
+    }
+    A[0,0] = std::sqrt(A[0,0]);
+  }
+  else {
+    // Partition A into [A11, A12,
+    //                   A21, A22],
+    // where A21 is the transpose of A12.
+    const size_type n1 = n / 2;
+    // n2 = n - n1;
+    auto A11 = Kokkos::submdspan(A, std::pair{0, n1}, std::pair{0, n1});
+    auto A22 = Kokkos::submdspan(A, std::pair{n1, n}, std::pair{n1, n});
+
+    // Factor A11
+    const auto info1 = cholesky_factor_recursive(A11, t);
+    if (info1.has_value()) {
+      return info1;
+    }
+
+    using Kokkos::Experimental::linalg::explicit_diagonal;
+    using Kokkos::Experimental::linalg::symmetric_matrix_rank_k_update;
+    using Kokkos::Experimental::linalg::transposed;
+    if constexpr (std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t>) {
+      // Update and scale A12
+      auto A12 = Kokkos::submdspan(A, std::tuple{0, n1}, std::tuple{n1, n});
+      using Kokkos::Experimental::linalg::triangular_matrix_matrix_left_solve;
+      // BLAS would use original triangle; we need to flip it
+      triangular_matrix_matrix_left_solve(transposed(A11), opposite_triangle(t), explicit_diagonal, A12, A12);
+
+      // A22 = A22 - A12^T * A12
+      symmetric_matrix_rank_k_update(-ONE, transposed(A12), A22, t);
+    }
+    else {
+      // Update and scale A21
+      auto A21 = Kokkos::submdspan(A, std::tuple{n1, n}, std::tuple{0, n1});
+      using Kokkos::Experimental::linalg::triangular_matrix_matrix_right_solve;
+      // BLAS would use original triangle; we need to flip it
+      triangular_matrix_matrix_right_solve(transposed(A11), opposite_triangle(t), explicit_diagonal, A21, A21);
+
+      // A22 = A22 - A21 * A21^T
+      symmetric_matrix_rank_k_update(-ONE, A21, A22, t);
+    }
+
+    // Factor A22
+    const auto info2 = cholesky_factor_recursive(A22, t);
+    if (info2.has_value()) {
+      return {info2.value() + n1};
+    }
+  }
+
+  return std::nullopt;
+}
+
+#ifdef CHOLESKYLAPACK
+
+extern "C" void spotrf_(...);
+extern "C" void dpotrf_(...);
+
+inline void potrf_(const char* uplo, const int* n, float* a, const int* lda, int* info) {
+  spotrf_(uplo, n, a, lda, info);
+}
+inline void potrf_(const char* uplo, const int* n, double* a, const int* lda, int* info) {
+  dpotrf_(uplo, n, a, lda, info);
+}
+
+// Real types only: cholesky_factor_recursive, the fallback, is written for
+// real symmetric matrices, complex Hermitian ones would need conjugate
+// transposes, hence they are not dispatched either.
+template<class T>
+inline constexpr bool is_lapack_type_v = std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+template<class Mat>
+inline constexpr bool is_potrf_compatible_v =
+  (is_left_v<typename Mat::layout_type> || is_right_v<typename Mat::layout_type>) &&
+  std::is_same_v<typename Mat::accessor_type, Kokkos::default_accessor<typename Mat::element_type>> &&
+  is_lapack_type_v<typename Mat::element_type>;
+
+// LAPACK is column-major. A row-major matrix is the transpose of the
+// column-major matrix with the same leading dimension, therefore its
+// upper triangle is the lower one of the column-major matrix and vice versa.
+template<class Mat, class Triangle>
+constexpr char get_uplo_lapack() {
+  constexpr bool upper = std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t>;
+  if constexpr (is_left_v<typename Mat::layout_type>)
+    return upper ? 'U' : 'L';
+  else
+    return upper ? 'L' : 'U';
+}
+
+template<class InOutMat,
+         class Triangle>
+std::optional<typename InOutMat::size_type>
+cholesky_factor_lapack(InOutMat A, Triangle)
+{
+  using size_type = typename InOutMat::size_type;
+
+  if (A.extent(0) != A.extent(1))
+    std::terminate();
+
+  constexpr char uplo = get_uplo_lapack<InOutMat, Triangle>();
+  const int n = A.extent(0);
+  const int lda = std::max(1, static_cast<int>(is_left_v<typename InOutMat::layout_type> ? A.stride(1) : A.stride(0)));
+  int info = 0;
+
+  potrf_(&uplo, &n, A.data_handle(), &lda, &info);
+
+  if (info < 0)
+    std::terminate();
+  if (info > 0)
+    return {size_type(info)};
+  return std::nullopt;
+}
+
+#endif
+
+// Dispatches to ?potrf if CHOLESKYLAPACK is defined and A is a float or
+// double matrix with a (padded) layout_left or layout_right and the default
+// accessor, else to the recursive implementation. Either way, A must be
+// real: complex matrices are not supported.
+template<class InOutMat,
+         class Triangle>
+std::optional<typename InOutMat::size_type>
+cholesky_factor(InOutMat A, Triangle t)
+{
+#ifdef CHOLESKYLAPACK
+  if constexpr (is_potrf_compatible_v<InOutMat>)
+    return cholesky_factor_lapack(A, t);
+  else
+#endif
+  return cholesky_factor_recursive(A, t);
+}
+
+// Solves A X = B, overwriting B with X, where A has been factored by
+// cholesky_factor with the same triangle t.
+template<class InMat,
+         class Triangle,
+         class InOutMat>
+void cholesky_solve(InMat A, Triangle t, InOutMat B)
+{
+  using Kokkos::Experimental::linalg::explicit_diagonal;
+  using Kokkos::Experimental::linalg::transposed;
+  using Kokkos::Experimental::linalg::triangular_matrix_matrix_left_solve;
+
+  if constexpr (std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t>) {
+    // A = U^T U: solve U^T Y = B, then U X = Y
+    triangular_matrix_matrix_left_solve(transposed(A), opposite_triangle(t), explicit_diagonal, B, B);
+    triangular_matrix_matrix_left_solve(A, t, explicit_diagonal, B, B);
+  }
+  else {
+    // A = L L^T: solve L Y = B, then L^T X = Y
+    triangular_matrix_matrix_left_solve(A, t, explicit_diagonal, B, B);
+    triangular_matrix_matrix_left_solve(transposed(A), opposite_triangle(t), explicit_diagonal, B, B);
+  }
+}
+
+namespace impl {
+
+// Applies the k rank-1 modifications stored in the columns of X to the
+// lower triangular factor L, one Givens-like rotation per pivot and column.
+// The loop over the columns of X is the inner one, so that column p of L is
+// traversed once per pivot instead of once per column of X.
+// sign = +1 updates (L L^T + X X^T), sign = -1 downdates (L L^T - X X^T).
+template<class InOutMat,
+         class InOutMatX>
+std::optional<typename InOutMat::size_type>
+cholesky_modify_lower(InOutMat L, InOutMatX X, typename InOutMat::value_type sign)
+{
+  using value_type = typename InOutMat::value_type;
+  using size_type = typename InOutMat::size_type;
+
+  constexpr value_type ZERO {};
+  const size_type n = L.extent(0);
+  const size_type k = X.extent(1);
+
+  for (size_type p = 0; p < n; ++p) {
+    for (size_type j = 0; j < k; ++j) {
+      const value_type lpp = L[p,p];
+      const value_type xp = X[p,j];
+      const value_type r2 = lpp * lpp + sign * xp * xp;
+      // A downdate that removes more than the matrix holds
+      // makes the pivot non-positive.
+      if (r2 <= ZERO || std::isnan(r2)) {
+        return {p + 1};
+      }
+      const value_type r = std::sqrt(r2);
+      const value_type c = r / lpp;
+      const value_type s = xp / lpp;
+      L[p,p] = r;
+
+      for (size_type i = p + 1; i < n; ++i) {
+        const value_type lip = (L[i,p] + sign * s * X[i,j]) / c;
+        L[i,p] = lip;
+        X[i,j] = c * X[i,j] - s * lip;
+      }
+    }
+  }
+
+  return std::nullopt;
+}
+
+} // namespace impl
+
+// Given the Cholesky factor of A (as computed by cholesky_factor with the
+// same triangle t), overwrite it with the factor of A + X X^T in O(k n^2).
+// X is n x k and is used as workspace, i.e. its content is destroyed.
+// Returns nullopt on success, else the index of the first bad pivot
+// (same convention as cholesky_factor).
+template<class InOutMat,
+         class InOutMatX,
+         class Triangle>
+std::optional<typename InOutMat::size_type>
+cholesky_update(InOutMat A, InOutMatX X, Triangle t)
+{
+  using value_type = typename InOutMat::value_type;
+  constexpr value_type ONE (1.0);
+
+  if (A.extent(0) != A.extent(1) || A.extent(0) != X.extent(0))
+    std::terminate();
+
+  if constexpr (std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t>)
+    return impl::cholesky_modify_lower(Kokkos::Experimental::linalg::transposed(A), X, ONE);
+  else
+    return impl::cholesky_modify_lower(A, X, ONE);
+}
+
+// Same as cholesky_update, but for A - X X^T.
+// Returns the index of the first bad pivot if A - X X^T is not positive
+// definite, in which case the content of A is unspecified.
+template<class InOutMat,
+         class InOutMatX,
+         class Triangle>
+std::optional<typename InOutMat::size_type>
+cholesky_downdate(InOutMat A, InOutMatX X, Triangle t)
+{
+  using value_type = typename InOutMat::value_type;
+  constexpr value_type ONE (1.0);
+
+  if (A.extent(0) != A.extent(1) || A.extent(0) != X.extent(0))
+    std::terminate();
+
+  if constexpr (std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t>)
+    return impl::cholesky_modify_lower(Kokkos::Experimental::linalg::transposed(A), X, -ONE);
+  else
+    return impl::cholesky_modify_lower(A, X, -ONE);
+}
@@ -0,0 +1,199 @@
+#include "cholesky.hpp"
+#include "banded.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Kokkos::mdspan;
+using Kokkos::extents;
+namespace linalg = Kokkos::Experimental::linalg;
+using linalg::lower_triangle_t;
+using linalg::upper_triangle_t;
+
+#if defined(__cpp_lib_span)
+#include <span>
+  using std::dynamic_extent;
+#else
+  using Kokkos::dynamic_extent;
+#endif
+using Kokkos::layout_left;
+
+// SPD matrix with half-bandwidth kd (strictly diagonally dominant).
+template<class T>
+T band_val(int kd, int i, int j) {
+  const int d = std::abs(i - j);
+  if (d > kd)
+    return T{};
+  return (i == j ? static_cast<T>(kd + 2) : T{}) + T{1} / static_cast<T>(1 + d);
+}
+
+// Sets the band of the triangle t of A (dense or banded).
+template <class MatA, class Triangle>
+void set_band(MatA A, int kd, Triangle) {
+  using INT = typename MatA::index_type;
+  using value_type = typename MatA::value_type;
+  const INT n = A.extent(0);
+
+  for (INT j = 0; j < n; ++j) {
+    const INT i0 = std::is_same_v<Triangle, upper_triangle_t> ? std::max(0, j - kd) : j;
+    const INT i1 = std::is_same_v<Triangle, upper_triangle_t> ? j + 1 : std::min(n, j + kd + 1);
+    for (INT i = i0; i < i1; ++i) {
+      A[i, j] = band_val<value_type>(kd, i, j);
+    }
+  }
+}
+
+template <class T, class Triangle>
+void test_cholesky_banded(Triangle t, int n, int kd, bool dense) {
+  using ext_t = extents<int, dynamic_extent, dynamic_extent>;
+
+  typename layout_banded<Triangle>::template mapping<ext_t> map(ext_t(n, n), kd);
+  std::vector<T> bvec(map.required_span_size());
+  mdspan<T, ext_t, layout_banded<Triangle>> B(bvec.data(), map);
+  set_band(B, kd, t);
+
+  Timer t_band;
+  const auto info_band = cholesky_factor_banded(B, t);
+  double elapsed_band = t_band.elapsed();
+
+  if (info_band.has_value())
+    std::terminate();
+
+  // Solve A x = A 1
+  std::vector<T> xvec(n);
+  mdspan<T, ext_t, layout_left> X(xvec.data(), n, 1);
+  for (int i = 0; i < n; ++i) {
+    X[i, 0] = T{};
+    for (int j = std::max(0, i - kd); j < std::min(n, i + kd + 1); ++j)
+      X[i, 0] += band_val<T>(kd, i, j);
+  }
+
+  Timer t_solve;
+  cholesky_solve_banded(B, t, X);
+  double elapsed_solve = t_solve.elapsed();
+
+  T err{};
+  for (int i = 0; i < n; ++i)
+    err = std::max(err, std::abs(X[i, 0] - T{1}));
+
+  std::cout << (std::is_same_v<Triangle, upper_triangle_t> ? 'U' : 'L') << ", "
+            << "n = " << n << ", kd = " << kd << ", "
+            << "banded " << elapsed_band << " s (" << bvec.size() * sizeof(T) << " B), "
+            << "solve " << elapsed_solve << " s, solve error " << err;
+
+  if (dense) {
+    std::vector<T> avec(n * n);
+    mdspan<T, ext_t, layout_left> A(avec.data(), n, n);
+    set_band(A, kd, t);
+
+    Timer t_dense;
+    const auto info_dense = cholesky_factor(A, t);
+    double elapsed_dense = t_dense.elapsed();
+
+    if (info_dense.has_value())
+      std::terminate();
+
+    T diff{};
+    for (int j = 0; j < n; ++j) {
+      const int i0 = std::is_same_v<Triangle, upper_triangle_t> ? std::max(0, j - kd) : j;
+      const int i1 = std::is_same_v<Triangle, upper_triangle_t> ? j + 1 : std::min(n, j + kd + 1);
+      for (int i = i0; i < i1; ++i)
+        diff = std::max(diff, std::abs(A[i, j] - B[i, j]));
+    }
+
+    std::cout << ", dense " << elapsed_dense << " s (" << avec.size() * sizeof(T) << " B), "
+              << "speedup " << elapsed_dense / elapsed_band << ", max diff " << diff;
+  }
+  std::cout << std::endl;
+}
+
+// A matrix that is not positive definite must report the same bad pivot as cholesky_factor.
+template <class T, class Triangle>
+void test_cholesky_banded_bad_pivot(Triangle t) {
+  using ext_t = extents<int, dynamic_extent, dynamic_extent>;
+  const int n = 16;
+  const int kd = 3;
+
+  typename layout_banded<Triangle>::template mapping<ext_t> map(ext_t(n, n), kd);
+  std::vector<T> bvec(map.required_span_size());
+  mdspan<T, ext_t, layout_banded<Triangle>> B(bvec.data(), map);
+  set_band(B, kd, t);
+  B[5, 5] = T{-1};
+
+  std::vector<T> avec(n * n);
+  mdspan<T, ext_t, layout_left> A(avec.data(), n, n);
+  set_band(A, kd, t);
+  A[5, 5] = T{-1};
+
+  const auto info_band = cholesky_factor_banded(B, t);
+  const auto info_dense = cholesky_factor(A, t);
+
+  if (!info_band.has_value() || info_band != info_dense) {
+    std::cout << "banded and dense bad pivots differ" << std::endl;
+    std::terminate();
+  }
+}
+
+template <class T, class Triangle>
+void run_cholesky_banded(Triangle t, int n, int kd_in, bool dense) {
+  test_cholesky_banded_bad_pivot<T>(t);
+
+  // kd_in < 0: sweep the bandwidths below n.
+  if (kd_in >= 0) {
+    test_cholesky_banded<T>(t, n, kd_in, dense);
+    return;
+  }
+  for (int kd : {1, 2, 4, 8, 16, 32, 64, 128, 256}) {
+    if (kd < n)
+      test_cholesky_banded<T>(t, n, kd, dense);
+  }
+}
+
+void print_usage_and_terminate() noexcept {
+  std::cout << "Usage: cholesky_banded {sd} [{LU} [<n> [<kd> [{D}]]]]" << std::endl;
+  std::cout << "  D: also run the dense cholesky_factor for comparison (default with n <= 4096)." << std::endl;
+  std::terminate();
+}
+
+int main(int argc, const char* const* argv) {
+  char uplo = 'L';
+  int n = 2048;
+  int kd = -1;
+
+  if (argc < 2)
+    print_usage_and_terminate();
+
+  if (argc >= 3) {
+    if (!(argv[2][0] == 'L' || argv[2][0] == 'U'))
+      print_usage_and_terminate();
+    uplo = argv[2][0];
+  }
+  if (argc >= 4)
+    n = std::atoi(argv[3]);
+  if (argc >= 5)
+    kd = std::atoi(argv[4]);
+
+  bool dense = n <= 4096;
+  if (argc >= 6)
+    dense = argv[5][0] == 'D';
+
+  if (n < 1 || (argc >= 5 && (kd < 0 || kd >= n)))
+    print_usage_and_terminate();
+
+  auto run = [&]<class T>() {
+    if (uplo == 'L')
+      run_cholesky_banded<T>(linalg::lower_triangle, n, kd, dense);
+    else
+      run_cholesky_banded<T>(linalg::upper_triangle, n, kd, dense);
+  };
+
+  if (argv[1][0] == 's')
+    run.template operator()<float>();
+  else if (argv[1][0] == 'd')
+    run.template operator()<double>();
+  else
+    print_usage_and_terminate();
+}
@@ -0,0 +1,193 @@
+#include "cholesky.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Kokkos::mdspan;
+using Kokkos::extents;
+namespace linalg = Kokkos::Experimental::linalg;
+using linalg::lower_triangle_t;
+using linalg::upper_triangle_t;
+
+#if defined(__cpp_lib_span)
+#include <span>
+  using std::dynamic_extent;
+#else
+  using Kokkos::dynamic_extent;
+#endif
+using Kokkos::layout_left;
+
+template <class T>
+using matrix_t = mdspan<T, extents<int, dynamic_extent, dynamic_extent>, layout_left>;
+
+template <class MatA>
+void set_spd(MatA A) {
+  using INT = typename MatA::index_type;
+  const INT n = A.extent(0);
+
+  for (INT j = 0; j < n; ++j) {
+    for (INT i = 0; i < n; ++i) {
+      A[i, j] = i == j ? n : .5;
+    }
+  }
+}
+
+template <class MatX>
+void set_x(MatX X) {
+  using INT = typename MatX::index_type;
+  using value_type = typename MatX::value_type;
+
+  for (INT j = 0; j < X.extent(1); ++j) {
+    for (INT i = 0; i < X.extent(0); ++i) {
+      X[i, j] = static_cast<value_type>((i + 3 * j) % 7) / 7;
+    }
+  }
+}
+
+// Max difference over the triangle t, relative to the largest entry of R.
+template <class MatA, class MatR, class Triangle>
+auto triangle_diff(MatA A, MatR R, Triangle) {
+  using INT = typename MatA::index_type;
+  using value_type = typename MatA::value_type;
+  const INT n = A.extent(0);
+
+  value_type diff{}, norm{};
+  for (INT j = 0; j < n; ++j) {
+    const INT i0 = std::is_same_v<Triangle, upper_triangle_t> ? 0 : j;
+    const INT i1 = std::is_same_v<Triangle, upper_triangle_t> ? j + 1 : n;
+    for (INT i = i0; i < i1; ++i) {
+      diff = std::max(diff, std::abs(A[i, j] - R[i, j]));
+      norm = std::max(norm, std::abs(R[i, j]));
+    }
+  }
+  return diff / norm;
+}
+
+template <class T, class Triangle>
+void test_cholesky_update(Triangle t, int n, int k) {
+  std::vector<T> avec(n * n);
+  std::vector<T> lvec(n * n);
+  std::vector<T> rvec(n * n);
+  std::vector<T> xvec(n * k);
+
+  matrix_t<T> A(avec.data(), n, n);
+  matrix_t<T> L(lvec.data(), n, n);
+  matrix_t<T> R(rvec.data(), n, n);
+  matrix_t<T> X(xvec.data(), n, k);
+
+  set_spd(A);
+  std::copy(avec.begin(), avec.end(), lvec.begin());
+  if (cholesky_factor(L, t).has_value())
+    std::terminate();
+
+  // Refactorization: R = chol(A + X X^T)
+  set_x(X);
+  Timer t_ref;
+  std::copy(avec.begin(), avec.end(), rvec.begin());
+  linalg::symmetric_matrix_rank_k_update(T{1}, X, R, t);
+  const auto info_ref = cholesky_factor(R, t);
+  double elapsed_ref = t_ref.elapsed();
+
+  // Update: L = chol(A + X X^T) from L = chol(A)
+  std::vector<T> l0vec = lvec;
+  Timer t_upd;
+  const auto info_upd = cholesky_update(L, X, t);
+  double elapsed_upd = t_upd.elapsed();
+
+  if (info_ref.has_value() || info_upd.has_value())
+    std::terminate();
+  const auto err_upd = triangle_diff(L, R, t);
+
+  // Downdate back to chol(A)
+  set_x(X);
+  Timer t_dd;
+  const auto info_dd = cholesky_downdate(L, X, t);
+  double elapsed_dd = t_dd.elapsed();
+
+  if (info_dd.has_value())
+    std::terminate();
+  const auto err_dd = triangle_diff(L, matrix_t<T>(l0vec.data(), n, n), t);
+
+  std::cout << (std::is_same_v<Triangle, upper_triangle_t> ? 'U' : 'L') << ", "
+            << "n = " << n << ", k = " << k << ", "
+            << "refactor " << elapsed_ref << " s, "
+            << "update " << elapsed_upd << " s, "
+            << "downdate " << elapsed_dd << " s, "
+            << "speedup " << elapsed_ref / elapsed_upd << ", "
+            << "err update " << err_upd << ", err downdate " << err_dd << std::endl;
+}
+
+// Downdating by a vector that is not in the range of A must report a bad pivot.
+template <class T, class Triangle>
+void test_cholesky_downdate_failure(Triangle t) {
+  const int n = 8;
+  std::vector<T> lvec(n * n);
+  std::vector<T> xvec(n);
+  matrix_t<T> L(lvec.data(), n, n);
+  matrix_t<T> X(xvec.data(), n, 1);
+
+  set_spd(L);
+  if (cholesky_factor(L, t).has_value())
+    std::terminate();
+
+  // A[3, 3] = n, hence removing x x^T with x[3] = 2 * sqrt(n) breaks it.
+  X[3, 0] = 2 * std::sqrt(static_cast<T>(n));
+  const auto info = cholesky_downdate(L, X, t);
+  if (!info.has_value() || info.value() != 4) {
+    std::cout << "downdate did not detect loss of positive definiteness" << std::endl;
+    std::terminate();
+  }
+}
+
+template <class T, class Triangle>
+void run_cholesky_update(Triangle t, int n_in, int k_in) {
+  test_cholesky_downdate_failure<T>(t);
+
+  // An n or k given on the command line replaces the sweep over its list.
+  const std::vector<int> ns = n_in > 0 ? std::vector<int>{n_in} : std::vector<int>{256, 512, 1024, 2048};
+  const std::vector<int> ks = k_in > 0 ? std::vector<int>{k_in} : std::vector<int>{1, 4, 16, 64};
+  for (int n : ns)
+    for (int k : ks)
+      test_cholesky_update<T>(t, n, k);
+}
+
+void print_usage_and_terminate() noexcept {
+  std::cout << "Usage: cholesky_update {sd} [{LU} [<n> [<k>]]]" << std::endl;
+  std::terminate();
+}
+
+int main(int argc, const char* const* argv) {
+  char uplo = 'L';
+  int n = 0;
+  int k = 0;
+
+  if (argc < 2)
+    print_usage_and_terminate();
+
+  if (argc >= 3) {
+    if (!(argv[2][0] == 'L' || argv[2][0] == 'U'))
+      print_usage_and_terminate();
+    uplo = argv[2][0];
+  }
+  if (argc >= 4)
+    n = std::atoi(argv[3]);
+  if (argc >= 5)
+    k = std::atoi(argv[4]);
+
+  auto run = [&]<class T>() {
+    if (uplo == 'L')
+      run_cholesky_update<T>(linalg::lower_triangle, n, k);
+    else
+      run_cholesky_update<T>(linalg::upper_triangle, n, k);
+  };
+
+  if (argv[1][0] == 's')
+    run.template operator()<float>();
+  else if (argv[1][0] == 'd')
+    run.template operator()<double>();
+  else
+    print_usage_and_terminate();
+}
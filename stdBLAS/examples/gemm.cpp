@@ -4,6 +4,9 @@
 #include <experimental/linalg>
 #include <iostream>
 
+#include "padded.hpp"
+#include "timer.hpp"
+
 #if (! defined(__GNUC__)) || (__GNUC__ > 9)
 #  define MDSPAN_EXAMPLES_USE_EXECUTION_POLICIES 1
 #endif
@@ -14,26 +17,6 @@
 
 #include <iostream>
 #include <vector>
-#include <chrono>
-
-template <class clock = std::chrono::high_resolution_clock>
-class Timer {
-  using time_point = std::chrono::time_point<clock>;
-
-  time_point start_;
-
-  inline time_point now() const {
-    return clock::now();
-  }
-
-public:
-  Timer() : start_(now()) {}
-
-  double elapsed() const {
-    using namespace std::chrono;
-    return duration_cast<duration<double>>(now() - start_).count();
-  }
-};
 
 using Kokkos::mdspan;
 using Kokkos::extents;
@@ -161,24 +144,6 @@ void gemm_3(MatA A, MatB B, MatC C) {
   }
 }
 
-template<class Layout>
-static constexpr bool is_left_v = false;
-
-template<>
-constexpr bool is_left_v<layout_left> = true;
-
-template <size_t PaddingValue>
-static constexpr bool is_left_v<layout_left_padded<PaddingValue>> = true;
-
-template<class Layout>
-static constexpr bool is_right_v = false;
-
-template<>
-constexpr bool is_right_v<layout_right> = true;
-
-template <size_t PaddingValue>
-static constexpr bool is_right_v<layout_right_padded<PaddingValue>> = true;
-
 template<class MatA, class MatB, class MatC>
 void gemm(MatA A, MatB B, MatC C) {
   if constexpr (is_left_v<typename MatA::layout_type> && is_left_v<typename MatC::layout_type>)
@@ -619,13 +584,27 @@ void test_gemm(std::string ts, int m, int n, int k) {
 
     test_gemm(ts, A, B, C);
   }
+  else if (ts[2] == 'P') {// Col-major, padded leading dimensions
+    auto A = make_padded_mdarray<T, layout_left_padded<dynamic_extent>>(am, an);
+    auto B = make_padded_mdarray<T, layout_left_padded<dynamic_extent>>(bm, bn);
+    auto C = make_padded_mdarray<T, layout_left_padded<dynamic_extent>>(m, n);
+
+    test_gemm(ts, A.to_mdspan(), B.to_mdspan(), C.to_mdspan());
+  }
+  else if (ts[2] == 'Q') {// Row-major, padded leading dimensions
+    auto A = make_padded_mdarray<T, layout_right_padded<dynamic_extent>>(am, an);
+    auto B = make_padded_mdarray<T, layout_right_padded<dynamic_extent>>(bm, bn);
+    auto C = make_padded_mdarray<T, layout_right_padded<dynamic_extent>>(m, n);
+
+    test_gemm(ts, A.to_mdspan(), B.to_mdspan(), C.to_mdspan());
+  }
   else {
     std::terminate();
   }
 }
 
 void print_usage_and_terminate() noexcept {
-  std::cout << "Usage: gemm {sdcz} [{NTC}{NTC}{CR} [<m> [<n> [<k>]]]]" << std::endl;
+  std::cout << "Usage: gemm {sdcz} [{NTC}{NTC}{CRPQ} [<m> [<n> [<k>]]]]" << std::endl;
   std::terminate();
 }
 
@@ -646,7 +625,7 @@ int main(int argc, const char* const* argv) {
       print_usage_and_terminate();
     if (!(argv[2][1] == 'N' || argv[2][1] == 'T' || argv[2][1] == 'C'))
       print_usage_and_terminate();
-    if (!(argv[2][2] == 'C' || argv[2][2] == 'R'))
+    if (!(argv[2][2] == 'C' || argv[2][2] == 'R' || argv[2][2] == 'P' || argv[2][2] == 'Q'))
       print_usage_and_terminate();
 
     ts[0] = argv[2][0];
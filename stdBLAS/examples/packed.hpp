@@ -0,0 +1,149 @@
+#pragma once
+
+#define MDSPAN_USE_PAREN_OPERATOR 1
+#include <mdspan/mdspan.hpp>
+#include "experimental/__p2630_bits/submdspan.hpp"
+#include <experimental/linalg>
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Packed storage of one triangle of a square n x n matrix, similar to
+// linalg::layout_blas_packed<Triangle, column_major_t>.
+//
+// The matrix is divided into TileSize x TileSize tiles. Only the tiles of
+// the triangle are stored, in column-major packed order, and every tile is
+// a contiguous column-major block. With TileSize == 1 this is exactly the
+// BLAS packed format ('U' or 'L' in ?spmv, ?pptrf, ...), which needs
+// n (n + 1) / 2 elements instead of n^2.
+//
+// Accesses to the other triangle are mirrored, i.e. the mapping describes a
+// symmetric matrix. This is not unique, but the functions taking a Triangle
+// tag only ever access the stored triangle.
+//
+// Unlike layout_blas_packed, the mapping supports submdspan with pair, tuple
+// and full_extent slices, which cholesky_factor needs for its recursion.
+// The submatrix mappings keep the packed geometry of the whole matrix and
+// an offset of the first row and column into it.
+template <class Triangle, std::size_t TileSize>
+struct layout_blocked_packed {
+  static_assert(std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t> ||
+                std::is_same_v<Triangle, Kokkos::Experimental::linalg::lower_triangle_t>);
+  static_assert(TileSize > 0);
+
+  template <class Extents>
+  class mapping {
+  public:
+    using extents_type = Extents;
+    using index_type = typename extents_type::index_type;
+    using size_type = typename extents_type::size_type;
+    using rank_type = typename extents_type::rank_type;
+    using layout_type = layout_blocked_packed;
+
+    static_assert(extents_type::rank() == 2);
+
+  private:
+    static constexpr bool upper = std::is_same_v<Triangle, Kokkos::Experimental::linalg::upper_triangle_t>;
+    static constexpr index_type nb = TileSize;
+
+    extents_type extents_{};
+    // Size of the whole (packed) matrix, and its number of tiles per dimension.
+    index_type n_ = 0;
+    index_type nt_ = 0;
+    // Position of this (sub)matrix in the whole matrix.
+    index_type row_offset_ = 0;
+    index_type col_offset_ = 0;
+
+    template <class Slice>
+    static constexpr std::pair<index_type, index_type> slice_bounds(Slice s, index_type ext) {
+      if constexpr (std::is_same_v<Slice, Kokkos::full_extent_t>) {
+        return {0, ext};
+      }
+      else {
+        static_assert(std::tuple_size_v<Slice> == 2, "only pair, tuple and full_extent slices are supported");
+        return {static_cast<index_type>(std::get<0>(s)), static_cast<index_type>(std::get<1>(s))};
+      }
+    }
+
+  public:
+    constexpr mapping() noexcept = default;
+    constexpr mapping(const mapping&) noexcept = default;
+    constexpr mapping& operator=(const mapping&) noexcept = default;
+
+    // The whole square matrix.
+    constexpr mapping(const extents_type& e) noexcept
+        : mapping(e, e.extent(0), 0, 0) {}
+
+    // The submatrix of extents e, starting at (row_offset, col_offset), of a
+    // packed matrix of size n.
+    constexpr mapping(const extents_type& e, index_type n, index_type row_offset, index_type col_offset) noexcept
+        : extents_(e), n_(n), nt_((n + nb - 1) / nb), row_offset_(row_offset), col_offset_(col_offset) {}
+
+    constexpr const extents_type& extents() const noexcept { return extents_; }
+
+    constexpr index_type size() const noexcept { return n_; }
+    constexpr index_type row_offset() const noexcept { return row_offset_; }
+    constexpr index_type col_offset() const noexcept { return col_offset_; }
+
+    constexpr index_type required_span_size() const noexcept {
+      return nt_ * (nt_ + 1) / 2 * nb * nb;
+    }
+
+    template <class I0, class I1>
+    constexpr index_type operator()(I0 i0, I1 i1) const noexcept {
+      index_type i = static_cast<index_type>(i0) + row_offset_;
+      index_type j = static_cast<index_type>(i1) + col_offset_;
+
+      if constexpr (upper) {
+        if (i > j)
+          std::swap(i, j);
+      }
+      else {
+        if (i < j)
+          std::swap(i, j);
+      }
+
+      const index_type ti = i / nb;
+      const index_type tj = j / nb;
+      const index_type tile = upper ? ti + tj * (tj + 1) / 2
+                                    : ti + tj * (2 * nt_ - tj - 1) / 2;
+
+      return tile * nb * nb + (i % nb) + (j % nb) * nb;
+    }
+
+    static constexpr bool is_always_unique() noexcept { return false; }
+    static constexpr bool is_always_exhaustive() noexcept { return false; }
+    static constexpr bool is_always_strided() noexcept { return false; }
+
+    static constexpr bool is_unique() noexcept { return false; }
+    constexpr bool is_exhaustive() const noexcept {
+      return nb == 1 && row_offset_ == 0 && col_offset_ == 0 &&
+             extents_.extent(0) == n_ && extents_.extent(1) == n_;
+    }
+    static constexpr bool is_strided() noexcept { return false; }
+
+    template <class OtherExtents>
+    friend constexpr bool operator==(const mapping& lhs, const mapping<OtherExtents>& rhs) noexcept {
+      return lhs.extents() == rhs.extents() && lhs.size() == rhs.size() &&
+             lhs.row_offset() == rhs.row_offset() && lhs.col_offset() == rhs.col_offset();
+    }
+
+    template <class S0, class S1>
+    friend constexpr auto submdspan_mapping(const mapping& src, S0 s0, S1 s1) {
+      using sub_mapping_t = mapping<Kokkos::dextents<index_type, 2>>;
+      const auto [r0, r1] = slice_bounds(s0, src.extents().extent(0));
+      const auto [c0, c1] = slice_bounds(s1, src.extents().extent(1));
+
+      // The offset is always relative to the start of the packed storage.
+      return Kokkos::submdspan_mapping_result<sub_mapping_t>{
+          sub_mapping_t(Kokkos::dextents<index_type, 2>(r1 - r0, c1 - c0), src.n_,
+                        src.row_offset_ + r0, src.col_offset_ + c0),
+          0};
+    }
+  };
+};
+
+template <class Triangle>
+using layout_packed = layout_blocked_packed<Triangle, 1>;
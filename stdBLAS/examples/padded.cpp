@@ -0,0 +1,111 @@
+#include "padded.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Kokkos::dextents;
+using Kokkos::dynamic_extent;
+using Kokkos::layout_left;
+using Kokkos::mdspan;
+using Kokkos::Experimental::layout_left_padded;
+
+// Keeps the kernels from being optimized away.
+volatile double sink;
+
+// y = A x row by row: the column-wise kernel, every access is a leading
+// dimension away from the previous one.
+template <class Mat, class T>
+void gemv_rows(Mat A, const std::vector<T> &x, std::vector<T> &y) {
+  for (int i = 0; i < A.extent(0); ++i) {
+    T s{};
+    for (int j = 0; j < A.extent(1); ++j)
+      s += A[i, j] * x[j];
+    y[i] = s;
+  }
+}
+
+// B = A^T in 8 x 8 blocks: 8 loads from 8 columns of A, 8 stores to 8
+// columns of B.
+template <class Mat>
+void transpose(Mat A, Mat B) {
+  constexpr int bs = 8;
+  const int n = A.extent(0);
+  for (int ib = 0; ib < n; ib += bs)
+    for (int jb = 0; jb < n; jb += bs)
+      for (int j = jb; j < std::min(jb + bs, n); ++j)
+        for (int i = ib; i < std::min(ib + bs, n); ++i)
+          B[j, i] = A[i, j];
+}
+
+template <class T, class Mat>
+void bench(const std::string &name, Mat A, Mat B, int reps) {
+  const int n = A.extent(0);
+  for (int j = 0; j < n; ++j)
+    for (int i = 0; i < n; ++i)
+      A[i, j] = static_cast<T>(i - j) / static_cast<T>(n);
+
+  std::vector<T> x(n, T{1}), y(n);
+  const double t_gemv = best_of(reps, [&] { gemv_rows(A, x, y); });
+  const double t_tr = best_of(reps, [&] { transpose(A, B); });
+  sink = y[n / 2] + B[1, 0];
+
+  const double bytes = static_cast<double>(n) * n * sizeof(T);
+  std::cout << name << ", " << n << ", " << A.stride(1) << ", "
+            << (reinterpret_cast<std::uintptr_t>(A.data_handle()) % 64 == 0) << ", "
+            << bytes / t_gemv / 1e9 << ", " << 2 * bytes / t_tr / 1e9 << std::endl;
+}
+
+template <class T>
+void bench(int n, int reps) {
+  {
+    std::vector<T> a(static_cast<std::size_t>(n) * n), b(a.size());
+    mdspan<T, dextents<int, 2>, layout_left> A(a.data(), n, n);
+    mdspan<T, dextents<int, 2>, layout_left> B(b.data(), n, n);
+    bench<T>("layout_left", A, B, reps);
+  }
+  {
+    auto a = make_padded_mdarray<T, layout_left_padded<dynamic_extent>>(n, n);
+    auto b = make_padded_mdarray<T, layout_left_padded<dynamic_extent>>(n, n);
+    bench<T>("layout_left_padded", a.to_mdspan(), b.to_mdspan(), reps);
+  }
+}
+
+void print_usage_and_terminate() noexcept {
+  std::cout << "Usage: padded {sd} [<n> [<reps>]]" << std::endl;
+  std::terminate();
+}
+
+// Without <n>, sweeps sizes around powers of two.
+int main(int argc, const char* const* argv) {
+  if (argc < 2)
+    print_usage_and_terminate();
+
+  std::vector<int> sizes;
+  if (argc >= 3)
+    sizes.push_back(std::atoi(argv[2]));
+  else
+    for (int p : {512, 1024, 2048, 4096})
+      for (int d : {-1, 0, 1})
+        sizes.push_back(p + d);
+  const int reps = argc >= 4 ? std::atoi(argv[3]) : 3;
+
+  static_assert(padded_leading_dimension(1024, 4) == 1040);
+  static_assert(padded_leading_dimension(1000, 8) == 1000);
+  static_assert(padded_leading_dimension(1023, 8) == 1032);
+
+  std::cout << "layout, n, ld, aligned, gemv rows [GB/s], transpose [GB/s]" << std::endl;
+  for (int n : sizes) {
+    if (argv[1][0] == 's')
+      bench<float>(n, reps);
+    else if (argv[1][0] == 'd')
+      bench<double>(n, reps);
+    else
+      print_usage_and_terminate();
+  }
+}
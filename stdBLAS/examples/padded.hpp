@@ -0,0 +1,101 @@
+#pragma once
+
+#define MDSPAN_USE_PAREN_OPERATOR 1
+#include <mdspan/mdspan.hpp>
+#include <mdspan/mdarray.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Matrices whose leading dimension is a power of two bytes, e.g. 1024 floats,
+// put the elements of a row of a column-major matrix (or of a column of a
+// row-major one) in the same few cache sets: a column-wise kernel then
+// evicts lines before reusing them, and loads alias stores 4 KiB apart.
+//
+// make_padded_mdarray<T, Layout>(m, n) allocates an m x n matrix with
+// Layout = layout_left_padded<dynamic_extent> or
+// layout_right_padded<dynamic_extent>, whose leading dimension is chosen by
+// padded_leading_dimension, and whose first element is aligned to the cache
+// line and SIMD width. gemm() in gemm.cpp recognizes the padded layouts.
+
+struct cache_geometry {
+  std::size_t line_bytes = 64;
+  // Width of the widest SIMD register, 64 for AVX-512.
+  std::size_t simd_bytes = 64;
+};
+
+// Smallest leading dimension >= n (in elements of elem_bytes) such that
+// every column starts on a line and SIMD boundary, and such that
+// consecutive columns are an odd number of lines apart. The columns then
+// cycle through all the sets of every cache level, and are never a multiple
+// of 4 KiB apart.
+constexpr std::size_t padded_leading_dimension(std::size_t n, std::size_t elem_bytes,
+                                               cache_geometry g = {}) {
+  const std::size_t unit = std::max(g.line_bytes, g.simd_bytes);
+  std::size_t bytes = (n * elem_bytes + unit - 1) / unit * unit;
+  if ((bytes / g.line_bytes) % 2 == 0)
+    bytes += g.line_bytes;
+  return (bytes + elem_bytes - 1) / elem_bytes;
+}
+
+// Layouts whose leading dimension is the stride of the second (is_left_v)
+// or first (is_right_v) extent, padded or not, as BLAS and LAPACK expect.
+template <class Layout> inline constexpr bool is_left_v = false;
+
+template <> inline constexpr bool is_left_v<Kokkos::layout_left> = true;
+
+template <std::size_t PaddingValue>
+inline constexpr bool is_left_v<Kokkos::Experimental::layout_left_padded<PaddingValue>> = true;
+
+template <class Layout> inline constexpr bool is_right_v = false;
+
+template <> inline constexpr bool is_right_v<Kokkos::layout_right> = true;
+
+template <std::size_t PaddingValue>
+inline constexpr bool is_right_v<Kokkos::Experimental::layout_right_padded<PaddingValue>> = true;
+
+template <class T, std::size_t Align = 64> struct aligned_allocator {
+  using value_type = T;
+
+  template <class U> struct rebind {
+    using other = aligned_allocator<U, Align>;
+  };
+
+  aligned_allocator() = default;
+  template <class U>
+  constexpr aligned_allocator(const aligned_allocator<U, Align> &) noexcept {}
+
+  [[nodiscard]] T *allocate(std::size_t n) {
+    return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+  }
+
+  void deallocate(T *p, std::size_t n) noexcept {
+    ::operator delete(p, n * sizeof(T), std::align_val_t{Align});
+  }
+
+  friend bool operator==(const aligned_allocator &, const aligned_allocator &) = default;
+};
+
+template <class T, class Layout, class IndexType = int>
+using padded_mdarray =
+    Kokkos::Experimental::mdarray<T, Kokkos::dextents<IndexType, 2>, Layout,
+                                  std::vector<T, aligned_allocator<T>>>;
+
+template <class T, class Layout, class IndexType>
+padded_mdarray<T, Layout, IndexType> make_padded_mdarray(IndexType m, IndexType n,
+                                                         cache_geometry g = {}) {
+  using Kokkos::dynamic_extent;
+  constexpr bool left = std::is_same_v<Layout, Kokkos::Experimental::layout_left_padded<dynamic_extent>>;
+  static_assert(left || std::is_same_v<Layout, Kokkos::Experimental::layout_right_padded<dynamic_extent>>,
+                "Layout must be layout_left_padded or layout_right_padded with dynamic padding");
+
+  const std::size_t ld = padded_leading_dimension(left ? m : n, sizeof(T), g);
+  // The leading extent is rounded up to a multiple of the padding value, a
+  // padding value >= the leading extent is thus the leading dimension.
+  typename Layout::template mapping<Kokkos::dextents<IndexType, 2>> map(
+      Kokkos::dextents<IndexType, 2>{m, n}, static_cast<IndexType>(ld));
+  return padded_mdarray<T, Layout, IndexType>(map);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+template <class clock = std::chrono::high_resolution_clock>
+class Timer {
+  using time_point = std::chrono::time_point<clock>;
+
+  time_point start_;
+
+  inline time_point now() const {
+    return clock::now();
+  }
+
+public:
+  Timer() : start_(now()) {}
+
+  double elapsed() const {
+    using namespace std::chrono;
+    return duration_cast<duration<double>>(now() - start_).count();
+  }
+};
+
+// Best time of reps calls of f, in seconds.
+template <class F> double best_of(int reps, F &&f) {
+  double best = 1e30;
+  for (int r = 0; r < reps; ++r) {
+    Timer t;
+    f();
+    best = std::min(best, t.elapsed());
+  }
+  return best;
+}